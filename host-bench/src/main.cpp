@@ -0,0 +1,268 @@
+/*
+ * host-bench - Replay and stress harness for the detection core on x86.
+ *
+ * Frames go through the same steps as on the dual-core firmware: WiFi
+ * frames are pushed into a frame_ring by the "RX callback" and drained by
+ * the "decode task" through odid_decode_wifi_frame(); BLE adverts are
+ * decoded inline like NimBLE's onResult(); every decode lands in the
+ * uav_tracker, and the "printer" drains dirty drones into detection JSON.
+ * The stages run back to back on one thread, with the ring and the printer
+ * drained every FRAME_RING_SLOTS frames.
+ *
+ *   host-bench [options] [capture.pcap ...]
+ *     --synth N         add N synthetic frames (default 100000 without pcaps)
+ *     --drones K        synthetic transmitters (default 32)
+ *     --repeat R        replay the frame set R times (default 5)
+ *     --write-pcap P    save the frame set as P-wifi.pcap and P-ble.pcap
+ *     --print           echo the detection JSON to stdout
+ *
+ * Each pass prints a {"bench":...} line (frames/s, ns/frame, heap
+ * allocations during the pass) and the last pass is followed by the same
+ * {"metrics":...} record the firmware sends.
+ */
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "dc_port.h"
+#include "dc_metrics.h"
+#include "detection_json.h"
+#include "frame_ring.h"
+#include "odid_decoder.h"
+#include "uav_tracker.h"
+#include "pcap_io.h"
+#include "synth.h"
+
+// ---------------------------------------------------------------------------
+// Clock and heap accounting
+
+static const std::chrono::steady_clock::time_point benchStart =
+    std::chrono::steady_clock::now();
+
+uint32_t dc_millis(void) {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - benchStart).count();
+}
+
+uint32_t dc_micros(void) {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - benchStart).count();
+}
+
+static bool countAllocs = false;
+static uint64_t allocCount = 0;
+static uint64_t allocBytes = 0;
+
+static inline void note_alloc(size_t n) {
+  if (!countAllocs) return;
+  allocCount++;
+  allocBytes += n;
+}
+
+// With -DBENCH_WRAP_MALLOC=1 and -Wl,--wrap=malloc,... (the native env on
+// Linux) the C library allocator is counted too, including calls from the
+// opendroneid C sources. Otherwise only operator new is seen.
+#if BENCH_WRAP_MALLOC
+extern "C" {
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n) {
+  note_alloc(n);
+  return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  note_alloc(n * size);
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t n) {
+  note_alloc(n);
+  return __real_realloc(p, n);
+}
+}
+#define BENCH_MALLOC __real_malloc
+#else
+#define BENCH_MALLOC malloc
+#endif
+
+void *operator new(size_t n) {
+  note_alloc(n);
+  void *p = BENCH_MALLOC(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// ---------------------------------------------------------------------------
+// Firmware stand-ins
+
+static uav_tracker tracker;
+static odid_decoder wifiDecoder;
+static odid_decoder bleDecoder;
+static frame_ring wifiRing;
+static dc_metrics metrics;
+
+static bool printJson = false;
+
+struct bench_pass {
+  uint64_t frames;
+  uint64_t detections;      // JSON lines produced by the printer
+  uint64_t json_bytes;
+};
+
+static void process_wifi_frame(uint8_t *payload, int length, int rssi, uint8_t channel,
+                               uint32_t rx_us) {
+  if (odid_decode_wifi_frame(&wifiDecoder, payload, length) == ODID_FRAME_NONE) return;
+  uav_tracker_store(&tracker, wifiDecoder.mac, rssi, BAND_2_4GHZ, channel, rx_us,
+                    &wifiDecoder.fields, nullptr);
+}
+
+static void drain_wifi_ring() {
+  captured_frame *frame;
+  while ((frame = frame_ring_peek(&wifiRing)) != nullptr) {
+    process_wifi_frame(frame->data, frame->length, frame->rssi, frame->channel,
+                       frame->timestamp);
+    frame_ring_release(&wifiRing);
+  }
+}
+
+static void drain_printer(bench_pass *pass) {
+  id_data UAV;
+  char json_msg[256];
+  while (uav_tracker_next_dirty(&tracker, dc_millis(), &UAV)) {
+    int len = format_detection_json(json_msg, sizeof(json_msg), &UAV, 0, nullptr);
+    if (printJson) puts(json_msg);
+    dc_latency_record(&metrics.latency, dc_micros() - UAV.capture_us);
+    pass->detections++;
+    pass->json_bytes += (uint64_t)len;
+  }
+}
+
+static void replay(const std::vector<bench_frame> &frames, bench_pass *pass) {
+  uint32_t batch = 0;
+  for (const bench_frame &f : frames) {
+    uint32_t rx_us = dc_micros();
+    if (f.kind == BENCH_FRAME_WIFI) {
+      frame_ring_push(&wifiRing, f.data.data(), (int)f.data.size(), f.rssi, f.channel, 0,
+                      rx_us);
+    } else if (odid_decode_ble_adv(&bleDecoder, f.data.data(), (int)f.data.size()) !=
+               ODID_FRAME_NONE) {
+      uav_tracker_store(&tracker, f.addr, f.rssi, BAND_BLE, 0, rx_us, &bleDecoder.fields,
+                        nullptr);
+    }
+    pass->frames++;
+    if (++batch == FRAME_RING_SLOTS) {
+      batch = 0;
+      drain_wifi_ring();
+      drain_printer(pass);
+    }
+  }
+  drain_wifi_ring();
+  drain_printer(pass);
+}
+
+// ---------------------------------------------------------------------------
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--synth N] [--drones K] [--repeat R] [--write-pcap PREFIX]\n"
+          "       %*s [--print] [capture.pcap ...]\n",
+          argv0, (int)strlen(argv0), "");
+}
+
+int main(int argc, char **argv) {
+  uint32_t synth = 0, drones = 32, repeat = 5;
+  const char *pcapPrefix = nullptr;
+  std::vector<const char *> captures;
+
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(a, "--synth") && more) synth = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(a, "--drones") && more) drones = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(a, "--repeat") && more) repeat = (uint32_t)strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(a, "--write-pcap") && more) pcapPrefix = argv[++i];
+    else if (!strcmp(a, "--print")) printJson = true;
+    else if (a[0] == '-') { usage(argv[0]); return 2; }
+    else captures.push_back(a);
+  }
+  if (captures.empty() && synth == 0) synth = 100000;
+  if (repeat == 0) repeat = 1;
+
+  std::vector<bench_frame> frames;
+  pcap_load_stats load = {};
+  for (const char *path : captures) {
+    if (!pcap_load(path, &frames, &load)) return 1;
+  }
+  if (synth) synth_frames(synth, drones, &frames);
+  if (frames.empty()) {
+    fprintf(stderr, "no usable frames (%u records, %u skipped)\n",
+            (unsigned)load.records, (unsigned)load.skipped);
+    return 1;
+  }
+
+  if (pcapPrefix) {
+    std::string prefix(pcapPrefix);
+    if (!pcap_save((prefix + "-wifi.pcap").c_str(), frames, BENCH_FRAME_WIFI) ||
+        !pcap_save((prefix + "-ble.pcap").c_str(), frames, BENCH_FRAME_BLE)) return 1;
+  }
+
+  uint32_t wifiFrames = 0;
+  for (const bench_frame &f : frames) wifiFrames += f.kind == BENCH_FRAME_WIFI;
+
+  if (!uav_tracker_init(&tracker)) {
+    fprintf(stderr, "tracker allocation failed\n");
+    return 1;
+  }
+  odid_decoder_init(&wifiDecoder);
+  odid_decoder_init(&bleDecoder);
+  frame_ring_init(&wifiRing);
+  dc_metrics_init(&metrics);
+
+  for (uint32_t r = 0; r < repeat; r++) {
+    bench_pass pass = {};
+    uint64_t allocs0 = allocCount, bytes0 = allocBytes;
+    countAllocs = true;
+    auto t0 = std::chrono::steady_clock::now();
+    replay(frames, &pass);
+    auto t1 = std::chrono::steady_clock::now();
+    countAllocs = false;
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    printf("{\"bench\":{\"pass\":%u,\"frames\":%llu,\"wifi\":%u,\"ble\":%u,"
+            "\"detections\":%llu,\"json_bytes\":%llu,\"ns_per_frame\":%.1f,"
+            "\"frames_per_sec\":%.0f,\"allocs\":%llu,\"alloc_bytes\":%llu}}\n",
+            (unsigned)r, (unsigned long long)pass.frames, (unsigned)wifiFrames,
+            (unsigned)(frames.size() - wifiFrames), (unsigned long long)pass.detections,
+            (unsigned long long)pass.json_bytes, ns / (double)pass.frames,
+            ns > 0 ? (double)pass.frames * 1e9 / ns : 0.0,
+            (unsigned long long)(allocCount - allocs0),
+            (unsigned long long)(allocBytes - bytes0));
+  }
+
+  dc_decode_stats decode = {};
+  dc_decode_stats_add(&decode, &wifiDecoder.stats);
+  dc_decode_stats_add(&decode, &bleDecoder.stats);
+  char line[1024];
+  dc_metrics_format_json(&metrics, line, sizeof(line), &decode, wifiRing.drops,
+                         tracker.evictions);
+  puts(line);
+  if (load.records) {
+    printf("{\"pcap\":{\"records\":%u,\"skipped\":%u}}\n", (unsigned)load.records,
+           (unsigned)load.skipped);
+  }
+  return 0;
+}
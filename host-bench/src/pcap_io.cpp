@@ -0,0 +1,255 @@
+#include <string.h>
+#include "pcap_io.h"
+
+#define PCAP_MAGIC_US      0xA1B2C3D4u
+#define PCAP_MAGIC_NS      0xA1B23C4Du
+#define BLE_ADV_ACCESS     0x8E89BED6u
+#define BLE_PHDR_LEN       10
+#define BLE_PHDR_SIGNAL_OK 0x0002
+#define RADIOTAP_FLAG_FCS  0x10
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+static uint32_t swap32(uint32_t v) { return __builtin_bswap32(v); }
+
+static uint8_t freq_to_channel(uint16_t mhz) {
+  if (mhz == 2484) return 14;
+  if (mhz >= 2412 && mhz <= 2472) return (uint8_t)((mhz - 2407) / 5);
+  if (mhz >= 5955) return (uint8_t)((mhz - 5950) / 5);
+  if (mhz >= 5000) return (uint8_t)((mhz - 5000) / 5);
+  return 0;
+}
+
+// The firmware callbacks only ever see management frames
+static bool push_wifi(const uint8_t *p, size_t n, int8_t rssi, uint8_t channel,
+                      std::vector<bench_frame> *out) {
+  if (n < 24 || (p[0] & 0x0C) != 0) return false;
+  bench_frame f;
+  f.kind = BENCH_FRAME_WIFI;
+  f.rssi = rssi;
+  f.channel = channel;
+  memset(f.addr, 0, sizeof(f.addr));
+  f.data.assign(p, p + n);
+  out->push_back(std::move(f));
+  return true;
+}
+
+// Radiotap: walk the first present word as far as antenna signal (bit 5)
+static bool push_radiotap(const uint8_t *p, size_t n, std::vector<bench_frame> *out) {
+  if (n < 8 || p[0] != 0) return false;
+  size_t it_len = rd16(p + 2);
+  if (it_len < 8 || it_len > n) return false;
+  uint32_t present = rd32(p + 4);
+  size_t at = 8;
+  for (uint32_t w = present; w & 0x80000000u; w = rd32(p + at - 4)) {
+    at += 4;
+    if (at > it_len) return false;
+  }
+
+  static const uint8_t align[6] = {8, 1, 1, 2, 1, 1};
+  static const uint8_t size[6]  = {8, 1, 1, 4, 2, 1};
+  uint8_t flags = 0, channel = 0;
+  int8_t rssi = -60;
+  for (int bit = 0; bit < 6; bit++) {
+    if (!(present & (1u << bit))) continue;
+    at = (at + align[bit] - 1) & ~(size_t)(align[bit] - 1);
+    if (at + size[bit] > it_len) break;
+    if (bit == 1) flags = p[at];
+    if (bit == 3) channel = freq_to_channel(rd16(p + at));
+    if (bit == 5) rssi = (int8_t)p[at];
+    at += size[bit];
+  }
+
+  size_t len = n - it_len;
+  if (flags & RADIOTAP_FLAG_FCS) {
+    if (len < 4) return false;
+    len -= 4;
+  }
+  return push_wifi(p + it_len, len, rssi, channel, out);
+}
+
+// One LL advertising-channel packet: access address, 2-byte header, PDU.
+// The CRC after the PDU is ignored.
+static bool push_ble(const uint8_t *p, size_t n, int8_t rssi, uint8_t channel,
+                     std::vector<bench_frame> *out) {
+  if (n < 6 || rd32(p) != BLE_ADV_ACCESS) return false;
+  uint8_t type = p[4] & 0x0F;
+  size_t len = p[5];
+  if (6 + len > n) return false;
+  const uint8_t *pdu = p + 6;
+  const uint8_t *adva = nullptr;
+  const uint8_t *data = nullptr;
+  size_t data_len = 0;
+
+  switch (type) {
+    case 0:  // ADV_IND
+    case 2:  // ADV_NONCONN_IND
+    case 4:  // SCAN_RSP
+    case 6:  // ADV_SCAN_IND
+      if (len < 6) return false;
+      adva = pdu;
+      data = pdu + 6;
+      data_len = len - 6;
+      break;
+    case 7: {  // ADV_EXT_IND / AUX_ADV_IND / AUX_CHAIN_IND
+      if (len < 1) return false;
+      size_t hdr = pdu[0] & 0x3F;
+      if (1 + hdr > len) return false;
+      if (hdr) {
+        uint8_t fl = pdu[1];
+        size_t at = 2;
+        if (fl & 0x01) { adva = pdu + at; at += 6; }   // AdvA
+        if (at > 1 + hdr) return false;
+      }
+      data = pdu + 1 + hdr;
+      data_len = len - 1 - hdr;
+      break;
+    }
+    default:
+      return false;
+  }
+  if (!adva || data_len == 0) return false;
+
+  bench_frame f;
+  f.kind = BENCH_FRAME_BLE;
+  f.rssi = rssi;
+  f.channel = channel;
+  for (int i = 0; i < 6; i++) f.addr[i] = adva[5 - i];  // LSB first on air
+  f.data.assign(data, data + data_len);
+  out->push_back(std::move(f));
+  return true;
+}
+
+bool pcap_load(const char *path, std::vector<bench_frame> *out,
+               pcap_load_stats *stats) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  uint8_t gh[24];
+  if (fread(gh, 1, sizeof(gh), fp) != sizeof(gh)) {
+    fprintf(stderr, "%s: short pcap header\n", path);
+    fclose(fp);
+    return false;
+  }
+  uint32_t magic = rd32(gh);
+  bool swapped = (magic == swap32(PCAP_MAGIC_US) || magic == swap32(PCAP_MAGIC_NS));
+  if (!swapped && magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) {
+    fprintf(stderr, "%s: not a pcap file (pcapng is not supported)\n", path);
+    fclose(fp);
+    return false;
+  }
+  uint32_t linktype = rd32(gh + 20);
+  if (swapped) linktype = swap32(linktype);
+  linktype &= 0x0FFFFFFF;  // upper bits carry FCS length in newer writers
+  if (linktype != PCAP_LINKTYPE_IEEE802_11 && linktype != PCAP_LINKTYPE_RADIOTAP &&
+      linktype != PCAP_LINKTYPE_BLE_LL && linktype != PCAP_LINKTYPE_BLE_LL_WITH_PHDR) {
+    fprintf(stderr, "%s: unsupported link type %u\n", path, (unsigned)linktype);
+    fclose(fp);
+    return false;
+  }
+
+  std::vector<uint8_t> rec;
+  uint8_t rh[16];
+  while (fread(rh, 1, sizeof(rh), fp) == sizeof(rh)) {
+    uint32_t caplen = rd32(rh + 8);
+    if (swapped) caplen = swap32(caplen);
+    if (caplen > 262144) {
+      fprintf(stderr, "%s: corrupt record length %u\n", path, (unsigned)caplen);
+      break;
+    }
+    rec.resize(caplen);
+    if (caplen && fread(rec.data(), 1, caplen, fp) != caplen) break;
+    stats->records++;
+
+    const uint8_t *p = rec.data();
+    bool used = false;
+    switch (linktype) {
+      case PCAP_LINKTYPE_IEEE802_11:
+        used = push_wifi(p, caplen, -60, 0, out);
+        break;
+      case PCAP_LINKTYPE_RADIOTAP:
+        used = push_radiotap(p, caplen, out);
+        break;
+      case PCAP_LINKTYPE_BLE_LL:
+        used = push_ble(p, caplen, -60, 0, out);
+        break;
+      case PCAP_LINKTYPE_BLE_LL_WITH_PHDR:
+        if (caplen >= BLE_PHDR_LEN) {
+          int8_t rssi = (rd16(p + 8) & BLE_PHDR_SIGNAL_OK) ? (int8_t)p[1] : -60;
+          used = push_ble(p + BLE_PHDR_LEN, caplen - BLE_PHDR_LEN, rssi, p[0], out);
+        }
+        break;
+    }
+    if (!used) stats->skipped++;
+  }
+  fclose(fp);
+  return true;
+}
+
+static void put32(FILE *fp, uint32_t v) {
+  uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+  fwrite(b, 1, 4, fp);
+}
+
+bool pcap_save(const char *path, const std::vector<bench_frame> &frames,
+               bench_frame_kind kind) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    fprintf(stderr, "%s: cannot create\n", path);
+    return false;
+  }
+  put32(fp, PCAP_MAGIC_US);
+  put32(fp, 0x00040002);  // version 2.4
+  put32(fp, 0);           // thiszone
+  put32(fp, 0);           // sigfigs
+  put32(fp, 65535);       // snaplen
+  put32(fp, kind == BENCH_FRAME_WIFI ? PCAP_LINKTYPE_IEEE802_11 : PCAP_LINKTYPE_BLE_LL);
+
+  // Synthetic captures are spaced 1 ms apart
+  uint32_t n = 0;
+  uint8_t pkt[8 + 255 + 3];
+  for (const bench_frame &f : frames) {
+    if (f.kind != kind) continue;
+    const uint8_t *body = f.data.data();
+    size_t len = f.data.size();
+    if (kind == BENCH_FRAME_BLE) {
+      // Legacy ADV_NONCONN_IND while AdvData fits in 31 bytes, else an
+      // ADV_EXT_IND whose extended header carries only AdvA
+      bool legacy = len <= 31;
+      size_t hdr = legacy ? 0 : 2 + 6;
+      if (hdr + 6 * legacy + len > 255) continue;
+      uint8_t *q = pkt;
+      q[0] = (uint8_t)BLE_ADV_ACCESS;
+      q[1] = (uint8_t)(BLE_ADV_ACCESS >> 8);
+      q[2] = (uint8_t)(BLE_ADV_ACCESS >> 16);
+      q[3] = (uint8_t)(BLE_ADV_ACCESS >> 24);
+      q[4] = legacy ? 2 : 7;
+      q[5] = (uint8_t)((legacy ? 6 : hdr) + len);
+      q += 6;
+      if (!legacy) {
+        *q++ = (uint8_t)(hdr - 1);  // extended header length, mode 0
+        *q++ = 0x01;                // AdvA present
+      }
+      for (int i = 0; i < 6; i++) *q++ = f.addr[5 - i];
+      memcpy(q, body, len);
+      q += len;
+      memset(q, 0, 3);
+      q += 3;
+      body = pkt;
+      len = (size_t)(q - pkt);
+    }
+    put32(fp, n / 1000);
+    put32(fp, (n % 1000) * 1000);
+    put32(fp, (uint32_t)len);
+    put32(fp, (uint32_t)len);
+    fwrite(body, 1, len, fp);
+    n++;
+  }
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
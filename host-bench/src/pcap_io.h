@@ -0,0 +1,58 @@
+/*
+ * pcap_io.h - Minimal pcap reader/writer for the host replay bench.
+ *
+ * Reads classic pcap files (micro- or nanosecond, either byte order) and
+ * turns each record into what the firmware's radio callbacks see: a raw
+ * 802.11 management frame with RSSI and channel, or a BLE advertiser
+ * address plus AdvData. Supported link types:
+ *
+ *   105  IEEE 802.11, no radio header
+ *   127  802.11 with radiotap (RSSI, channel and FCS flag are read)
+ *   251  Bluetooth LE link layer (access address, header, PDU, CRC)
+ *   256  Bluetooth LE link layer with the 10-byte pseudo header
+ *
+ * Records of any other shape are counted as skipped, never decoded.
+ */
+
+#ifndef _PCAP_IO_H_
+#define _PCAP_IO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#define PCAP_LINKTYPE_IEEE802_11       105
+#define PCAP_LINKTYPE_RADIOTAP         127
+#define PCAP_LINKTYPE_BLE_LL           251
+#define PCAP_LINKTYPE_BLE_LL_WITH_PHDR 256
+
+enum bench_frame_kind : uint8_t {
+  BENCH_FRAME_WIFI = 0,   // data[] starts at 802.11 frame control
+  BENCH_FRAME_BLE         // data[] is AdvData, addr[] the AdvA
+};
+
+struct bench_frame {
+  bench_frame_kind     kind;
+  int8_t               rssi;
+  uint8_t              channel;        // WiFi channel, BLE RF channel
+  uint8_t              addr[6];        // BLE advertiser, display order
+  std::vector<uint8_t> data;
+};
+
+struct pcap_load_stats {
+  uint32_t records;
+  uint32_t skipped;                    // not management / not advertising
+};
+
+// Appends every usable record of path to out. Returns false (with a
+// message on stderr) when the file cannot be read or the link type is not
+// one of the above.
+bool pcap_load(const char *path, std::vector<bench_frame> *out,
+               pcap_load_stats *stats);
+
+// Writes frames of one kind as a microsecond pcap: WiFi as link type 105,
+// BLE as link type 251 advertising PDUs (the CRC is zero-filled).
+bool pcap_save(const char *path, const std::vector<bench_frame> &frames,
+               bench_frame_kind kind);
+
+#endif // _PCAP_IO_H_
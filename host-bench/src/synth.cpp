@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#include "synth.h"
+#include "opendroneid.h"
+
+#define BLE_ODID_AD_HDR 6   // AD length, 0x16, UUID 0xFFFA, app code 0x0D, counter
+
+struct synth_drone {
+  ODID_UAS_Data uas;
+  char          mac[6];
+  uint8_t       counter;    // ODID message counter, one per frame sent
+};
+
+static void synth_init(synth_drone *d, uint32_t n) {
+  memset(d, 0, sizeof(*d));
+  d->mac[0] = 0x02;  // locally administered
+  d->mac[3] = (char)(n >> 16);
+  d->mac[4] = (char)(n >> 8);
+  d->mac[5] = (char)n;
+
+  ODID_UAS_Data *u = &d->uas;
+  odid_initUasData(u);
+  u->BasicID[0].UAType = ODID_UATYPE_HELICOPTER_OR_MULTIROTOR;
+  u->BasicID[0].IDType = ODID_IDTYPE_SERIAL_NUMBER;
+  snprintf(u->BasicID[0].UASID, sizeof(u->BasicID[0].UASID), "BENCH%08u", (unsigned)n);
+  u->BasicIDValid[0] = 1;
+
+  // Spread the fleet over a ~10 km square
+  u->Location.Status = ODID_STATUS_AIRBORNE;
+  u->Location.Latitude = 51.5 + (n % 100) * 0.001;
+  u->Location.Longitude = -0.12 + (n / 100 % 100) * 0.0015;
+  u->Location.AltitudeGeo = 120;
+  u->Location.AltitudeBaro = 118;
+  u->Location.Height = 80;
+  u->Location.SpeedHorizontal = 12;
+  u->Location.Direction = (float)(n * 37 % 360);
+  u->LocationValid = 1;
+
+  u->System.OperatorLocationType = ODID_OPERATOR_LOCATION_TYPE_TAKEOFF;
+  u->System.OperatorLatitude = u->Location.Latitude - 0.002;
+  u->System.OperatorLongitude = u->Location.Longitude - 0.002;
+  u->System.AreaCount = 1;
+  u->SystemValid = 1;
+
+  u->OperatorID.OperatorIdType = ODID_OPERATOR_ID;
+  snprintf(u->OperatorID.OperatorId, sizeof(u->OperatorID.OperatorId), "OPBENCH%06u",
+           (unsigned)n);
+  u->OperatorIDValid = 1;
+}
+
+static void synth_step(synth_drone *d) {
+  ODID_Location_data *l = &d->uas.Location;
+  l->Latitude += 0.00001;
+  if (l->Latitude > 80) l->Latitude = -80;
+  l->Longitude += 0.00001;
+  if (l->Longitude > 179) l->Longitude = -179;
+  l->TimeStamp = (float)((d->counter % 36000) / 10.0);
+  d->counter++;
+}
+
+// ODID service data AD structure around one message or a pack
+static int ble_wrap(uint8_t *buf, const synth_drone *d, const void *odid, int len) {
+  buf[0] = (uint8_t)(BLE_ODID_AD_HDR - 1 + len);
+  buf[1] = 0x16;
+  buf[2] = 0xFA;
+  buf[3] = 0xFF;
+  buf[4] = 0x0D;
+  buf[5] = d->counter;
+  memcpy(buf + BLE_ODID_AD_HDR, odid, len);
+  return BLE_ODID_AD_HDR + len;
+}
+
+// Legacy adverts carry one message; cycle through the four the firmware uses
+static int ble_single(uint8_t *buf, synth_drone *d) {
+  uint8_t msg[ODID_MESSAGE_SIZE];
+  int rc;
+  switch (d->counter % 4) {
+    case 0:  rc = encodeBasicIDMessage((ODID_BasicID_encoded *)msg, &d->uas.BasicID[0]); break;
+    case 1:  rc = encodeLocationMessage((ODID_Location_encoded *)msg, &d->uas.Location); break;
+    case 2:  rc = encodeSystemMessage((ODID_System_encoded *)msg, &d->uas.System); break;
+    default: rc = encodeOperatorIDMessage((ODID_OperatorID_encoded *)msg, &d->uas.OperatorID); break;
+  }
+  if (rc != ODID_SUCCESS) return -1;
+  return ble_wrap(buf, d, msg, sizeof(msg));
+}
+
+static int ble_pack(uint8_t *buf, size_t size, synth_drone *d) {
+  uint8_t pack[3 + ODID_PACK_MAX_MESSAGES * ODID_MESSAGE_SIZE];
+  int len = odid_message_build_pack(&d->uas, pack, sizeof(pack));
+  if (len < 0 || (size_t)(BLE_ODID_AD_HDR + len) > size) return -1;
+  return ble_wrap(buf, d, pack, len);
+}
+
+void synth_frames(uint32_t count, uint32_t drones, std::vector<bench_frame> *out) {
+  if (drones == 0) drones = 1;
+  std::vector<synth_drone> fleet(drones);
+  for (uint32_t i = 0; i < drones; i++) synth_init(&fleet[i], i);
+
+  static const char ssid[] = "RID-BENCH";
+  uint8_t buf[512];
+  out->reserve(out->size() + count);
+  for (uint32_t i = 0; i < count; i++) {
+    synth_drone *d = &fleet[i % drones];
+    uint32_t kind = i / drones % 4;
+    int len;
+    switch (kind) {
+      case 0:
+        len = odid_wifi_build_message_pack_nan_action_frame(&d->uas, d->mac, d->counter,
+                                                            buf, sizeof(buf));
+        break;
+      case 1:
+        len = odid_wifi_build_message_pack_beacon_frame(&d->uas, d->mac, ssid,
+                                                        sizeof(ssid) - 1, 100, d->counter,
+                                                        buf, sizeof(buf));
+        break;
+      case 2:
+        len = ble_single(buf, d);
+        break;
+      default:
+        len = ble_pack(buf, sizeof(buf), d);
+        break;
+    }
+    if (len > 0) {
+      bench_frame f;
+      f.kind = kind < 2 ? BENCH_FRAME_WIFI : BENCH_FRAME_BLE;
+      f.rssi = (int8_t)(-40 - (int)(i * 7 % 50));
+      f.channel = kind < 2 ? 6 : 37 + (uint8_t)(i % 3);
+      memcpy(f.addr, d->mac, sizeof(f.addr));
+      f.data.assign(buf, buf + len);
+      out->push_back(std::move(f));
+    }
+    synth_step(d);
+  }
+}
@@ -0,0 +1,22 @@
+/*
+ * synth.h - Synthetic RemoteID traffic for stress runs.
+ *
+ * Frames are built with the same opendroneid encoders the transmitters
+ * use: NAN action frames and beacons from
+ * odid_wifi_build_message_pack_*_frame(), legacy BLE adverts carrying one
+ * message each, and BT5 extended adverts carrying a whole message pack.
+ * The four kinds are interleaved round-robin across the drones, and every
+ * frame moves its drone a little so the tracker always has fresh state.
+ */
+
+#ifndef _SYNTH_H_
+#define _SYNTH_H_
+
+#include <stdint.h>
+#include <vector>
+#include "pcap_io.h"
+
+// Appends count frames from drones transmitters (MACs 02:00:00:xx:xx:xx).
+void synth_frames(uint32_t count, uint32_t drones, std::vector<bench_frame> *out);
+
+#endif // _SYNTH_H_
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include "channel_sched.h"
+#include "detection_json.h"
+
+#define CHAN_STRIDE (1u << 24)
+
+void chan_sched_init(chan_sched *s, uint16_t min_dwell_ms, uint16_t max_dwell_ms,
+                     uint32_t revisit_ms) {
+  memset(s->ch, 0, sizeof(s->ch));
+  s->count = 0;
+  s->current = -1;
+  s->min_dwell_ms = min_dwell_ms;
+  s->max_dwell_ms = max_dwell_ms < min_dwell_ms ? min_dwell_ms : max_dwell_ms;
+  s->revisit_ms = revisit_ms;
+  s->forced_revisits = 0;
+  dc_lock_init(&s->lock);
+}
+
+int chan_sched_add(chan_sched *s, uint8_t channel, uint8_t band) {
+  if (s->count >= CHAN_SCHED_MAX) return -1;
+  chan_stat *c = &s->ch[s->count];
+  c->channel = channel;
+  c->band = band;
+  c->dwell_ms = s->min_dwell_ms;
+  return s->count++;
+}
+
+void chan_sched_hit(chan_sched *s, uint8_t channel) {
+  dc_lock(&s->lock);
+  for (int i = 0; i < s->count; i++) {
+    if (s->ch[i].channel == channel) {
+      s->ch[i].hits++;
+      s->ch[i].pending_hits++;
+      break;
+    }
+  }
+  dc_unlock(&s->lock);
+}
+
+// Fold the hits seen since the last visit ended into the channel's rate
+static void close_dwell(chan_stat *c, uint32_t now) {
+  uint32_t spent = now - c->last_visit;
+  c->time_ms += spent;
+  if (spent == 0) spent = 1;
+  uint32_t sample = (uint32_t)(((uint64_t)c->pending_hits * 100 * 256) / spent);
+  c->rate_q8 = (c->rate_q8 * 7 + sample) / 8;
+  c->pending_hits = 0;
+}
+
+const chan_stat *chan_sched_next(chan_sched *s, uint32_t now, uint16_t *dwell_ms) {
+  if (s->count == 0) return nullptr;
+
+  dc_lock(&s->lock);
+  if (s->current >= 0) close_dwell(&s->ch[s->current], now);
+
+  // Revisit guarantee first: the channel waiting longest past revisit_ms
+  int pick = -1;
+  uint32_t worst_wait = 0;
+  for (int i = 0; i < s->count; i++) {
+    if (i == s->current) continue;
+    uint32_t wait = now - s->ch[i].last_visit;
+    if (s->ch[i].visits == 0 || wait >= s->revisit_ms) {
+      if (pick < 0 || wait > worst_wait) {
+        pick = i;
+        worst_wait = wait;
+      }
+    }
+  }
+  if (pick >= 0) {
+    if (s->ch[pick].visits > 0) s->forced_revisits++;
+  } else {
+    // Otherwise the lowest stride pass; busy channels advance more slowly
+    for (int i = 0; i < s->count; i++) {
+      if (pick < 0 || (int32_t)(s->ch[i].pass - s->ch[pick].pass) < 0) pick = i;
+    }
+  }
+
+  chan_stat *c = &s->ch[pick];
+  c->pass += CHAN_STRIDE / (256 + c->rate_q8) * 256;
+  // Keep passes of rarely picked channels from falling far behind
+  for (int i = 0; i < s->count; i++) {
+    if ((int32_t)(c->pass - s->ch[i].pass) > (int32_t)(CHAN_STRIDE * 2))
+      s->ch[i].pass = c->pass - CHAN_STRIDE * 2;
+  }
+
+  uint32_t span = s->max_dwell_ms - s->min_dwell_ms;
+  c->dwell_ms = (uint16_t)(s->min_dwell_ms + span * c->rate_q8 / (c->rate_q8 + CHAN_RATE_HALF));
+  c->last_visit = now;
+  c->visits++;
+  s->current = (int8_t)pick;
+  *dwell_ms = c->dwell_ms;
+  dc_unlock(&s->lock);
+  return c;
+}
+
+int chan_sched_format_json(chan_sched *s, char *buf, size_t size) {
+  // Snapshot under the lock, format outside it
+  chan_stat snap[CHAN_SCHED_MAX];
+  dc_lock(&s->lock);
+  int count = s->count;
+  memcpy(snap, s->ch, sizeof(snap));
+  dc_unlock(&s->lock);
+
+  int len = snprintf(buf, size, "[");
+  for (int i = 0; i < count && len < (int)size; i++) {
+    const chan_stat *c = &snap[i];
+    len += snprintf(buf + len, size - len,
+                    "%s{\"ch\":%u,\"band\":\"%s\",\"hits\":%u,\"visits\":%u,"
+                    "\"time_ms\":%u,\"dwell_ms\":%u,\"rate\":%u.%02u}",
+                    i ? "," : "", c->channel, bandToString(c->band),
+                    (unsigned)c->hits, (unsigned)c->visits, (unsigned)c->time_ms,
+                    c->dwell_ms,
+                    (unsigned)(c->rate_q8 * 10 / 256),
+                    (unsigned)((c->rate_q8 * 1000 / 256) % 100));
+  }
+  if (len < (int)size) len += snprintf(buf + len, size - len, "]");
+  return len;
+}
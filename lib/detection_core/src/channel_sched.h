@@ -0,0 +1,68 @@
+/*
+ * channel_sched.h - Adaptive WiFi channel hopping.
+ *
+ * Channels that recently produced RemoteID frames get visited more often
+ * (stride scheduling weighted by hit rate) and for longer (dwell between
+ * min_dwell_ms and max_dwell_ms). A quiet channel is still revisited
+ * within revisit_ms, so new drones keep being discovered there.
+ *
+ * The hop task calls chan_sched_next() at the end of every dwell; the
+ * decode path reports hits with chan_sched_hit(). Both take s->lock.
+ */
+
+#ifndef _CHANNEL_SCHED_H_
+#define _CHANNEL_SCHED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dc_port.h"
+
+#ifndef CHAN_SCHED_MAX
+#define CHAN_SCHED_MAX 8
+#endif
+
+// Hit rate (hits per 100 ms, Q8) at which dwell is halfway to max
+#define CHAN_RATE_HALF 256
+
+struct chan_stat {
+  uint8_t  channel;
+  uint8_t  band;          // WiFiBand
+  uint16_t dwell_ms;      // dwell chosen on the latest visit
+  uint32_t rate_q8;       // EWMA of hits per 100 ms of dwell, Q8
+  uint32_t pass;          // stride scheduler position
+  uint32_t last_visit;    // millis() the latest visit started
+  uint32_t pending_hits;  // hits not yet folded into rate_q8
+  uint32_t hits;
+  uint32_t visits;
+  uint32_t time_ms;       // total time spent on this channel
+};
+
+struct chan_sched {
+  chan_stat ch[CHAN_SCHED_MAX];
+  uint8_t   count;
+  int8_t    current;      // index of the channel being dwelt on, -1 at start
+  uint16_t  min_dwell_ms;
+  uint16_t  max_dwell_ms;
+  uint32_t  revisit_ms;
+  uint32_t  forced_revisits;  // picks made by the revisit guarantee
+  dc_lock_t lock;
+};
+
+void chan_sched_init(chan_sched *s, uint16_t min_dwell_ms, uint16_t max_dwell_ms,
+                     uint32_t revisit_ms);
+
+// Returns the channel's index, or -1 when the table is full.
+int chan_sched_add(chan_sched *s, uint8_t channel, uint8_t band);
+
+// One decoded RemoteID frame captured on channel.
+void chan_sched_hit(chan_sched *s, uint8_t channel);
+
+// Close the current dwell and pick the next channel; *dwell_ms is how long
+// to stay. Never returns nullptr once a channel has been added.
+const chan_stat *chan_sched_next(chan_sched *s, uint32_t now, uint16_t *dwell_ms);
+
+// [{"ch":6,"band":"2.4GHz","hits":..,"visits":..,"time_ms":..,"dwell_ms":..,
+//   "rate":hits per second}, ...]. Returns the snprintf length.
+int chan_sched_format_json(chan_sched *s, char *buf, size_t size);
+
+#endif // _CHANNEL_SCHED_H_
@@ -0,0 +1,146 @@
+/*
+ * dc_config.h - Board, radio, output and core choices of a firmware build.
+ *
+ * The mains used to settle these one by one: a board block in
+ * remoteid-c5-5g, tasks pinned to core 1 everywhere else (also on the
+ * single-core C6), NimBLE and Serial1 compiled in whether a build used
+ * them or not. Everything here follows from the IDF target and -D flags,
+ * so the same main builds for each of its boards and a path the build
+ * does not want is left out by the preprocessor instead of skipped at
+ * run time:
+ *
+ *   DC_BOARD_NAME      from CONFIG_IDF_TARGET_*
+ *   DC_CORES           cores FreeRTOS schedules on
+ *   DC_CORE_WORK       where the decode/printer/scan tasks go: core 1 on
+ *                      dual-core chips (the WiFi and BT controllers run
+ *                      on core 0), tskNO_AFFINITY on single-core ones
+ *   DC_RADIO_BLE       BLE scanning; 0 drops NimBLE, its scan task and
+ *                      the host stack's RAM. Default: the SoC has BLE
+ *   DC_RADIO_5GHZ      5 GHz channels in the scan plan (C5 only)
+ *   DC_OUT_MESH        Serial1 uplink to the Heltec (mesh scheduler,
+ *                      text lines or RIDB frames); 0 for USB-only builds
+ *   USB_BINARY_OUTPUT  USB detections as usb_record.h records instead of
+ *                      JSON lines, in the firmwares that support it
+ *
+ * dc_config mirrors the lot as constexpr for code that branches with
+ * if constexpr, and dc_config_format_json() reports the build in the
+ * status lines.
+ */
+
+#ifndef _DC_CONFIG_H_
+#define _DC_CONFIG_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <sdkconfig.h>
+#include <soc/soc_caps.h>
+#include <freertos/FreeRTOS.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Board
+// ---------------------------------------------------------------------------
+
+#if defined(CONFIG_IDF_TARGET_ESP32C5) || defined(ARDUINO_XIAO_ESP32C5)
+#define DC_BOARD_C5 1
+#define DC_BOARD_NAME "XIAO ESP32-C5"
+#elif defined(CONFIG_IDF_TARGET_ESP32C6)
+#define DC_BOARD_NAME "XIAO ESP32-C6"
+#elif defined(CONFIG_IDF_TARGET_ESP32C3)
+#define DC_BOARD_NAME "XIAO ESP32-C3"
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
+#define DC_BOARD_NAME "XIAO ESP32-S3"
+#else
+#define DC_BOARD_NAME "ESP32"
+#endif
+#ifndef DC_BOARD_C5
+#define DC_BOARD_C5 0
+#endif
+
+// ---------------------------------------------------------------------------
+// Cores
+// ---------------------------------------------------------------------------
+
+#if defined(CONFIG_FREERTOS_UNICORE) && CONFIG_FREERTOS_UNICORE
+#define DC_CORES 1
+#elif defined(SOC_CPU_CORES_NUM)
+#define DC_CORES SOC_CPU_CORES_NUM
+#else
+#define DC_CORES 1
+#endif
+
+#ifndef DC_CORE_WORK
+#if DC_CORES > 1
+#define DC_CORE_WORK 1
+#else
+#define DC_CORE_WORK tskNO_AFFINITY
+#endif
+#endif
+
+// ---------------------------------------------------------------------------
+// Radios
+// ---------------------------------------------------------------------------
+
+#ifndef DC_RADIO_BLE
+#if defined(SOC_BT_SUPPORTED) && SOC_BT_SUPPORTED
+#define DC_RADIO_BLE 1
+#else
+#define DC_RADIO_BLE 0
+#endif
+#endif
+
+#ifndef DC_RADIO_5GHZ
+#define DC_RADIO_5GHZ DC_BOARD_C5
+#endif
+#if DC_RADIO_5GHZ && !DC_BOARD_C5
+#error "DC_RADIO_5GHZ needs a dual-band target (ESP32-C5)"
+#endif
+
+// ---------------------------------------------------------------------------
+// Output sinks
+// ---------------------------------------------------------------------------
+
+#ifndef DC_OUT_MESH
+#define DC_OUT_MESH 1
+#endif
+
+// 0: one JSON line per detection (default). 1: CRC-checked binary
+// records (usb_record.h), one batched write per printer drain, at
+// USB_SERIAL_BAUD. Status lines stay JSON either way.
+#ifndef USB_BINARY_OUTPUT
+#define USB_BINARY_OUTPUT 0
+#endif
+#ifndef USB_SERIAL_BAUD
+#if USB_BINARY_OUTPUT
+#define USB_SERIAL_BAUD 921600
+#else
+#define USB_SERIAL_BAUD 115200
+#endif
+#endif
+
+#ifdef __cplusplus
+struct dc_config {
+  static constexpr const char *board = DC_BOARD_NAME;
+  static constexpr int  cores       = DC_CORES;
+  static constexpr bool single_core = DC_CORES == 1;
+  static constexpr bool ble         = DC_RADIO_BLE;
+  static constexpr bool wifi_5ghz   = DC_RADIO_5GHZ;
+  static constexpr bool mesh        = DC_OUT_MESH;
+  static constexpr bool usb_binary  = USB_BINARY_OUTPUT;
+};
+#endif
+
+// "build":{"board":..,"cores":..,"ble":..,"5ghz":..,"mesh":..,"usb":..}.
+// Returns the snprintf length.
+static inline int dc_config_format_json(char *buf, size_t size) {
+  return snprintf(buf, size,
+                  "\"build\":{\"board\":\"%s\",\"cores\":%d,\"ble\":%s,\"5ghz\":%s,"
+                  "\"mesh\":%s,\"usb\":\"%s\"}",
+                  DC_BOARD_NAME, DC_CORES, DC_RADIO_BLE ? "true" : "false",
+                  DC_RADIO_5GHZ ? "true" : "false", DC_OUT_MESH ? "true" : "false",
+                  USB_BINARY_OUTPUT ? "binary" : "json");
+}
+
+#endif // _DC_CONFIG_H_
@@ -0,0 +1,182 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "dc_metrics.h"
+#include "dc_port.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32) && configGENERATE_RUN_TIME_STATS
+#define DC_RUN_TIME_STATS 1
+#define DC_CORES          portNUM_PROCESSORS
+#else
+#define DC_RUN_TIME_STATS 0
+#endif
+
+static const char *const msg_names[DC_MSG_TYPES] = {
+  "basic_id", "location", "auth", "self_id", "system", "operator_id", "pack"
+};
+
+void dc_decode_stats_add(dc_decode_stats *sum, const dc_decode_stats *add) {
+  for (int i = 0; i < DC_FRAME_TYPES; i++) sum->seen[i] += add->seen[i];
+  for (int i = 0; i < DC_MSG_TYPES; i++) {
+    sum->ok[i] += add->ok[i];
+    sum->fail[i] += add->fail[i];
+  }
+}
+
+void dc_latency_record(dc_latency_hist *h, uint32_t us) {
+  // Bucket i holds [BASE << (i - 1), BASE << i); bucket 0 everything below BASE
+  int bits = us ? 32 - __builtin_clz(us) : 0;
+  int i = bits - 8;  // log2(DC_LAT_BASE_US) == 8
+  if (i < 0) i = 0;
+  if (i >= DC_LAT_BUCKETS) i = DC_LAT_BUCKETS - 1;
+  h->bucket[i]++;
+  h->count++;
+  h->sum_us += us;
+  if (us > h->max_us) h->max_us = us;
+}
+
+void dc_metrics_init(dc_metrics *m) {
+  memset(m, 0, sizeof(*m));
+}
+
+void dc_metrics_add_task(dc_metrics *m, const char *name, void *task_handle,
+                         uint32_t stack_bytes) {
+  if (!task_handle || m->task_count >= DC_METRICS_MAX_TASKS) return;
+  dc_task_entry *e = &m->tasks[m->task_count++];
+  e->name = name;
+  e->handle = task_handle;
+  e->stack_bytes = stack_bytes;
+#if DC_RUN_TIME_STATS
+  e->last_runtime = ulTaskGetRunTimeCounter((TaskHandle_t)task_handle);
+#endif
+}
+
+// Appends to buf at *len with snprintf semantics; *len keeps counting
+// past size so the caller gets the full length back
+__attribute__((format(printf, 4, 5)))
+static void put(char *buf, size_t size, int *len, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  size_t at = (size_t)*len < size ? (size_t)*len : size;
+  int n = vsnprintf(buf + at, size - at, fmt, ap);
+  va_end(ap);
+  if (n > 0) *len += n;
+}
+
+static void put_counts(char *buf, size_t size, int *len, const char *key,
+                       const uint32_t *v) {
+  put(buf, size, len, ",\"%s\":{", key);
+  for (int i = 0; i < DC_MSG_TYPES; i++)
+    put(buf, size, len, "%s\"%s\":%u", i ? "," : "", msg_names[i], (unsigned)v[i]);
+  put(buf, size, len, "}");
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+// ,"heap":{...}: all byte-addressable heap, plus internal RAM on its own
+// since PSRAM can hide an exhausted internal heap
+static void put_heap(char *buf, size_t size, int *len) {
+  put(buf, size, len,
+      ",\"heap\":{\"free\":%u,\"min_free\":%u,\"largest\":%u,"
+      "\"internal_free\":%u,\"internal_largest\":%u}",
+      (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+      (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+      (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+      (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+      (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+}
+
+// "name":{"stack":..,"stack_free":.. without the closing brace
+static void put_task_stack(char *buf, size_t size, int *len, const dc_task_entry *e,
+                           bool first) {
+  // StackType_t is a byte on ESP-IDF, so the high water mark is in bytes
+  put(buf, size, len, "%s\"%s\":{\"stack\":%u,\"stack_free\":%u", first ? "" : ",",
+      e->name, (unsigned)e->stack_bytes,
+      (unsigned)uxTaskGetStackHighWaterMark((TaskHandle_t)e->handle));
+}
+#endif
+
+int dc_metrics_format_footprint(dc_metrics *m, char *buf, size_t size) {
+  int len = 0;
+  if (size) buf[0] = '\0';
+  put(buf, size, &len, "{\"footprint\":{\"uptime_ms\":%u", (unsigned)dc_millis());
+#if defined(ARDUINO_ARCH_ESP32)
+  put_heap(buf, size, &len);
+  uint32_t stacks = 0;
+  for (int i = 0; i < m->task_count; i++) stacks += m->tasks[i].stack_bytes;
+  put(buf, size, &len, ",\"task_stacks\":%u,\"tasks\":{", (unsigned)stacks);
+  for (int i = 0; i < m->task_count; i++) {
+    put_task_stack(buf, size, &len, &m->tasks[i], i == 0);
+    put(buf, size, &len, "}");
+  }
+  put(buf, size, &len, "}");
+#else
+  (void)m;  // no heap or task figures off target
+#endif
+  put(buf, size, &len, "}}");
+  return len;
+}
+
+int dc_metrics_format_json(dc_metrics *m, char *buf, size_t size,
+                           const dc_decode_stats *decode,
+                           uint32_t ring_drops, uint32_t evictions) {
+  int len = 0;
+  if (size) buf[0] = '\0';
+  put(buf, size, &len, "{\"metrics\":{\"uptime_ms\":%u", (unsigned)dc_millis());
+  put(buf, size, &len, ",\"frames\":{\"nan\":%u,\"beacon\":%u,\"ble\":%u}",
+      (unsigned)decode->seen[DC_FRAME_NAN], (unsigned)decode->seen[DC_FRAME_BEACON],
+      (unsigned)decode->seen[DC_FRAME_BLE]);
+  put_counts(buf, size, &len, "decode_ok", decode->ok);
+  put_counts(buf, size, &len, "decode_fail", decode->fail);
+  put(buf, size, &len, ",\"ring_drops\":%u,\"evictions\":%u",
+      (unsigned)ring_drops, (unsigned)evictions);
+
+  const dc_latency_hist *h = &m->latency;
+  put(buf, size, &len, ",\"latency_us\":{\"base\":%d,\"buckets\":[", DC_LAT_BASE_US);
+  for (int i = 0; i < DC_LAT_BUCKETS; i++)
+    put(buf, size, &len, "%s%u", i ? "," : "", (unsigned)h->bucket[i]);
+  put(buf, size, &len, "],\"count\":%u,\"avg\":%u,\"max\":%u}",
+      (unsigned)h->count, (unsigned)(h->count ? h->sum_us / h->count : 0),
+      (unsigned)h->max_us);
+
+#if defined(ARDUINO_ARCH_ESP32)
+#if DC_RUN_TIME_STATS
+  uint32_t wall = (uint32_t)portGET_RUN_TIME_COUNTER_VALUE();
+  uint32_t span = wall - m->last_wall;
+  m->last_wall = wall;
+#endif
+  put_heap(buf, size, &len);
+  put(buf, size, &len, ",\"tasks\":{");
+  for (int i = 0; i < m->task_count; i++) {
+    dc_task_entry *e = &m->tasks[i];
+    put_task_stack(buf, size, &len, e, i == 0);
+#if DC_RUN_TIME_STATS
+    uint32_t rt = ulTaskGetRunTimeCounter((TaskHandle_t)e->handle);
+    put(buf, size, &len, ",\"cpu_pct\":%u",
+        (unsigned)(span ? (uint64_t)(rt - e->last_runtime) * 100 / span : 0));
+    e->last_runtime = rt;
+#endif
+    put(buf, size, &len, "}");
+  }
+  put(buf, size, &len, "}");
+#if DC_RUN_TIME_STATS
+  // Busy share per core: whatever its idle task did not get
+  put(buf, size, &len, ",\"cpu_pct\":[");
+  for (int c = 0; c < DC_CORES && c < 2; c++) {
+    uint32_t idle = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(c));
+    uint32_t idle_pct = span ? (uint32_t)((uint64_t)(idle - m->last_idle[c]) * 100 / span) : 100;
+    if (idle_pct > 100) idle_pct = 100;
+    put(buf, size, &len, "%s%u", c ? "," : "", (unsigned)(100 - idle_pct));
+    m->last_idle[c] = idle;
+  }
+  put(buf, size, &len, "]");
+#endif
+#endif
+  put(buf, size, &len, "}}");
+  return len;
+}
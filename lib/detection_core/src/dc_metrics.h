@@ -0,0 +1,102 @@
+/*
+ * dc_metrics.h - Hot-path counters and the periodic {"metrics":...} record.
+ *
+ * Decode counters live in each odid_decoder (one writer per task, so no
+ * locking); the firmware sums them at report time. Detection latency runs
+ * from frame capture (RX callback or BLE onResult) to the end of the USB
+ * write and is kept as a log2 histogram by the printer task. Stack and
+ * CPU figures come from FreeRTOS for the tasks registered here; CPU time
+ * needs configGENERATE_RUN_TIME_STATS and is left out without it. Heap
+ * free/minimum/largest-block figures ride along in every record, and the
+ * same memory picture is printed once at boot as {"footprint":...}.
+ *
+ * Build with -DDC_METRICS=0 to compile the counters and the record out.
+ */
+
+#ifndef _DC_METRICS_H_
+#define _DC_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef DC_METRICS
+#define DC_METRICS 1
+#endif
+
+#if DC_METRICS
+#define DC_METRIC_INC(x) ((x)++)
+#else
+#define DC_METRIC_INC(x) ((void)0)
+#endif
+
+#ifndef DC_METRICS_INTERVAL_MS
+#define DC_METRICS_INTERVAL_MS 10000    // Period of the metrics record
+#endif
+
+#define DC_LAT_BUCKETS       12         // [0,256us), [256,512us) ... [262ms,inf)
+#define DC_LAT_BASE_US       256
+#define DC_METRICS_MAX_TASKS 8
+
+enum dc_frame_type {
+  DC_FRAME_NAN = 0,     // NAN action frame addressed to the ODID cluster
+  DC_FRAME_BEACON,      // Beacon carrying an ODID vendor IE
+  DC_FRAME_BLE,         // Advertisement carrying ODID service data
+  DC_FRAME_TYPES
+};
+
+// ODID message types 0..5 (ODID_MESSAGETYPE_*) plus message packs
+#define DC_MSG_PACKED 6
+#define DC_MSG_TYPES  7
+
+struct dc_decode_stats {
+  uint32_t seen[DC_FRAME_TYPES];  // ODID-shaped frames handed to the decoder
+  uint32_t ok[DC_MSG_TYPES];      // messages decoded, by type
+  uint32_t fail[DC_MSG_TYPES];    // rejected singles by type, packs as a whole
+};
+
+struct dc_latency_hist {
+  uint32_t bucket[DC_LAT_BUCKETS];
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t sum_us;
+};
+
+struct dc_task_entry {
+  const char *name;
+  void       *handle;             // TaskHandle_t
+  uint32_t    stack_bytes;        // allocated stack, 0 if unknown
+  uint32_t    last_runtime;
+};
+
+struct dc_metrics {
+  dc_latency_hist latency;        // printer task only
+  dc_task_entry   tasks[DC_METRICS_MAX_TASKS];
+  uint8_t         task_count;
+  uint32_t        last_wall;      // run-time counter at the previous report
+  uint32_t        last_idle[2];   // idle task run time per core
+};
+
+// sum += add, field by field
+void dc_decode_stats_add(dc_decode_stats *sum, const dc_decode_stats *add);
+
+void dc_latency_record(dc_latency_hist *h, uint32_t us);
+
+void dc_metrics_init(dc_metrics *m);
+
+// Report stack high water and CPU share for a task. name must outlive m.
+void dc_metrics_add_task(dc_metrics *m, const char *name, void *task_handle,
+                         uint32_t stack_bytes);
+
+// {"metrics":{...}} with the decode totals, ring drops and tracker
+// evictions passed in. Per-task and per-core CPU percentages cover the
+// time since the previous call. Returns the snprintf length.
+int dc_metrics_format_json(dc_metrics *m, char *buf, size_t size,
+                           const dc_decode_stats *decode,
+                           uint32_t ring_drops, uint32_t evictions);
+
+// {"footprint":{"heap":{...},"task_stacks":..,"tasks":{...}}}: heap
+// state and stack size/high water of every registered task, for the boot
+// report. Returns the snprintf length.
+int dc_metrics_format_footprint(dc_metrics *m, char *buf, size_t size);
+
+#endif // _DC_METRICS_H_
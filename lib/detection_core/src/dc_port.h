@@ -0,0 +1,45 @@
+/*
+ * dc_port.h - Platform shim for the detection core.
+ *
+ * On the ESP32 firmwares this maps onto Arduino millis(), FreeRTOS
+ * spinlocks and the PSRAM-aware heap. Host builds (native benchmarks/replay) are single-threaded,
+ * so locks compile away and the harness provides dc_millis()/dc_micros().
+ */
+
+#ifndef _DC_PORT_H_
+#define _DC_PORT_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <esp_heap_caps.h>
+
+typedef portMUX_TYPE dc_lock_t;
+#define dc_lock_init(l)  portMUX_INITIALIZE(l)
+#define dc_lock(l)       portENTER_CRITICAL(l)
+#define dc_unlock(l)     portEXIT_CRITICAL(l)
+
+static inline uint32_t dc_millis(void) { return millis(); }
+static inline uint32_t dc_micros(void) { return micros(); }
+
+// Zeroed buffer for bulk tables: PSRAM if fitted, else internal heap
+static inline void *dc_calloc_large(size_t size) {
+  void *p = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return p ? p : calloc(1, size);
+}
+#else
+typedef int dc_lock_t;
+#define dc_lock_init(l)  (*(l) = 0)
+#define dc_lock(l)       ((void)(l))
+#define dc_unlock(l)     ((void)(l))
+
+uint32_t dc_millis(void);
+uint32_t dc_micros(void);
+
+static inline void *dc_calloc_large(size_t size) { return calloc(1, size); }
+#endif
+
+#endif // _DC_PORT_H_
@@ -0,0 +1,64 @@
+/*
+ * dc_task.h - Statically allocated FreeRTOS tasks for the firmwares.
+ *
+ * Stacks and TCBs live in .bss, so they show up in the link-time RAM
+ * figure and days of uptime cannot fragment the heap around them. Sizes
+ * are in bytes (StackType_t is a byte on ESP-IDF) and cover each task's
+ * deepest path with about 1 KB to spare; the stack_free figures of the
+ * {"footprint":...} and {"metrics":...} records show the real margin.
+ * Override with -D per build.
+ */
+
+#ifndef _DC_TASK_H_
+#define _DC_TASK_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Ring drain + decode + tracker store
+#ifndef DC_STACK_WIFI_DECODE
+#define DC_STACK_WIFI_DECODE 3072
+#endif
+// Tracker drain, JSON/binary USB output, mesh lines (snprintf)
+#ifndef DC_STACK_PRINTER
+#define DC_STACK_PRINTER     4096
+#endif
+// Blocking NimBLE getResults() loop; callbacks run in the host task
+#ifndef DC_STACK_BLE_SCAN
+#define DC_STACK_BLE_SCAN    3072
+#endif
+// Channel scheduler pick + esp_wifi_set_channel(), Serial.printf at start
+#ifndef DC_STACK_CHAN_HOP
+#define DC_STACK_CHAN_HOP    3072
+#endif
+// UART line reader echoing to USB
+#ifndef DC_STACK_UART_FW
+#define DC_STACK_UART_FW     3072
+#endif
+// Flash log pacing and page writes, USB replay batches
+#ifndef DC_STACK_FLASH_LOG
+#define DC_STACK_FLASH_LOG   3072
+#endif
+
+// Arduino's loopTask, for the reports
+#ifdef CONFIG_ARDUINO_LOOP_STACK_SIZE
+#define DC_LOOP_STACK_BYTES CONFIG_ARDUINO_LOOP_STACK_SIZE
+#else
+#define DC_LOOP_STACK_BYTES 0
+#endif
+
+// Declares var##Stack and var##Tcb at file scope
+#define DC_STATIC_TASK(var, stack_bytes)                                   \
+  static StackType_t var##Stack[(stack_bytes) / sizeof(StackType_t)];      \
+  static StaticTask_t var##Tcb
+
+#define DC_TASK_STACK_BYTES(var) ((uint32_t)sizeof(var##Stack))
+
+// Starts a task declared with DC_STATIC_TASK; returns its handle. core is
+// 0/1, or tskNO_AFFINITY on single-core chips.
+#define DC_START_TASK(var, fn, name, prio, core)                           \
+  xTaskCreateStaticPinnedToCore(fn, name,                                  \
+                                sizeof(var##Stack) / sizeof(StackType_t),  \
+                                nullptr, prio, var##Stack, &var##Tcb, core)
+
+#endif // _DC_TASK_H_
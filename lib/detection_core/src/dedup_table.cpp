@@ -0,0 +1,147 @@
+#include <string.h>
+#include "dedup_table.h"
+
+// Same Fibonacci hash as uav_tracker; the low (NIC) bytes carry most entropy
+static inline uint32_t dedup_hash(const uint8_t *mac) {
+  uint32_t h = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+                (uint32_t)mac[4] << 8  | mac[5]) ^
+               ((uint32_t)mac[0] << 8 | mac[1]);
+  return (h * 2654435769u) & DEDUP_INDEX_MASK;
+}
+
+// Index position holding mac, or the empty position where it would go
+static uint32_t index_probe(const dedup_table *t, const uint8_t *mac) {
+  uint32_t i = dedup_hash(mac);
+  while (t->index[i] != 0 &&
+         memcmp(t->entries[t->index[i] - 1].mac, mac, 6) != 0)
+    i = (i + 1) & DEDUP_INDEX_MASK;
+  return i;
+}
+
+// Backward-shift delete so probe chains never need tombstones
+static void index_remove(dedup_table *t, uint32_t hole) {
+  uint32_t j = hole;
+  for (;;) {
+    j = (j + 1) & DEDUP_INDEX_MASK;
+    uint16_t r = t->index[j];
+    if (r == 0) break;
+    uint32_t home = dedup_hash(t->entries[r - 1].mac);
+    if (((j - home) & DEDUP_INDEX_MASK) < ((j - hole) & DEDUP_INDEX_MASK)) continue;
+    t->index[hole] = r;
+    hole = j;
+  }
+  t->index[hole] = 0;
+}
+
+static void wheel_unlink(dedup_table *t, uint16_t n) {
+  dedup_entry *e = &t->entries[n];
+  if (e->wheel_prev != DEDUP_NIL) t->entries[e->wheel_prev].wheel_next = e->wheel_next;
+  else t->wheel[e->wheel_slot] = e->wheel_next;
+  if (e->wheel_next != DEDUP_NIL) t->entries[e->wheel_next].wheel_prev = e->wheel_prev;
+}
+
+// Slot of the first tick at or after last_seen + DEDUP_STALE_MS
+static uint16_t wheel_slot_for(const dedup_table *t, uint32_t last_seen) {
+  int32_t ahead = (int32_t)(last_seen + DEDUP_STALE_MS - t->wheel_ms);
+  uint32_t ticks = ahead <= 0 ? 0 : ((uint32_t)ahead + DEDUP_WHEEL_TICK_MS - 1) / DEDUP_WHEEL_TICK_MS;
+  if (ticks > DEDUP_WHEEL_SLOTS - 1) ticks = DEDUP_WHEEL_SLOTS - 1;
+  return (uint16_t)((t->wheel_tick + ticks) % DEDUP_WHEEL_SLOTS);
+}
+
+static void wheel_link(dedup_table *t, uint16_t n) {
+  dedup_entry *e = &t->entries[n];
+  e->wheel_slot = wheel_slot_for(t, e->last_seen);
+  e->wheel_prev = DEDUP_NIL;
+  e->wheel_next = t->wheel[e->wheel_slot];
+  if (e->wheel_next != DEDUP_NIL) t->entries[e->wheel_next].wheel_prev = n;
+  t->wheel[e->wheel_slot] = n;
+}
+
+static void entry_release(dedup_table *t, uint16_t n) {
+  wheel_unlink(t, n);
+  index_remove(t, index_probe(t, t->entries[n].mac));
+  t->entries[n].wheel_next = t->free_head;
+  t->free_head = n;
+  t->count--;
+}
+
+void dedup_table_init(dedup_table *t, uint32_t now) {
+  memset(t->index, 0, sizeof(t->index));
+  for (int i = 0; i < DEDUP_WHEEL_SLOTS; i++) t->wheel[i] = DEDUP_NIL;
+  for (int i = 0; i < DEDUP_TABLE_CAPACITY; i++)
+    t->entries[i].wheel_next = (i + 1 < DEDUP_TABLE_CAPACITY) ? i + 1 : DEDUP_NIL;
+  t->free_head = 0;
+  t->count = 0;
+  t->wheel_tick = 0;
+  t->wheel_ms = now;
+  t->evictions = 0;
+  t->expired = 0;
+}
+
+dedup_entry *dedup_table_find(dedup_table *t, const uint8_t *mac) {
+  uint16_t r = t->index[index_probe(t, mac)];
+  return r ? &t->entries[r - 1] : nullptr;
+}
+
+dedup_entry *dedup_table_alloc(dedup_table *t, const uint8_t *mac, uint32_t now) {
+  if (t->free_head == DEDUP_NIL) {
+    // Table full: recycle the head of the earliest non-empty slot
+    for (uint32_t k = 0; k < DEDUP_WHEEL_SLOTS; k++) {
+      uint16_t n = t->wheel[(t->wheel_tick + k) % DEDUP_WHEEL_SLOTS];
+      if (n != DEDUP_NIL) {
+        entry_release(t, n);
+        t->evictions++;
+        break;
+      }
+    }
+  }
+
+  uint16_t n = t->free_head;
+  dedup_entry *e = &t->entries[n];
+  t->free_head = e->wheel_next;
+  memset(e, 0, sizeof(*e));
+  memcpy(e->mac, mac, 6);
+  e->last_seen = now;
+  e->newest_ts = TIME_SYNC_NONE;
+  t->index[index_probe(t, mac)] = n + 1;
+  wheel_link(t, n);
+  t->count++;
+  return e;
+}
+
+void dedup_table_touch(dedup_table *t, dedup_entry *e, uint32_t now) {
+  e->last_seen = now;
+  uint16_t n = (uint16_t)(e - t->entries);
+  if (wheel_slot_for(t, now) == e->wheel_slot) return;
+  wheel_unlink(t, n);
+  wheel_link(t, n);
+}
+
+bool dedup_table_expire(dedup_table *t, uint32_t now, dedup_entry *out) {
+  // Never walk more than one lap, however long expiry was not called
+  if ((int32_t)(now - t->wheel_ms) >= (int32_t)(DEDUP_WHEEL_SLOTS * DEDUP_WHEEL_TICK_MS)) {
+    uint32_t skip = (now - t->wheel_ms) / DEDUP_WHEEL_TICK_MS - (DEDUP_WHEEL_SLOTS - 1);
+    t->wheel_tick += skip;
+    t->wheel_ms += skip * DEDUP_WHEEL_TICK_MS;
+  }
+
+  while ((int32_t)(now - t->wheel_ms) >= 0) {
+    uint16_t slot = t->wheel_tick % DEDUP_WHEEL_SLOTS;
+    uint16_t n;
+    while ((n = t->wheel[slot]) != DEDUP_NIL) {
+      if (now - t->entries[n].last_seen >= DEDUP_STALE_MS) {
+        if (out) *out = t->entries[n];
+        entry_release(t, n);
+        t->expired++;
+        return true;
+      }
+      // Linked while the wheel lagged (clamped) or due a lap later:
+      // rehome it, which always lands in a later slot
+      wheel_unlink(t, n);
+      wheel_link(t, n);
+    }
+    t->wheel_tick++;
+    t->wheel_ms += DEDUP_WHEEL_TICK_MS;
+  }
+  return false;
+}
@@ -0,0 +1,89 @@
+/*
+ * dedup_table.h - Home node multi-node dedup state, keyed on binary MAC.
+ *
+ * Same layout as uav_tracker: a fixed entry pool, a linear-probed index
+ * of pool positions (0 = empty) and backward-shift deletion, so lookup
+ * cost does not grow with the number of drones tracked.
+ *
+ * Stale expiry uses a timing wheel instead of sweeping the table. Every
+ * entry sits in the wheel slot of the tick its last_seen + DEDUP_STALE_MS
+ * falls in; a touch moves it to its new slot and expiry only looks at the
+ * slots the clock has passed. When the pool is full the entry in the
+ * earliest non-empty slot (the least recently seen, to one tick) is
+ * recycled.
+ *
+ * Single-threaded: the home node only touches it from loop().
+ */
+
+#ifndef _DEDUP_TABLE_H_
+#define _DEDUP_TABLE_H_
+
+#include <stdint.h>
+#include "opendroneid.h"
+#include "mesh_frame.h"
+
+// Drones tracked at once. Must be a power of two (index sizing).
+#ifndef DEDUP_TABLE_CAPACITY
+#define DEDUP_TABLE_CAPACITY 256
+#endif
+
+#if (DEDUP_TABLE_CAPACITY & (DEDUP_TABLE_CAPACITY - 1)) != 0 || DEDUP_TABLE_CAPACITY > 16384
+#error "DEDUP_TABLE_CAPACITY must be a power of two no larger than 16384"
+#endif
+
+#ifndef DEDUP_STALE_MS
+#define DEDUP_STALE_MS       30000   // Clear entry after 30s of no activity
+#endif
+#define DEDUP_WHEEL_TICK_MS  1000
+// One lap of the wheel must be longer than the stale timeout
+#define DEDUP_WHEEL_SLOTS    (DEDUP_STALE_MS / DEDUP_WHEEL_TICK_MS + 2)
+
+#define DEDUP_INDEX_SIZE  (DEDUP_TABLE_CAPACITY * 2)
+#define DEDUP_INDEX_MASK  (DEDUP_INDEX_SIZE - 1)
+#define DEDUP_NIL         0xFFFF
+
+struct dedup_entry {
+  uint8_t  mac[6];              // Drone MAC address (key)
+  uint32_t window_start;        // When the dedup window opened (ms)
+  uint32_t last_seen;           // Last time this MAC was seen (ms)
+  char     first_node_id[8];    // node_id that won (first in)
+  uint8_t  dups_blocked;        // How many duplicates were blocked this window
+  char     basic_id[ODID_ID_SIZE + 1];  // Last basic_id from a mesh frame
+  mesh_frame_state mesh_state;  // Last full mesh frame, expands keepalives
+  uint32_t content_hash;        // json_scan() hash of the last forwarded copy
+  uint16_t newest_ts;           // Newest sender "ts" seen, TIME_SYNC_NONE = none
+  // Timing wheel links
+  uint16_t wheel_prev;
+  uint16_t wheel_next;          // also the free list link
+  uint16_t wheel_slot;
+};
+
+struct dedup_table {
+  dedup_entry entries[DEDUP_TABLE_CAPACITY];
+  uint16_t    index[DEDUP_INDEX_SIZE];      // pool position + 1, 0 = empty
+  uint16_t    wheel[DEDUP_WHEEL_SLOTS];     // head of each slot's list
+  uint16_t    free_head;
+  uint16_t    count;
+  uint32_t    wheel_tick;                   // next tick expiry will look at
+  uint32_t    wheel_ms;                     // millis() at which it falls due
+  uint32_t    evictions;                    // live entries recycled, table full
+  uint32_t    expired;                      // entries timed out
+};
+
+void dedup_table_init(dedup_table *t, uint32_t now);
+
+// Existing entry for mac or nullptr.
+dedup_entry *dedup_table_find(dedup_table *t, const uint8_t *mac);
+
+// Zeroed entry keyed to mac with last_seen = now, newest_ts unset. Caller checks
+// dedup_table_find() first.
+dedup_entry *dedup_table_alloc(dedup_table *t, const uint8_t *mac, uint32_t now);
+
+// Set last_seen = now and move the entry to its new wheel slot.
+void dedup_table_touch(dedup_table *t, dedup_entry *e, uint32_t now);
+
+// Removes one entry idle for DEDUP_STALE_MS or more and copies it to *out
+// (nullable). Returns false once nothing due is left; call until false.
+bool dedup_table_expire(dedup_table *t, uint32_t now, dedup_entry *out);
+
+#endif // _DEDUP_TABLE_H_
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdio.h>
+#include "detection_json.h"
+
+const char *bandToString(uint8_t band) {
+  switch (band) {
+    case BAND_2_4GHZ: return "2.4GHz";
+    case BAND_5GHZ:   return "5GHz";
+    case BAND_BLE:    return "BLE";
+    default:          return "unknown";
+  }
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+void format_mac(char *out, const uint8_t *mac) {
+  for (int i = 0; i < 6; i++) {
+    out[i * 3] = hex_digits[mac[i] >> 4];
+    out[i * 3 + 1] = hex_digits[mac[i] & 0x0f];
+    out[i * 3 + 2] = (i < 5) ? ':' : '\0';
+  }
+}
+
+static int hex_nibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool parse_mac(const char *str, uint8_t *mac) {
+  for (int i = 0; i < 6; i++) {
+    const char *p = str + i * 3;
+    int hi = hex_nibble(p[0]);
+    int lo = hi < 0 ? -1 : hex_nibble(p[1]);
+    if (lo < 0) return false;
+    if (i < 5 && p[2] != ':') return false;
+    mac[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return true;
+}
+
+// Bounded writer with snprintf's contract: len counts every byte, only
+// size - 1 are stored, and the result is always NUL-terminated
+struct json_out {
+  char *p;
+  char *end;
+  int   len;
+};
+
+static inline void out_c(json_out *o, char c) {
+  if (o->p < o->end) *o->p++ = c;
+  o->len++;
+}
+
+static inline void out_s(json_out *o, const char *s) {
+  while (*s) out_c(o, *s++);
+}
+
+static void out_u(json_out *o, uint32_t u) {
+  char t[10];
+  int n = 0;
+  do t[n++] = (char)('0' + u % 10); while (u /= 10);
+  while (n) out_c(o, t[--n]);
+}
+
+static void out_i(json_out *o, int v) {
+  if (v < 0) {
+    out_c(o, '-');
+    out_u(o, 0u - (uint32_t)v);
+  } else {
+    out_u(o, (uint32_t)v);
+  }
+}
+
+// True when |d| lies above a/1e7 exactly (a ends in 5, so a/1e7 is the
+// midpoint %.6f rounds around). Dekker's exact product: newlib's fma() is
+// not fused, so this uses plain double ops that are each exact. 1e7 fits
+// in 26 bits, so only |d| needs splitting.
+static int cmp_above_e7(double ad, uint32_t a) {
+  double p = ad * 1e7;
+  double c = 134217729.0 * ad;       // 2^27 + 1
+  double hi = c - (c - ad);
+  double lo = ad - hi;
+  double err = (hi * 1e7 - p) + lo * 1e7;  // ad * 1e7 == p + err exactly
+  double diff = (p - (double)a) + err;     // p - a is exact (Sterbenz)
+  return (diff > 0) - (diff < 0);
+}
+
+// "%.6f" of decodeLatLon(e7), from the fixed-point value. The double is
+// only needed to break a last-digit 5, one coordinate in ten.
+static void out_deg6(json_out *o, int32_t e7) {
+  uint32_t a = e7 < 0 ? 0u - (uint32_t)e7 : (uint32_t)e7;
+  uint32_t q = a / 10, r = a % 10;
+  if (r > 5) {
+    q++;
+  } else if (r == 5) {
+    // The double sits just above or below the midpoint; an exact tie
+    // (a multiple of 5^7) rounds half to even, as printf does
+    int c = cmp_above_e7(fabs(decodeLatLon(e7)), a);
+    if (c > 0 || (c == 0 && (q & 1))) q++;
+  }
+  if (e7 < 0) out_c(o, '-');
+  out_u(o, q / 1000000);
+  out_c(o, '.');
+  uint32_t frac = q % 1000000;
+  for (uint32_t div = 100000; div; div /= 10) out_c(o, (char)('0' + (frac / div) % 10));
+}
+
+// Free text from the drone (Self ID, IDs): quote and backslash escaped,
+// anything outside printable ASCII as '?'
+static void out_text(json_out *o, const char *s, size_t max) {
+  for (size_t i = 0; i < max && s[i]; i++) {
+    uint8_t c = (uint8_t)s[i];
+    if (c == '"' || c == '\\') out_c(o, '\\');
+    out_c(o, (c < 0x20 || c > 0x7E) ? '?' : (char)c);
+  }
+}
+
+static void out_extra(json_out *o, const uav_extra *x) {
+  if (x->id_type_2 != ODID_IDTYPE_NONE) {
+    out_s(o, ",\"basic_id_2\":\"");
+    out_text(o, x->uas_id_2, ODID_ID_SIZE);
+    out_s(o, "\",\"id_type_2\":");
+    out_u(o, x->id_type_2);
+  }
+  if (x->self_id[0]) {
+    out_s(o, ",\"self_id\":\"");
+    out_text(o, x->self_id, ODID_STR_SIZE);
+    out_s(o, "\",\"self_id_type\":");
+    out_u(o, x->self_id_type);
+  }
+  if (x->auth_pages) {
+    out_s(o, ",\"auth\":{\"type\":");
+    out_u(o, x->auth_type);
+    out_s(o, ",\"pages\":");
+    out_u(o, x->auth_pages);
+    out_s(o, ",\"last_page\":");
+    out_u(o, x->auth_last_page);
+    out_s(o, ",\"ts\":");
+    out_u(o, x->auth_timestamp);
+    // The data only once every page up to LastPageIndex is in
+    uint32_t want = (2u << x->auth_last_page) - 1;
+    if ((x->auth_pages & 1) && (x->auth_pages & want) == want &&
+        x->auth_last_page < ODID_AUTH_MAX_PAGES) {
+      out_s(o, ",\"data\":\"");
+      size_t n = x->auth_length < UAV_AUTH_DATA_SIZE ? x->auth_length : UAV_AUTH_DATA_SIZE;
+      for (size_t i = 0; i < n; i++) {
+        out_c(o, hex_digits[x->auth_data[i] >> 4]);
+        out_c(o, hex_digits[x->auth_data[i] & 0x0f]);
+      }
+      out_c(o, '"');
+    }
+    out_c(o, '}');
+  }
+}
+
+int format_detection_json(char *buf, size_t size, const id_data *UAV,
+                          uint32_t fields, const char *node_id) {
+  return format_detection_json_extra(buf, size, UAV, fields, node_id, nullptr);
+}
+
+int format_detection_json_extra(char *buf, size_t size, const id_data *UAV,
+                                uint32_t fields, const char *node_id,
+                                const uav_extra *extra) {
+  json_out o = { buf, buf + (size ? size - 1 : 0), 0 };
+  char mac_local[18];
+  const char *mac_str = UAV->mac_str;
+  if (!mac_str[0]) {
+    format_mac(mac_local, UAV->mac);
+    mac_str = mac_local;
+  }
+
+  out_s(&o, "{\"mac\":\"");
+  out_s(&o, mac_str);
+  out_s(&o, "\",\"rssi\":");
+  out_i(&o, UAV->rssi);
+  if (fields & DETECTION_JSON_BAND) {
+    out_s(&o, ",\"band\":\"");
+    out_s(&o, bandToString(UAV->band));
+    out_s(&o, "\",\"channel\":");
+    out_i(&o, UAV->channel);
+  }
+  out_s(&o, ",\"drone_lat\":");
+  out_deg6(&o, UAV->lat_e7);
+  out_s(&o, ",\"drone_long\":");
+  out_deg6(&o, UAV->long_e7);
+  out_s(&o, ",\"drone_altitude\":");
+  out_i(&o, UAV->altitude_msl);
+  out_s(&o, ",\"pilot_lat\":");
+  out_deg6(&o, UAV->base_lat_e7);
+  out_s(&o, ",\"pilot_long\":");
+  out_deg6(&o, UAV->base_long_e7);
+  out_s(&o, ",\"basic_id\":\"");
+  out_text(&o, UAV->uav_id, ODID_ID_SIZE);
+  out_c(&o, '"');
+  if ((fields & DETECTION_JSON_TIME) && UAV->utc_ds != TIME_SYNC_NONE) {
+    out_s(&o, ",\"ts\":");
+    out_i(&o, UAV->utc_ds);
+  }
+  if ((fields & DETECTION_JSON_PLAUS) && UAV->plaus) {
+    out_s(&o, ",\"plaus\":");
+    out_i(&o, UAV->plaus);
+  }
+  if (extra) out_extra(&o, extra);
+  if (node_id) {
+    out_s(&o, ",\"node_id\":\"");
+    out_s(&o, node_id);
+    out_c(&o, '"');
+  }
+  out_c(&o, '}');
+  if (size) *o.p = '\0';
+  return o.len;
+}
+
+int format_coord(char *buf, size_t size, int32_t deg_e7) {
+  json_out o = { buf, buf + (size ? size - 1 : 0), 0 };
+  out_deg6(&o, deg_e7);
+  if (size) *o.p = '\0';
+  return o.len;
+}
+
+int format_detection_json_ref(char *buf, size_t size, const id_data *UAV,
+                          uint32_t fields, const char *node_id) {
+  char mac_str[18];
+  format_mac(mac_str, UAV->mac);
+  // The ID through the same escaping, so the bytes still match
+  char uav_id[2 * ODID_ID_SIZE + 1];
+  json_out id = { uav_id, uav_id + sizeof(uav_id) - 1, 0 };
+  out_text(&id, UAV->uav_id, ODID_ID_SIZE);
+  *id.p = '\0';
+
+  int len = snprintf(buf, size, "{\"mac\":\"%s\",\"rssi\":%d", mac_str, UAV->rssi);
+  if ((fields & DETECTION_JSON_BAND) && len < (int)size) {
+    len += snprintf(buf + len, size - len, ",\"band\":\"%s\",\"channel\":%d",
+                    bandToString(UAV->band), UAV->channel);
+  }
+  if (len < (int)size) {
+    len += snprintf(buf + len, size - len,
+      ",\"drone_lat\":%.6f,\"drone_long\":%.6f,\"drone_altitude\":%d,"
+      "\"pilot_lat\":%.6f,\"pilot_long\":%.6f,\"basic_id\":\"%s\"",
+      decodeLatLon(UAV->lat_e7), decodeLatLon(UAV->long_e7), UAV->altitude_msl,
+      decodeLatLon(UAV->base_lat_e7), decodeLatLon(UAV->base_long_e7), uav_id);
+  }
+  if ((fields & DETECTION_JSON_TIME) && UAV->utc_ds != TIME_SYNC_NONE && len < (int)size) {
+    len += snprintf(buf + len, size - len, ",\"ts\":%u", (unsigned)UAV->utc_ds);
+  }
+  if ((fields & DETECTION_JSON_PLAUS) && UAV->plaus && len < (int)size) {
+    len += snprintf(buf + len, size - len, ",\"plaus\":%u", (unsigned)UAV->plaus);
+  }
+  if (node_id && len < (int)size) {
+    len += snprintf(buf + len, size - len, ",\"node_id\":\"%s\"", node_id);
+  }
+  if (len < (int)size) {
+    len += snprintf(buf + len, size - len, "}");
+  }
+  return len;
+}
@@ -0,0 +1,55 @@
+/*
+ * detection_json.h - mesh-mapper detection record formatting.
+ *
+ * Base record (every firmware):
+ *   {"mac":"xx:xx:xx:xx:xx:xx","rssi":-50,"drone_lat":0.0,"drone_long":0.0,
+ *    "drone_altitude":0,"pilot_lat":0.0,"pilot_long":0.0,"basic_id":"..."}
+ * Optional fields are selected per firmware with DETECTION_JSON_* flags.
+ */
+
+#ifndef _DETECTION_JSON_H_
+#define _DETECTION_JSON_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "uav_tracker.h"
+
+#define DETECTION_JSON_BAND  0x01   // "band" and "channel" after "rssi"
+#define DETECTION_JSON_TIME  0x02   // "ts" (utc_ds) after "basic_id", when synced
+#define DETECTION_JSON_PLAUS 0x04   // "plaus" (PLAUS_* bits) after that, when any
+
+const char *bandToString(uint8_t band);
+
+// "aa:bb:cc:dd:ee:ff" into out (18 bytes)
+void format_mac(char *out, const uint8_t *mac);
+
+// Inverse of format_mac (either case); stops at the 17th character.
+// Returns false if str does not start with a colon-separated MAC.
+bool parse_mac(const char *str, uint8_t *mac);
+
+// Returns the snprintf length. node_id (nullable) is appended as "node_id".
+// Coordinates are written from the *_e7 fixed-point fields and the MAC
+// from mac_str, without any printf; the bytes are the same as
+// format_detection_json_ref() produces.
+int format_detection_json(char *buf, size_t size, const id_data *UAV,
+                          uint32_t fields, const char *node_id);
+
+// format_detection_json() plus extra (nullable) before node_id:
+// "basic_id_2"/"id_type_2", "self_id"/"self_id_type", and "auth":{"type",
+// "pages" (bit per page held),"last_page","ts","data" (hex, once every
+// page is in)}. DETECTION_JSON_EXTRA_MAX always holds the result.
+int format_detection_json_extra(char *buf, size_t size, const id_data *UAV,
+                                uint32_t fields, const char *node_id,
+                                const uav_extra *extra);
+
+#define DETECTION_JSON_EXTRA_MAX (512 + 2 * ODID_ID_SIZE + 2 * ODID_STR_SIZE + 2 * UAV_AUTH_DATA_SIZE)
+
+// The original snprintf("%.6f") formatter, kept as the reference for
+// DETECTION_JSON_BENCH and the host harness.
+int format_detection_json_ref(char *buf, size_t size, const id_data *UAV,
+                              uint32_t fields, const char *node_id);
+
+// "%.6f" of one 1e-7 degree coordinate; returns the snprintf length.
+int format_coord(char *buf, size_t size, int32_t deg_e7);
+
+#endif // _DETECTION_JSON_H_
@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <string.h>
+#include "flash_log.h"
+#include "usb_record.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_partition.h>
+#endif
+
+static_assert(FLASH_LOG_PAGE_SIZE >= FLASH_LOG_ENTRY_OVERHEAD + FLASH_LOG_DATA_MAX,
+              "FLASH_LOG_PAGE_SIZE must hold the largest entry");
+static_assert(FLASH_LOG_PAGE_SIZE <= FLASH_LOG_SECTOR_SIZE - FLASH_LOG_HEADER_LEN,
+              "FLASH_LOG_PAGE_SIZE must fit in a sector");
+
+static const uint8_t MAGIC[4] = {'R', 'I', 'D', 'L'};
+
+enum entry_result { ENTRY_OK, ENTRY_END, ENTRY_BAD };
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Wrap-safe sequence and position order
+static inline bool seq_before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+static inline bool pos_before(const flash_log_pos &a, const flash_log_pos &b) {
+  return a.seq != b.seq ? seq_before(a.seq, b.seq) : a.off < b.off;
+}
+
+static inline uint32_t sector_base(uint16_t index) {
+  return (uint32_t)index * FLASH_LOG_SECTOR_SIZE;
+}
+
+// Ring slot of a sequence number between tail_seq and head.seq
+static uint16_t index_of(const flash_log *log, uint32_t seq) {
+  uint32_t back = (log->head.seq - seq) % log->sectors;
+  return (uint16_t)((log->head_index + log->sectors - back) % log->sectors);
+}
+
+static bool read_header(flash_log *log, uint16_t index, uint32_t *seq, uint16_t *boot) {
+  uint8_t h[FLASH_LOG_HEADER_LEN];
+  if (!log->io.read(log->io.ctx, sector_base(index), h, sizeof(h))) {
+    log->errors++;
+    return false;
+  }
+  if (memcmp(h, MAGIC, sizeof(MAGIC)) != 0) return false;
+  *seq = get_le32(&h[4]);
+  *boot = get_le16(&h[8]);
+  return *seq != 0xFFFFFFFF;
+}
+
+// Entry at off in sector index; *type, *out and *next are set on ENTRY_OK
+static entry_result read_entry(flash_log *log, uint16_t index, uint16_t off, uint8_t *type,
+                               flash_log_entry *out, uint16_t *next) {
+  if (off + FLASH_LOG_ENTRY_OVERHEAD > FLASH_LOG_SECTOR_SIZE) return ENTRY_END;
+  uint8_t e[FLASH_LOG_ENTRY_OVERHEAD + FLASH_LOG_DATA_MAX];
+  uint32_t at = sector_base(index) + off;
+  if (!log->io.read(log->io.ctx, at, e, 1)) {
+    log->errors++;
+    return ENTRY_BAD;
+  }
+  if (e[0] == 0xFF) return ENTRY_END;
+  size_t total = FLASH_LOG_ENTRY_OVERHEAD + e[0];
+  if (e[0] > FLASH_LOG_DATA_MAX || off + total > FLASH_LOG_SECTOR_SIZE) return ENTRY_BAD;
+  if (!log->io.read(log->io.ctx, at + 1, &e[1], total - 1)) {
+    log->errors++;
+    return ENTRY_BAD;
+  }
+  if (get_le16(&e[total - 2]) != usb_record_crc16(&e[1], total - 3)) return ENTRY_BAD;
+  *type = e[1];
+  out->boot = get_le16(&e[2]);
+  out->ms = get_le32(&e[4]);
+  out->len = e[0];
+  memcpy(out->data, &e[8], e[0]);
+  *next = (uint16_t)(off + total);
+  return ENTRY_OK;
+}
+
+struct sector_scan {
+  uint16_t      end;        // first offset past the last good entry
+  bool          bad;        // stopped at a corrupt entry
+  bool          has_boot;
+  uint16_t      last_boot;  // boot number of the last entry
+  bool          has_mark;
+  flash_log_pos mark;       // last MARK entry
+};
+
+static void scan_sector(flash_log *log, uint16_t index, sector_scan *s) {
+  memset(s, 0, sizeof(*s));
+  uint16_t off = FLASH_LOG_HEADER_LEN;
+  flash_log_entry e;
+  for (;;) {
+    uint8_t type;
+    uint16_t next;
+    entry_result r = read_entry(log, index, off, &type, &e, &next);
+    if (r == ENTRY_END) break;
+    if (r == ENTRY_BAD) {
+      log->corrupt++;
+      s->bad = true;
+      break;
+    }
+    s->has_boot = true;
+    s->last_boot = e.boot;
+    if (type == FLASH_LOG_T_MARK && e.len >= 6) {
+      s->has_mark = true;
+      s->mark.seq = get_le32(e.data);
+      s->mark.off = get_le16(&e.data[4]);
+    }
+    off = next;
+  }
+  s->end = off;
+}
+
+static bool start_sector(flash_log *log, uint16_t index, uint32_t seq) {
+  log->erases++;
+  if (!log->io.erase_sector(log->io.ctx, sector_base(index))) {
+    log->errors++;
+    return false;
+  }
+  uint8_t h[FLASH_LOG_HEADER_LEN];
+  memset(h, 0xFF, sizeof(h));
+  memcpy(h, MAGIC, sizeof(MAGIC));
+  put_le32(&h[4], seq);
+  put_le16(&h[8], log->boot);
+  if (!log->io.write(log->io.ctx, sector_base(index), h, sizeof(h))) {
+    log->errors++;
+    return false;
+  }
+  return true;
+}
+
+// Move the head to the next sector, dropping the oldest one if the ring
+// is full. A sector that fails to start is left full, so the next append
+// moves on again.
+static void advance(flash_log *log) {
+  uint32_t seq = log->head.seq + 1;
+  uint32_t dropped = seq - log->sectors;
+  if (!seq_before(dropped, log->tail_seq)) {
+    log->tail_seq = dropped + 1;
+    if (seq_before(log->replay.seq, log->tail_seq)) {
+      log->overwritten++;
+      log->replay.seq = log->tail_seq;
+      log->replay.off = FLASH_LOG_HEADER_LEN;
+    }
+  }
+  log->head_index = (uint16_t)((log->head_index + 1) % log->sectors);
+  log->head.seq = seq;
+  log->head.off = FLASH_LOG_HEADER_LEN;
+  if (!start_sector(log, log->head_index, seq)) log->head.off = FLASH_LOG_SECTOR_SIZE;
+}
+
+// The cursor a mark saved points at the mark itself when the host had
+// everything; step over it
+static void skip_marks(flash_log *log) {
+  flash_log_entry e;
+  while (pos_before(log->replay, log->head)) {
+    uint8_t type;
+    uint16_t next;
+    if (read_entry(log, index_of(log, log->replay.seq), log->replay.off, &type, &e, &next) !=
+            ENTRY_OK ||
+        type != FLASH_LOG_T_MARK)
+      break;
+    log->replay.off = next;
+  }
+}
+
+bool flash_log_mount(flash_log *log, const flash_log_io *io) {
+  memset(log, 0, sizeof(*log));
+  log->io = *io;
+  uint32_t sectors = io->size / FLASH_LOG_SECTOR_SIZE;
+  log->sectors = (uint16_t)(sectors > UINT16_MAX ? UINT16_MAX : sectors);
+  if (log->sectors < 2) return false;
+
+  // Newest sector
+  bool found = false;
+  uint16_t head_boot = 0;
+  for (uint16_t i = 0; i < log->sectors; i++) {
+    uint32_t seq;
+    uint16_t boot;
+    if (!read_header(log, i, &seq, &boot)) continue;
+    if (!found || seq_before(log->head.seq, seq)) {
+      found = true;
+      log->head_index = i;
+      log->head.seq = seq;
+      head_boot = boot;
+    }
+  }
+  if (!found) {
+    // No log here yet
+    log->head_index = 0;
+    log->head.seq = 1;
+    log->head.off = FLASH_LOG_HEADER_LEN;
+    log->tail_seq = 1;
+    log->replay = log->head;
+    if (!start_sector(log, 0, 1)) return false;
+    log->mounted = true;
+    return true;
+  }
+
+  // Oldest: walk back while the sequence continues
+  log->tail_seq = log->head.seq;
+  for (uint16_t k = 1; k < log->sectors; k++) {
+    uint32_t seq;
+    uint16_t boot;
+    uint16_t index = (uint16_t)((log->head_index + log->sectors - k) % log->sectors);
+    if (!read_header(log, index, &seq, &boot) || seq != log->head.seq - k) break;
+    log->tail_seq = seq;
+  }
+
+  // Write offset and boot number from the head sector; after a torn
+  // write it counts as full
+  sector_scan head;
+  scan_sector(log, log->head_index, &head);
+  log->head.off = head.bad ? FLASH_LOG_SECTOR_SIZE : head.end;
+  log->boot = (uint16_t)((head.has_boot ? head.last_boot : head_boot) + 1);
+
+  // Replay cursor from the newest mark, else the oldest entry
+  log->replay.seq = log->tail_seq;
+  log->replay.off = FLASH_LOG_HEADER_LEN;
+  for (uint32_t seq = log->head.seq;; seq--) {
+    sector_scan older;
+    const sector_scan *s = &head;
+    if (seq != log->head.seq) {
+      scan_sector(log, index_of(log, seq), &older);
+      s = &older;
+    }
+    if (s->has_mark) {
+      if (!seq_before(s->mark.seq, log->tail_seq) && !pos_before(log->head, s->mark))
+        log->replay = s->mark;
+      break;
+    }
+    if (seq == log->tail_seq) break;
+  }
+  skip_marks(log);
+  log->mounted = true;
+  return true;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+static bool partition_read(void *ctx, uint32_t off, void *dst, size_t len) {
+  return esp_partition_read((const esp_partition_t *)ctx, off, dst, len) == ESP_OK;
+}
+
+static bool partition_write(void *ctx, uint32_t off, const void *src, size_t len) {
+  return esp_partition_write((const esp_partition_t *)ctx, off, src, len) == ESP_OK;
+}
+
+static bool partition_erase(void *ctx, uint32_t off) {
+  return esp_partition_erase_range((const esp_partition_t *)ctx, off,
+                                   FLASH_LOG_SECTOR_SIZE) == ESP_OK;
+}
+
+bool flash_log_open_partition(flash_log *log, const char *label) {
+  const esp_partition_t *part =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (!part) {
+    memset(log, 0, sizeof(*log));
+    return false;
+  }
+  flash_log_io io = {partition_read, partition_write, partition_erase, (void *)part, part->size};
+  return flash_log_mount(log, &io);
+}
+#endif
+
+static bool append_entry(flash_log *log, uint8_t type, const uint8_t *data, size_t len,
+                         uint32_t now) {
+  if (!log->mounted || len > FLASH_LOG_DATA_MAX) return false;
+  size_t total = FLASH_LOG_ENTRY_OVERHEAD + len;
+  if (log->page_len + total > FLASH_LOG_PAGE_SIZE) flash_log_flush(log);
+  if (log->head.off + log->page_len + total > FLASH_LOG_SECTOR_SIZE) {
+    flash_log_flush(log);
+    advance(log);
+  }
+  if (log->page_len == 0) log->page_ms = now;
+
+  uint8_t *e = &log->page[log->page_len];
+  e[0] = (uint8_t)len;
+  e[1] = type;
+  put_le16(&e[2], log->boot);
+  put_le32(&e[4], now);
+  memcpy(&e[8], data, len);
+  put_le16(&e[8 + len], usb_record_crc16(&e[1], 7 + len));
+  log->page_len += (uint16_t)total;
+  return true;
+}
+
+bool flash_log_append(flash_log *log, const uint8_t *data, size_t len, uint32_t now) {
+  if (!append_entry(log, FLASH_LOG_T_DATA, data, len, now)) return false;
+  log->appended++;
+  return true;
+}
+
+void flash_log_flush(flash_log *log) {
+  if (log->page_len == 0) return;
+  uint32_t at = sector_base(log->head_index) + log->head.off;
+  if (log->io.write(log->io.ctx, at, log->page, log->page_len)) {
+    log->head.off += log->page_len;
+    log->page_writes++;
+  } else {
+    log->errors++;
+    log->head.off = FLASH_LOG_SECTOR_SIZE;
+  }
+  log->page_len = 0;
+}
+
+void flash_log_service(flash_log *log, uint32_t now) {
+  if (log->page_len > 0 && now - log->page_ms >= FLASH_LOG_FLUSH_MS) flash_log_flush(log);
+}
+
+bool flash_log_replay_next(flash_log *log, flash_log_entry *out) {
+  if (!log->mounted) return false;
+  while (pos_before(log->replay, log->head)) {
+    uint8_t type;
+    uint16_t next;
+    entry_result r = read_entry(log, index_of(log, log->replay.seq), log->replay.off, &type,
+                                out, &next);
+    if (r == ENTRY_OK) {
+      log->replay.off = next;
+      if (type != FLASH_LOG_T_DATA) continue;
+      log->replayed++;
+      return true;
+    }
+    // End of this sector's entries, or a torn one: the rest is unreadable
+    if (r == ENTRY_BAD) log->corrupt++;
+    if (log->replay.seq == log->head.seq) {
+      log->replay.off = log->head.off;
+      break;
+    }
+    log->replay.seq++;
+    log->replay.off = FLASH_LOG_HEADER_LEN;
+  }
+  return false;
+}
+
+void flash_log_mark(flash_log *log, uint32_t now) {
+  if (!log->mounted) return;
+  flash_log_flush(log);
+  bool caught_up = !pos_before(log->replay, log->head);
+  uint8_t d[6];
+  put_le32(d, log->replay.seq);
+  put_le16(&d[4], log->replay.off);
+  append_entry(log, FLASH_LOG_T_MARK, d, sizeof(d), now);
+  flash_log_flush(log);
+  if (caught_up) log->replay = log->head;
+}
+
+void flash_log_rewind(flash_log *log) {
+  log->replay.seq = log->tail_seq;
+  log->replay.off = FLASH_LOG_HEADER_LEN;
+}
+
+void flash_log_skip(flash_log *log) {
+  flash_log_flush(log);
+  log->replay = log->head;
+}
+
+uint32_t flash_log_pending_bytes(const flash_log *log) {
+  if (!log->mounted) return 0;
+  uint32_t bytes = log->page_len;
+  if (pos_before(log->replay, log->head))
+    bytes += (log->head.seq - log->replay.seq) * FLASH_LOG_SECTOR_SIZE + log->head.off -
+             log->replay.off;
+  return bytes;
+}
+
+int flash_log_format_json(const flash_log *log, char *buf, size_t size) {
+  return snprintf(buf, size,
+                  "\"flash_log\":{\"mounted\":%s,\"kb\":%u,\"boot\":%u,\"appended\":%u,"
+                  "\"pending_kb\":%u,\"page_writes\":%u,\"erases\":%u,\"replayed\":%u,"
+                  "\"overwritten\":%u,\"corrupt\":%u,\"errors\":%u}",
+                  log->mounted ? "true" : "false",
+                  (unsigned)(log->sectors * (FLASH_LOG_SECTOR_SIZE / 1024)), (unsigned)log->boot,
+                  (unsigned)log->appended, (unsigned)((flash_log_pending_bytes(log) + 1023) / 1024),
+                  (unsigned)log->page_writes, (unsigned)log->erases, (unsigned)log->replayed,
+                  (unsigned)log->overwritten, (unsigned)log->corrupt, (unsigned)log->errors);
+}
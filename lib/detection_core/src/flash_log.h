@@ -0,0 +1,145 @@
+/*
+ * flash_log.h - Append-only detection log in a raw flash partition.
+ *
+ * A remote node that has lost its Heltec (or has no USB host) writes and
+ * forgets every detection. This log keeps them across the outage, and
+ * across a power cut, until a USB host asks for them back.
+ *
+ * The partition is a ring of FLASH_LOG_SECTOR_SIZE sectors written in
+ * order, so every sector sees the same number of erases (the wear
+ * levelling). Each sector starts with a 16-byte header:
+ *
+ *   0-3    magic "RIDL"
+ *   4-7    sequence number, one more than the previous sector's
+ *   8-9    boot number of the writer
+ *
+ * followed by entries until the first erased byte:
+ *
+ *   0      data length n (0xFF: erased, end of sector)
+ *   1      type (FLASH_LOG_T_*)
+ *   2-3    boot number, 4-7 millis() of the append
+ *   8..    n data bytes
+ *   last 2 CRC-16/CCITT-FALSE over type..data
+ *
+ * Entries gather in a FLASH_LOG_PAGE_SIZE RAM buffer and go to flash in
+ * one write when it fills or FLASH_LOG_FLUSH_MS after its first entry;
+ * entries never cross a sector. When the ring is full the next sector
+ * erase drops the oldest one.
+ *
+ * Replay walks the entries from a cursor. flash_log_mark() appends the
+ * cursor as a MARK entry, and mount takes the newest one back, so a
+ * reboot does not replay what a host already has. The boot number, one
+ * more than the newest found at mount, tells the caller whether an
+ * entry's millis() is comparable with its own.
+ *
+ * No lock: one task owns the log. Flash access goes through flash_log_io
+ * so the ring logic runs on a host too; flash_log_open_partition() binds
+ * it to an ESP32 data partition. A page write takes well under a
+ * millisecond with the flash cache off; sector erases yield
+ * (CONFIG_SPI_FLASH_YIELD_DURING_ERASE), so the RX rings cover both.
+ */
+
+#ifndef _FLASH_LOG_H_
+#define _FLASH_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_LOG_SECTOR_SIZE  4096
+#define FLASH_LOG_HEADER_LEN   16
+#define FLASH_LOG_ENTRY_OVERHEAD 10
+#define FLASH_LOG_DATA_MAX     64
+
+#define FLASH_LOG_T_DATA       0x01
+#define FLASH_LOG_T_MARK       0x02   // data: replay cursor seq (4), offset (2)
+
+#ifndef FLASH_LOG_PAGE_SIZE
+#define FLASH_LOG_PAGE_SIZE    256    // one flash program page
+#endif
+#ifndef FLASH_LOG_FLUSH_MS
+#define FLASH_LOG_FLUSH_MS     10000  // longest an entry waits in RAM
+#endif
+
+struct flash_log_io {
+  // Offsets are bytes into the region; each returns false on a flash error
+  bool (*read)(void *ctx, uint32_t off, void *dst, size_t len);
+  bool (*write)(void *ctx, uint32_t off, const void *src, size_t len);
+  bool (*erase_sector)(void *ctx, uint32_t off);
+  void *ctx;
+  uint32_t size;       // bytes, whole sectors are used
+};
+
+struct flash_log_pos {
+  uint32_t seq;        // sector sequence number
+  uint16_t off;        // byte offset in that sector
+};
+
+struct flash_log_entry {
+  uint16_t boot;
+  uint32_t ms;
+  uint8_t  len;
+  uint8_t  data[FLASH_LOG_DATA_MAX];
+};
+
+struct flash_log {
+  flash_log_io  io;
+  bool          mounted;
+  uint16_t      sectors;
+  uint16_t      boot;
+  uint16_t      head_index;    // sector being written
+  flash_log_pos head;          // next flash write
+  uint32_t      tail_seq;      // oldest sector still in the ring
+  flash_log_pos replay;        // next entry to replay
+  uint8_t       page[FLASH_LOG_PAGE_SIZE];
+  uint16_t      page_len;
+  uint32_t      page_ms;       // millis() of the page's first entry
+  // Stats
+  uint32_t      appended;
+  uint32_t      page_writes;
+  uint32_t      erases;
+  uint32_t      replayed;
+  uint32_t      overwritten;   // sectors erased before their replay
+  uint32_t      corrupt;       // entries failing their CRC (torn writes)
+  uint32_t      errors;        // flash operations that failed
+};
+
+// Find the ring's head, tail, boot number and replay cursor in io's
+// region; formats a region with no log in it. False if the region is
+// smaller than two sectors or unreadable.
+bool flash_log_mount(flash_log *log, const flash_log_io *io);
+
+#if defined(ARDUINO_ARCH_ESP32)
+// Mount on the data partition with this label (all of it).
+bool flash_log_open_partition(flash_log *log, const char *label);
+#endif
+
+// Buffer one entry of len <= FLASH_LOG_DATA_MAX bytes, a page write
+// first when it does not fit. False if the log is not mounted.
+bool flash_log_append(flash_log *log, const uint8_t *data, size_t len, uint32_t now);
+
+// Write out the RAM page. service() does it once the page is
+// FLASH_LOG_FLUSH_MS old.
+void flash_log_flush(flash_log *log);
+void flash_log_service(flash_log *log, uint32_t now);
+
+// Next DATA entry after the replay cursor, false when it has caught up
+// with the last flush.
+bool flash_log_replay_next(flash_log *log, flash_log_entry *out);
+
+// Persist the replay cursor (a MARK entry, flushed straight away).
+void flash_log_mark(flash_log *log, uint32_t now);
+
+// Move the cursor back to the oldest entry, or forward past everything
+// written so far. Not persisted until the next mark.
+void flash_log_rewind(flash_log *log);
+void flash_log_skip(flash_log *log);
+
+// Bytes between the replay cursor and the head plus the RAM page, entry
+// headers and sector tails included
+uint32_t flash_log_pending_bytes(const flash_log *log);
+
+// "flash_log":{"kb":..,"boot":..,"appended":..,...}. Returns the
+// snprintf length.
+int flash_log_format_json(const flash_log *log, char *buf, size_t size);
+
+#endif // _FLASH_LOG_H_
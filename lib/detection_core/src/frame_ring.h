@@ -0,0 +1,127 @@
+/*
+ * frame_ring.h - Preallocated single-producer / single-consumer ring for raw
+ * 802.11 management frames captured in the WiFi promiscuous callback.
+ *
+ * The WiFi driver's RX callback is the only producer and the WiFi decode
+ * task is the only consumer, so head/tail need no lock: each index is written
+ * by exactly one side and published with release/acquire ordering.
+ *
+ * Producer (RX callback):        Consumer (decode task):
+ *   f = frame_ring_reserve(&r);    while ((f = frame_ring_peek(&r))) {
+ *   if (f) { fill f;                 decode f;
+ *            frame_ring_commit(&r);  frame_ring_release(&r);
+ *            wake consumer;        }
+ *   }
+ *
+ * Wake the consumer after every commit. An "only when it was empty" test
+ * reads a tail from before the consumer's last release, so the consumer
+ * can drain, find the ring empty and sleep before the new head is
+ * published; that frame would then wait for the next one. Task
+ * notifications count, so the extra wakes cost the consumer nothing.
+ *
+ * Sizing: FRAME_RING_SLOTS must be a power of two. high_water and drops are
+ * kept so the ring can be sized per site from the status output.
+ */
+
+#ifndef _FRAME_RING_H_
+#define _FRAME_RING_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#ifndef FRAME_RING_SLOTS
+#define FRAME_RING_SLOTS     32     // Frames buffered between RX and decode
+#endif
+
+#ifndef FRAME_RING_MAX_FRAME
+#define FRAME_RING_MAX_FRAME 512    // Beacon/NAN with a full 9-message pack fits
+#endif
+
+static_assert((FRAME_RING_SLOTS & (FRAME_RING_SLOTS - 1)) == 0,
+              "FRAME_RING_SLOTS must be a power of two");
+
+struct captured_frame {
+  uint32_t timestamp;                   // dc_micros() at capture
+  int8_t   rssi;                        // rx_ctrl.rssi
+  uint8_t  channel;                     // Channel the frame was heard on
+  uint8_t  band;                        // Firmware-defined band tag (0 = n/a)
+  uint8_t  reserved;
+  uint16_t length;                      // Valid bytes in data[]
+  uint8_t  data[FRAME_RING_MAX_FRAME];
+};
+
+struct frame_ring {
+  captured_frame        slots[FRAME_RING_SLOTS];
+  std::atomic<uint32_t> head;           // Next slot to fill (producer)
+  std::atomic<uint32_t> tail;           // Next slot to drain (consumer)
+  uint32_t              high_water;     // Max occupancy observed (producer)
+  uint32_t              drops;          // Frames lost to a full ring (producer)
+  uint32_t              truncated;      // Frames clipped to FRAME_RING_MAX_FRAME
+};
+
+static inline void frame_ring_init(frame_ring *r) {
+  r->head.store(0, std::memory_order_relaxed);
+  r->tail.store(0, std::memory_order_relaxed);
+  r->high_water = 0;
+  r->drops = 0;
+  r->truncated = 0;
+}
+
+static inline uint32_t frame_ring_count(const frame_ring *r) {
+  return r->head.load(std::memory_order_acquire) -
+         r->tail.load(std::memory_order_acquire);
+}
+
+// Producer: get the next free slot, or nullptr (and count a drop) if full.
+static inline captured_frame *frame_ring_reserve(frame_ring *r) {
+  uint32_t head = r->head.load(std::memory_order_relaxed);
+  uint32_t used = head - r->tail.load(std::memory_order_acquire);
+  if (used >= FRAME_RING_SLOTS) {
+    r->drops++;
+    return nullptr;
+  }
+  if (used + 1 > r->high_water) r->high_water = used + 1;
+  return &r->slots[head & (FRAME_RING_SLOTS - 1)];
+}
+
+// Producer: publish the slot returned by frame_ring_reserve().
+static inline void frame_ring_commit(frame_ring *r) {
+  r->head.store(r->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Producer: copy a frame into the ring in one call. Returns false on drop.
+static inline bool frame_ring_push(frame_ring *r, const uint8_t *data, int length,
+                                   int8_t rssi, uint8_t channel, uint8_t band,
+                                   uint32_t timestamp) {
+  captured_frame *f = frame_ring_reserve(r);
+  if (!f) return false;
+  if (length < 0) length = 0;
+  if (length > FRAME_RING_MAX_FRAME) {
+    length = FRAME_RING_MAX_FRAME;
+    r->truncated++;
+  }
+  memcpy(f->data, data, length);
+  f->length = (uint16_t)length;
+  f->rssi = rssi;
+  f->channel = channel;
+  f->band = band;
+  f->timestamp = timestamp;
+  frame_ring_commit(r);
+  return true;
+}
+
+// Consumer: oldest unread frame, or nullptr if the ring is empty.
+static inline captured_frame *frame_ring_peek(frame_ring *r) {
+  uint32_t tail = r->tail.load(std::memory_order_relaxed);
+  if (tail == r->head.load(std::memory_order_acquire)) return nullptr;
+  return &r->slots[tail & (FRAME_RING_SLOTS - 1)];
+}
+
+// Consumer: hand the slot returned by frame_ring_peek() back to the producer.
+static inline void frame_ring_release(frame_ring *r) {
+  r->tail.store(r->tail.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+}
+
+#endif // _FRAME_RING_H_
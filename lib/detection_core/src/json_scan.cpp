@@ -0,0 +1,100 @@
+#include <string.h>
+#include "json_scan.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\t';
+}
+
+static int match_key(const char *k, int len) {
+  switch (len) {
+    case 2:  return memcmp(k, "ts", 2) == 0 ? JSON_KEY_TS : -1;
+    case 3:  return memcmp(k, "mac", 3) == 0 ? JSON_KEY_MAC : -1;
+    case 4:  return memcmp(k, "rssi", 4) == 0 ? JSON_KEY_RSSI : -1;
+    case 5:  return memcmp(k, "plaus", 5) == 0 ? JSON_KEY_PLAUS : -1;
+    case 7:  return memcmp(k, "node_id", 7) == 0 ? JSON_KEY_NODE_ID : -1;
+    case 9:  return memcmp(k, "drone_lat", 9) == 0 ? JSON_KEY_DRONE_LAT : -1;
+    case 10: return memcmp(k, "drone_long", 10) == 0 ? JSON_KEY_DRONE_LONG : -1;
+    default: return -1;
+  }
+}
+
+static inline uint32_t fnv(uint32_t h, const char *p, int len) {
+  for (int i = 0; i < len; i++) h = (h ^ (uint8_t)p[i]) * FNV_PRIME;
+  return h;
+}
+
+bool json_scan(const char *line, int len, json_fields *f, bool want_hash) {
+  memset(f, 0, sizeof(*f));
+  const char *p = line, *end = line + len;
+  while (p < end && is_space(*p)) p++;
+  while (end > p && is_space(end[-1])) end--;
+  if (end - p < 2 || *p != '{' || end[-1] != '}') return false;
+
+  const char *stop = end - 1;  // the closing brace
+  uint32_t h = FNV_OFFSET;
+  p++;
+  while (p < stop) {
+    while (p < stop && (is_space(*p) || *p == ',')) p++;
+    if (p >= stop || *p != '"') break;
+
+    // Key
+    const char *k = ++p;
+    while (p < stop && *p != '"') p++;
+    if (p >= stop) break;
+    int klen = p - k;
+    p++;
+    while (p < stop && is_space(*p)) p++;
+    if (p >= stop || *p != ':') break;
+    p++;
+    while (p < stop && is_space(*p)) p++;
+
+    // Value: string span without quotes, anything else up to the next
+    // top-level ','
+    const char *v = p, *vend;
+    if (p < stop && *p == '"') {
+      v = ++p;
+      while (p < stop && *p != '"') p += (*p == '\\') ? 2 : 1;
+      if (p >= stop) break;
+      vend = p++;
+    } else {
+      int depth = 0;
+      bool in_str = false;
+      for (; p < stop; p++) {
+        char c = *p;
+        if (in_str) {
+          if (c == '\\') p++;
+          else if (c == '"') in_str = false;
+        } else if (c == '"') {
+          in_str = true;
+        } else if (c == '{' || c == '[') {
+          depth++;
+        } else if (c == '}' || c == ']') {
+          depth--;
+        } else if (c == ',' && depth <= 0) {
+          break;
+        }
+      }
+      if (p > stop) p = stop;
+      vend = p;
+      while (vend > v && is_space(vend[-1])) vend--;
+    }
+
+    int key = match_key(k, klen);
+    if (key >= 0 && !JSON_HAS(f, key)) {
+      f->v[key].p = v;
+      f->v[key].len = (uint16_t)(vend - v);
+      f->present |= 1u << key;
+    }
+    if (want_hash && key != JSON_KEY_NODE_ID && key != JSON_KEY_RSSI && key != JSON_KEY_TS &&
+        key != JSON_KEY_PLAUS) {
+      h = fnv(h, k, klen);
+      h = fnv(h, v, vend - v);
+    }
+  }
+
+  if (want_hash) f->content_hash = h;
+  return true;
+}
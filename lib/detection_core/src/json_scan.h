@@ -0,0 +1,50 @@
+/*
+ * json_scan.h - One forward pass over a flat mesh-mapper JSON line.
+ *
+ * The home node only needs a handful of keys to route and dedup a line,
+ * so instead of one strstr per key this walks the line once and records
+ * where each known key's value sits. Values are spans into the caller's
+ * buffer (string values without their quotes); nothing is copied.
+ *
+ * Nested objects/arrays are skipped as opaque values. A line that opens
+ * with '{' and closes with '}' is always reported as JSON even if the
+ * walk gives up part way, so odd lines are still forwarded as before.
+ */
+
+#ifndef _JSON_SCAN_H_
+#define _JSON_SCAN_H_
+
+#include <stdint.h>
+
+enum json_key {
+  JSON_KEY_MAC = 0,
+  JSON_KEY_NODE_ID,
+  JSON_KEY_RSSI,
+  JSON_KEY_DRONE_LAT,
+  JSON_KEY_DRONE_LONG,
+  JSON_KEY_TS,         // sender's synced capture time (time_sync.h)
+  JSON_KEY_PLAUS,      // sender's plausibility flags (plausibility.h)
+  JSON_KEY_COUNT
+};
+
+struct json_span {
+  const char *p;
+  uint16_t    len;
+};
+
+struct json_fields {
+  json_span v[JSON_KEY_COUNT];
+  uint32_t  present;   // bit (1 << json_key) per key found
+  // FNV-1a over every key/value except node_id, rssi, ts and plaus, i.e.
+  // what two nodes relaying the same broadcast have in common. 0 unless
+  // requested.
+  uint32_t  content_hash;
+};
+
+#define JSON_HAS(f, key) (((f)->present >> (key)) & 1u)
+
+// Returns true when line (len bytes, need not be NUL-terminated) is a
+// JSON object; *f holds whatever known keys were found.
+bool json_scan(const char *line, int len, json_fields *f, bool want_hash);
+
+#endif // _JSON_SCAN_H_
@@ -0,0 +1,231 @@
+#include <string.h>
+#include "mesh_frame.h"
+#include "detection_json.h"
+
+static const char b64_alphabet[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint8_t crc8(const uint8_t *p, size_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, int32_t v) {
+  uint32_t u = (uint32_t)v;
+  p[0] = (uint8_t)u;
+  p[1] = (uint8_t)(u >> 8);
+  p[2] = (uint8_t)(u >> 16);
+  p[3] = (uint8_t)(u >> 24);
+}
+
+static inline uint16_t get_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline int32_t get_le32(const uint8_t *p) {
+  return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                   ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+int mesh_frame_encode(uint8_t *buf, size_t size, const id_data *UAV,
+                      uint16_t node_id, bool with_id) {
+  size_t id_len = with_id ? strnlen(UAV->uav_id, ODID_ID_SIZE) : 0;
+  bool with_time = UAV->utc_ds != TIME_SYNC_NONE;
+  size_t len = MESH_FRAME_CORE_LEN + (with_time ? 2 : 0) + (id_len ? 1 + id_len : 0) + 1;
+  if (size < len) return 0;
+
+  uint8_t ew = 0, mult = 0;
+  int rssi = UAV->rssi < -128 ? -128 : (UAV->rssi > 127 ? 127 : UAV->rssi);
+
+  buf[0] = MESH_FRAME_VERSION;
+  memcpy(&buf[2], UAV->mac, 6);
+  put_le16(&buf[8], node_id);
+  buf[10] = (uint8_t)(int8_t)rssi;
+  put_le32(&buf[11], UAV->lat_e7);
+  put_le32(&buf[15], UAV->long_e7);
+  put_le16(&buf[19], encodeAltitude((float)UAV->altitude_msl));
+  buf[21] = encodeSpeedHorizontal((float)UAV->speed, &mult);
+  buf[22] = encodeDirection((float)UAV->heading, &ew);
+  put_le32(&buf[23], UAV->base_lat_e7);
+  put_le32(&buf[27], UAV->base_long_e7);
+
+  uint8_t flags = (uint8_t)((UAV->band & 0x03) << MESH_FRAME_BAND_SHIFT);
+  if (ew)   flags |= MESH_FRAME_F_EW;
+  if (mult) flags |= MESH_FRAME_F_SPEEDX;
+  size_t pos = MESH_FRAME_CORE_LEN;
+  if (with_time) {
+    flags |= MESH_FRAME_F_TIME;
+    put_le16(&buf[pos], UAV->utc_ds);
+    pos += 2;
+  }
+  if (id_len) {
+    flags |= MESH_FRAME_F_ID;
+    buf[pos++] = (uint8_t)id_len;
+    memcpy(&buf[pos], UAV->uav_id, id_len);
+    pos += id_len;
+  }
+  buf[1] = flags;
+  buf[pos] = crc8(buf, pos);
+  return (int)len;
+}
+
+int mesh_frame_encode_keepalive(uint8_t *buf, size_t size, const id_data *UAV,
+                                uint16_t node_id) {
+  bool with_time = UAV->utc_ds != TIME_SYNC_NONE;
+  size_t len = MESH_FRAME_KEEPALIVE_LEN + (with_time ? 2 : 0);
+  if (size < len) return 0;
+  int rssi = UAV->rssi < -128 ? -128 : (UAV->rssi > 127 ? 127 : UAV->rssi);
+  uint8_t flags = (uint8_t)(((UAV->band & 0x03) << MESH_FRAME_BAND_SHIFT) | MESH_FRAME_F_KEEPALIVE);
+  buf[0] = MESH_FRAME_VERSION;
+  memcpy(&buf[2], UAV->mac, 6);
+  put_le16(&buf[8], node_id);
+  buf[10] = (uint8_t)(int8_t)rssi;
+  size_t pos = MESH_FRAME_KEEPALIVE_LEN - 1;
+  if (with_time) {
+    flags |= MESH_FRAME_F_TIME;
+    put_le16(&buf[pos], UAV->utc_ds);
+    pos += 2;
+  }
+  buf[1] = flags;
+  buf[pos] = crc8(buf, pos);
+  return (int)len;
+}
+
+mesh_frame_kind mesh_frame_decode(const uint8_t *buf, size_t len, id_data *UAV,
+                                  uint16_t *node_id) {
+  if (len < MESH_FRAME_KEEPALIVE_LEN || buf[0] != MESH_FRAME_VERSION) return MESH_FRAME_INVALID;
+  if (crc8(buf, len - 1) != buf[len - 1]) return MESH_FRAME_INVALID;
+
+  uint8_t flags = buf[1];
+  if (flags & ~MESH_FRAME_F_KNOWN) return MESH_FRAME_INVALID;
+  bool keepalive = (flags & MESH_FRAME_F_KEEPALIVE) != 0;
+  size_t pos = keepalive ? MESH_FRAME_KEEPALIVE_LEN - 1 : MESH_FRAME_CORE_LEN;
+  size_t time_pos = pos;
+  if (flags & MESH_FRAME_F_TIME) pos += 2;
+  size_t id_len = 0;
+  if (!keepalive && (flags & MESH_FRAME_F_ID)) {
+    if (len < pos + 2) return MESH_FRAME_INVALID;
+    id_len = buf[pos];
+    if (id_len > ODID_ID_SIZE) return MESH_FRAME_INVALID;
+    pos += 1 + id_len;
+  }
+  if (len != pos + 1) return MESH_FRAME_INVALID;
+
+  memset(UAV, 0, sizeof(*UAV));
+  memcpy(UAV->mac, &buf[2], 6);
+  format_mac(UAV->mac_str, UAV->mac);
+  if (node_id) *node_id = get_le16(&buf[8]);
+  UAV->rssi = (int8_t)buf[10];
+  UAV->band = flags >> MESH_FRAME_BAND_SHIFT;
+  UAV->utc_ds = (flags & MESH_FRAME_F_TIME) ? get_le16(&buf[time_pos]) : TIME_SYNC_NONE;
+  UAV->flag = 1;
+  if (keepalive) return MESH_FRAME_KEEPALIVE;
+
+  UAV->lat_e7 = get_le32(&buf[11]);
+  UAV->long_e7 = get_le32(&buf[15]);
+  UAV->altitude_msl = (int)decodeAltitude(get_le16(&buf[19]));
+  UAV->speed = (int)decodeSpeedHorizontal(buf[21], (flags & MESH_FRAME_F_SPEEDX) ? 1 : 0);
+  UAV->heading = (int)decodeDirection(buf[22], (flags & MESH_FRAME_F_EW) ? 1 : 0);
+  UAV->base_lat_e7 = get_le32(&buf[23]);
+  UAV->base_long_e7 = get_le32(&buf[27]);
+  if (id_len) memcpy(UAV->uav_id, &buf[pos - id_len], id_len);
+  return MESH_FRAME_FULL;
+}
+
+// "RIDB:" + base64 of an encoded frame
+static int frame_to_text(char *out, size_t size, const uint8_t *frame, int len) {
+  size_t prefix = sizeof(MESH_FRAME_PREFIX) - 1;
+  size_t need = prefix + ((len + 2) / 3) * 4 + 1;
+  if (len == 0 || size < need) return 0;
+
+  memcpy(out, MESH_FRAME_PREFIX, prefix);
+  char *o = out + prefix;
+  for (int i = 0; i < len; i += 3) {
+    uint32_t v = (uint32_t)frame[i] << 16;
+    if (i + 1 < len) v |= (uint32_t)frame[i + 1] << 8;
+    if (i + 2 < len) v |= frame[i + 2];
+    *o++ = b64_alphabet[(v >> 18) & 0x3f];
+    *o++ = b64_alphabet[(v >> 12) & 0x3f];
+    *o++ = (i + 1 < len) ? b64_alphabet[(v >> 6) & 0x3f] : '=';
+    *o++ = (i + 2 < len) ? b64_alphabet[v & 0x3f] : '=';
+  }
+  *o = '\0';
+  return (int)(o - out);
+}
+
+int mesh_frame_to_text(char *out, size_t size, const id_data *UAV,
+                       uint16_t node_id, bool with_id) {
+  uint8_t frame[MESH_FRAME_MAX_LEN];
+  int len = mesh_frame_encode(frame, sizeof(frame), UAV, node_id, with_id);
+  return frame_to_text(out, size, frame, len);
+}
+
+int mesh_frame_keepalive_to_text(char *out, size_t size, const id_data *UAV,
+                                 uint16_t node_id) {
+  uint8_t frame[MESH_FRAME_KEEPALIVE_LEN + 2];
+  int len = mesh_frame_encode_keepalive(frame, sizeof(frame), UAV, node_id);
+  return frame_to_text(out, size, frame, len);
+}
+
+static int b64_value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+mesh_frame_kind mesh_frame_from_text(const char *line, id_data *UAV, uint16_t *node_id) {
+  const char *p = strstr(line, MESH_FRAME_PREFIX);
+  if (!p) return MESH_FRAME_INVALID;
+  p += sizeof(MESH_FRAME_PREFIX) - 1;
+
+  uint8_t frame[MESH_FRAME_MAX_LEN];
+  size_t len = 0;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (; *p && *p != '='; p++) {
+    int v = b64_value(*p);
+    if (v < 0) break;
+    acc = (acc << 6) | (uint32_t)v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      if (len >= sizeof(frame)) return MESH_FRAME_INVALID;
+      frame[len++] = (uint8_t)(acc >> bits);
+    }
+  }
+  return mesh_frame_decode(frame, len, UAV, node_id);
+}
+
+void mesh_frame_save_state(mesh_frame_state *st, const id_data *UAV) {
+  st->lat_e7 = UAV->lat_e7;
+  st->long_e7 = UAV->long_e7;
+  st->base_lat_e7 = UAV->base_lat_e7;
+  st->base_long_e7 = UAV->base_long_e7;
+  st->altitude_msl = (int16_t)UAV->altitude_msl;
+  st->speed = (int16_t)UAV->speed;
+  st->heading = (int16_t)UAV->heading;
+  st->valid = true;
+}
+
+void mesh_frame_load_state(const mesh_frame_state *st, id_data *UAV) {
+  UAV->lat_e7 = st->lat_e7;
+  UAV->long_e7 = st->long_e7;
+  UAV->base_lat_e7 = st->base_lat_e7;
+  UAV->base_long_e7 = st->base_long_e7;
+  UAV->altitude_msl = st->altitude_msl;
+  UAV->speed = st->speed;
+  UAV->heading = st->heading;
+}
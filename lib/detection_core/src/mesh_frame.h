@@ -0,0 +1,115 @@
+/*
+ * mesh_frame.h - Compact binary detection frame for the LoRa uplink.
+ *
+ * A text mesh line costs ~90 bytes of airtime for the drone plus another
+ * ~60 for the pilot. This frame carries the same detection in 32 bytes,
+ * using ODID's own field encodings, and travels base64-packed as one
+ * Meshtastic text line: "RIDB:" + base64(frame). The home node turns it
+ * back into mesh-mapper JSON.
+ *
+ * Layout, version 2 (multi-byte fields little-endian):
+ *   0      version (MESH_FRAME_VERSION)
+ *   1      flags (MESH_FRAME_F_*), band in bits 6-7
+ *   2-7    transmitter MAC
+ *   8-9    node id
+ *   10     RSSI (int8)
+ *   11-18  drone lat, lon (int32, encodeLatLon: 1e-7 deg)
+ *   19-20  drone altitude MSL (encodeAltitude: 0.5 m, -1000 m offset)
+ *   21     ground speed (encodeSpeedHorizontal)
+ *   22     heading (encodeDirection)
+ *   23-30  operator lat, lon (int32, encodeLatLon)
+ *   [2 bytes  utc_ds (uint16, time_sync.h)]        if MESH_FRAME_F_TIME
+ *   [basic_id length, then basic_id bytes]        if MESH_FRAME_F_ID
+ *   last   CRC-8 (poly 0x07) over every preceding byte
+ *
+ * Keepalive (MESH_FRAME_F_KEEPALIVE set): bytes 0-10 as above, the
+ * optional utc_ds, then the CRC-8; 12 or 14 bytes in all. It says "still
+ * in view, nothing moved" and is expanded with the state of the drone's
+ * last full frame, which the receiver keeps per MAC in a mesh_frame_state.
+ *
+ * Version 1 had only the full frame. The keepalive shape and the utc_ds
+ * in front of the ID are what made version 2: a version 1 home node would
+ * take a keepalive for a truncated full frame and utc_ds for ID bytes, so
+ * it drops them on the version byte instead. Decoders also reject flag
+ * bits outside MESH_FRAME_F_KNOWN; a field added later needs its own flag
+ * and a version bump.
+ */
+
+#ifndef _MESH_FRAME_H_
+#define _MESH_FRAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "uav_tracker.h"
+
+#define MESH_FRAME_VERSION   2
+#define MESH_FRAME_PREFIX    "RIDB:"
+
+#define MESH_FRAME_F_EW      0x01   // heading >= 180 deg (encodeDirection)
+#define MESH_FRAME_F_SPEEDX  0x02   // speed multiplier (encodeSpeedHorizontal)
+#define MESH_FRAME_F_ID      0x04   // basic_id appended
+#define MESH_FRAME_F_KEEPALIVE 0x08 // no position fields
+#define MESH_FRAME_F_TIME    0x10   // sender's synced utc_ds appended
+#define MESH_FRAME_F_KNOWN   (0xC0 | MESH_FRAME_F_EW | MESH_FRAME_F_SPEEDX | MESH_FRAME_F_ID | \
+                              MESH_FRAME_F_KEEPALIVE | MESH_FRAME_F_TIME)
+#define MESH_FRAME_BAND_SHIFT 6
+
+// Senders append basic_id on a drone's first frame and every Nth after;
+// the home node caches it per MAC in between
+#ifndef MESH_FRAME_ID_EVERY
+#define MESH_FRAME_ID_EVERY  4
+#endif
+
+#define MESH_FRAME_CORE_LEN  31
+#define MESH_FRAME_KEEPALIVE_LEN 12
+#define MESH_FRAME_MAX_LEN   (MESH_FRAME_CORE_LEN + 2 + 1 + ODID_ID_SIZE + 1)
+// Prefix + base64 + NUL
+#define MESH_FRAME_TEXT_MAX  (sizeof(MESH_FRAME_PREFIX) + ((MESH_FRAME_MAX_LEN + 2) / 3) * 4)
+
+enum mesh_frame_kind {
+  MESH_FRAME_INVALID = 0,   // bad version, flags, length or CRC
+  MESH_FRAME_FULL,
+  MESH_FRAME_KEEPALIVE      // only MAC, node id, RSSI, band, utc_ds decoded
+};
+
+// Position fields of a drone's last full frame, to expand its keepalives
+struct mesh_frame_state {
+  int32_t lat_e7;
+  int32_t long_e7;
+  int32_t base_lat_e7;
+  int32_t base_long_e7;
+  int16_t altitude_msl;
+  int16_t speed;
+  int16_t heading;
+  bool    valid;
+};
+
+// Binary frame into buf; returns its length, 0 if buf is too small.
+int mesh_frame_encode(uint8_t *buf, size_t size, const id_data *UAV,
+                      uint16_t node_id, bool with_id);
+
+// Keepalive frame into buf; returns its length, 0 if buf is too small.
+int mesh_frame_encode_keepalive(uint8_t *buf, size_t size, const id_data *UAV,
+                                uint16_t node_id);
+
+// Parse a binary frame. Fields the frame does not carry are zeroed;
+// uav_id is left empty when the frame has no basic_id, utc_ds is
+// TIME_SYNC_NONE without MESH_FRAME_F_TIME.
+mesh_frame_kind mesh_frame_decode(const uint8_t *buf, size_t len, id_data *UAV,
+                                  uint16_t *node_id);
+
+// "RIDB:<base64>" text line; returns strlen, 0 if out is too small.
+int mesh_frame_to_text(char *out, size_t size, const id_data *UAV,
+                       uint16_t node_id, bool with_id);
+int mesh_frame_keepalive_to_text(char *out, size_t size, const id_data *UAV,
+                                 uint16_t node_id);
+
+// Decode the first "RIDB:" frame found in line (Meshtastic may prefix the
+// text with the sender name).
+mesh_frame_kind mesh_frame_from_text(const char *line, id_data *UAV, uint16_t *node_id);
+
+// Keep the position fields of a full frame / fill them into a keepalive.
+void mesh_frame_save_state(mesh_frame_state *st, const id_data *UAV);
+void mesh_frame_load_state(const mesh_frame_state *st, id_data *UAV);
+
+#endif // _MESH_FRAME_H_
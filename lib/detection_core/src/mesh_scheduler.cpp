@@ -0,0 +1,175 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh_scheduler.h"
+
+// Metres per 1e-7 degree of latitude; longitude scales by cos(latitude)
+#define M_PER_E7_LAT 0.011132f
+
+// Wrap-safe "a is at or after b" for millis() timestamps
+static inline bool time_reached(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) >= 0;
+}
+
+void mesh_scheduler_init(mesh_scheduler *s, uint32_t drone_interval_ms,
+                         uint32_t line_gap_ms, bool pilot_lines) {
+  memset(s->slots, 0, sizeof(s->slots));
+  s->drone_interval_ms = drone_interval_ms;
+  s->line_gap_ms = line_gap_ms;
+  s->next_line = 0;
+  s->pilot_slot = -1;
+  s->pilot_lines = pilot_lines;
+  s->delta_move_m = MESH_DELTA_MOVE_M;
+  s->delta_alt_m = MESH_DELTA_ALT_M;
+  s->delta_heading_deg = MESH_DELTA_HEADING_DEG;
+  s->keepalive_ms = MESH_KEEPALIVE_MS;
+  s->refresh_ms = MESH_REFRESH_MS;
+  s->lines_sent = 0;
+  s->keepalives = 0;
+  s->unchanged = 0;
+  s->slot_evictions = 0;
+  dc_lock_init(&s->lock);
+}
+
+void mesh_scheduler_update(mesh_scheduler *s, const id_data *UAV) {
+  uint32_t now = dc_millis();
+  int free_idx = -1, oldest_idx = 0;
+
+  dc_lock(&s->lock);
+  for (int i = 0; i < MESH_SCHED_SLOTS; i++) {
+    mesh_slot *slot = &s->slots[i];
+    if (!slot->used) {
+      if (free_idx < 0) free_idx = i;
+      continue;
+    }
+    if (memcmp(slot->uav.mac, UAV->mac, 6) == 0) {
+      slot->uav = *UAV;
+      slot->updated = now;
+      dc_unlock(&s->lock);
+      return;
+    }
+    if (!time_reached(slot->updated, s->slots[oldest_idx].updated))
+      oldest_idx = i;
+  }
+
+  // New drone: take a free slot, else the one heard from least recently
+  int idx = free_idx;
+  if (idx < 0) {
+    idx = oldest_idx;
+    s->slot_evictions++;
+    if (s->pilot_slot == idx) s->pilot_slot = -1;
+  }
+  mesh_slot *slot = &s->slots[idx];
+  slot->uav = *UAV;
+  slot->updated = now;
+  slot->due = now;
+  slot->sends = 0;
+  slot->used = true;
+  dc_unlock(&s->lock);
+}
+
+// Farther apart than m metres. 0,0 is "no position": gaining or losing
+// one counts as a move.
+static bool moved(int32_t lat0, int32_t lon0, int32_t lat1, int32_t lon1, uint16_t m) {
+  bool had = lat0 != 0 || lon0 != 0, has = lat1 != 0 || lon1 != 0;
+  if (!had || !has) return had != has;
+  float dy = (float)(lat1 - lat0) * M_PER_E7_LAT;
+  float dx = (float)(lon1 - lon0) * M_PER_E7_LAT *
+             cosf((float)lat1 * 1e-7f * (float)M_PI / 180.0f);
+  return dx * dx + dy * dy > (float)m * (float)m;
+}
+
+static bool changed(const mesh_scheduler *s, const mesh_slot *slot) {
+  const id_data *u = &slot->uav;
+  const mesh_sent *p = &slot->sent;
+  if (!p->had_id && u->uav_id[0]) return true;
+  if (moved(p->lat_e7, p->long_e7, u->lat_e7, u->long_e7, s->delta_move_m)) return true;
+  if (moved(p->base_lat_e7, p->base_long_e7, u->base_lat_e7, u->base_long_e7, s->delta_move_m))
+    return true;
+  if (abs(u->altitude_msl - p->altitude_msl) > s->delta_alt_m) return true;
+  int turn = abs(u->heading - p->heading) % 360;
+  if (turn > 180) turn = 360 - turn;
+  return turn > s->delta_heading_deg;
+}
+
+static void record_sent(mesh_slot *slot, uint32_t now) {
+  const id_data *u = &slot->uav;
+  mesh_sent *p = &slot->sent;
+  p->lat_e7 = u->lat_e7;
+  p->long_e7 = u->long_e7;
+  p->base_lat_e7 = u->base_lat_e7;
+  p->base_long_e7 = u->base_long_e7;
+  p->altitude_msl = (int16_t)u->altitude_msl;
+  p->heading = (int16_t)u->heading;
+  p->had_id = u->uav_id[0] != '\0';
+  p->full_ms = now;
+  p->line_ms = now;
+}
+
+mesh_part mesh_scheduler_next(mesh_scheduler *s, uint32_t now, id_data *out,
+                              uint16_t *sends) {
+  mesh_part part = MESH_PART_NONE;
+
+  dc_lock(&s->lock);
+  if (!time_reached(now, s->next_line)) {
+    dc_unlock(&s->lock);
+    return MESH_PART_NONE;
+  }
+
+  // A drone line with a pilot position owes its follow-up first
+  if (s->pilot_slot >= 0) {
+    mesh_slot *slot = &s->slots[s->pilot_slot];
+    s->pilot_slot = -1;
+    if (slot->used && slot->uav.base_lat_e7 != 0 && slot->uav.base_long_e7 != 0) {
+      *out = slot->uav;
+      if (sends) *sends = slot->sends - 1;
+      part = MESH_PART_PILOT;
+    }
+  }
+
+  // Most overdue drone wins; stale drones give their slot back. A due
+  // drone with nothing to report is rescheduled without using the line,
+  // and the next most overdue one gets a look.
+  for (int tries = 0; part == MESH_PART_NONE && tries < MESH_SCHED_SLOTS; tries++) {
+    int best = -1;
+    for (int i = 0; i < MESH_SCHED_SLOTS; i++) {
+      mesh_slot *slot = &s->slots[i];
+      if (!slot->used) continue;
+      if (!time_reached(slot->updated + MESH_STALE_MS, now)) {
+        slot->used = false;
+        continue;
+      }
+      if (!time_reached(now, slot->due)) continue;
+      if (best < 0 || !time_reached(slot->due, s->slots[best].due))
+        best = i;
+    }
+    if (best < 0) break;
+
+    mesh_slot *slot = &s->slots[best];
+    slot->due = now + s->drone_interval_ms;
+    if (s->keepalive_ms == 0 || slot->sends == 0 || changed(s, slot) ||
+        time_reached(now, slot->sent.full_ms + s->refresh_ms)) {
+      *out = slot->uav;
+      if (sends) *sends = slot->sends;
+      if (slot->sends < UINT16_MAX) slot->sends++;
+      record_sent(slot, now);
+      part = MESH_PART_DRONE;
+      if (s->pilot_lines) s->pilot_slot = best;
+    } else if (time_reached(now, slot->sent.line_ms + s->keepalive_ms)) {
+      *out = slot->uav;
+      if (sends) *sends = slot->sends;
+      slot->sent.line_ms = now;
+      part = MESH_PART_KEEPALIVE;
+      s->keepalives++;
+    } else {
+      s->unchanged++;
+    }
+  }
+
+  if (part != MESH_PART_NONE) {
+    s->next_line = now + s->line_gap_ms;
+    s->lines_sent++;
+  }
+  dc_unlock(&s->lock);
+  return part;
+}
@@ -0,0 +1,120 @@
+/*
+ * mesh_scheduler.h - Per-drone pacing for the Meshtastic UART uplink.
+ *
+ * LoRa airtime is the scarce resource, not the UART. The printer task
+ * hands every detection to mesh_scheduler_update() and polls
+ * mesh_scheduler_next(), which releases at most one line per line_gap_ms.
+ * Each drone is due again drone_interval_ms after its last send, and the
+ * most overdue drone always goes next, so drones share the budget round
+ * robin instead of the loudest one winning. Nothing here blocks, so USB
+ * JSON output never waits on mesh pacing.
+ *
+ * The uplink is change-only: a due drone goes out in full only once it
+ * has moved, climbed or turned past the delta thresholds (or its pilot
+ * has moved) since its last full line. A hovering or parked drone gets a
+ * keepalive every keepalive_ms instead, which the sender turns into a
+ * 12-byte frame the home node expands from its last full state, and a
+ * full line every refresh_ms so a home node that lost that state (reboot,
+ * dropped frame) catches up. keepalive_ms = 0 sends every due drone in
+ * full.
+ */
+
+#ifndef _MESH_SCHEDULER_H_
+#define _MESH_SCHEDULER_H_
+
+#include <stdint.h>
+#include "uav_tracker.h"
+#include "dc_port.h"
+
+// Drones that can hold a mesh slot at once
+#ifndef MESH_SCHED_SLOTS
+#define MESH_SCHED_SLOTS 32
+#endif
+
+// Drone stops competing for airtime after this long without a detection
+#ifndef MESH_STALE_MS
+#define MESH_STALE_MS 30000
+#endif
+
+// Change-only uplink thresholds, against the drone's last full line.
+// Keepalives must come faster than the home node's DEDUP_STALE_MS, or it
+// forgets the state they are expanded from.
+#ifndef MESH_DELTA_MOVE_M
+#define MESH_DELTA_MOVE_M      10      // drone or pilot position
+#endif
+#ifndef MESH_DELTA_ALT_M
+#define MESH_DELTA_ALT_M       5
+#endif
+#ifndef MESH_DELTA_HEADING_DEG
+#define MESH_DELTA_HEADING_DEG 20
+#endif
+#ifndef MESH_KEEPALIVE_MS
+#define MESH_KEEPALIVE_MS      20000   // 0: no change detection
+#endif
+#ifndef MESH_REFRESH_MS
+#define MESH_REFRESH_MS        120000
+#endif
+
+enum mesh_part {
+  MESH_PART_NONE = 0,
+  MESH_PART_DRONE,    // drone line (MAC, RSSI, position)
+  MESH_PART_PILOT,    // follow-up pilot line for the drone just sent
+  MESH_PART_KEEPALIVE // drone unchanged since its last drone line
+};
+
+// What the last full drone line said, for change detection
+struct mesh_sent {
+  int32_t  lat_e7;
+  int32_t  long_e7;
+  int32_t  base_lat_e7;
+  int32_t  base_long_e7;
+  int16_t  altitude_msl;
+  int16_t  heading;
+  bool     had_id;     // uav_id was known
+  uint32_t full_ms;    // millis() of the last drone line
+  uint32_t line_ms;    // millis() of the last drone line or keepalive
+};
+
+struct mesh_slot {
+  id_data   uav;       // latest snapshot
+  mesh_sent sent;
+  uint32_t  due;       // earliest millis() for the next drone line
+  uint32_t  updated;   // millis() of the latest snapshot
+  uint16_t  sends;     // drone lines sent since the slot was claimed
+  bool      used;
+};
+
+struct mesh_scheduler {
+  mesh_slot slots[MESH_SCHED_SLOTS];
+  uint32_t  drone_interval_ms;
+  uint32_t  line_gap_ms;
+  uint32_t  next_line;     // earliest millis() for any line
+  int       pilot_slot;    // slot owing a pilot line, -1 if none
+  bool      pilot_lines;   // false: drone line carries everything
+  // Change-only uplink, MESH_DELTA_* / MESH_KEEPALIVE_MS / MESH_REFRESH_MS
+  // at init
+  uint16_t  delta_move_m;
+  uint16_t  delta_alt_m;
+  uint16_t  delta_heading_deg;
+  uint32_t  keepalive_ms;
+  uint32_t  refresh_ms;
+  uint32_t  lines_sent;
+  uint32_t  keepalives;    // ...of which keepalives
+  uint32_t  unchanged;     // due drones passed over, nothing to report
+  uint32_t  slot_evictions;
+  dc_lock_t lock;
+};
+
+void mesh_scheduler_init(mesh_scheduler *s, uint32_t drone_interval_ms,
+                         uint32_t line_gap_ms, bool pilot_lines);
+
+// Record the latest state of a drone. New drones are due immediately.
+void mesh_scheduler_update(mesh_scheduler *s, const id_data *UAV);
+
+// Line to send now, if the airtime budget allows one. *out receives the
+// drone snapshot for the returned part; *sends (nullable) the number of
+// earlier drone lines (not keepalives) for this drone, 0 on its first.
+mesh_part mesh_scheduler_next(mesh_scheduler *s, uint32_t now, id_data *out,
+                              uint16_t *sends);
+
+#endif // _MESH_SCHEDULER_H_
@@ -0,0 +1,190 @@
+#include <string.h>
+#include "odid_decoder.h"
+#include "odid_wifi.h"
+
+// 802.11 management header (24) + beacon fixed fields (12)
+#define BEACON_IE_OFFSET   36
+// Vendor IE: id, len, OUI[3], OUI type, message counter
+#define ODID_VENDOR_HDR    7
+
+static const uint8_t nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
+
+void odid_decoder_init(odid_decoder *dec) {
+  memset(dec, 0, sizeof(*dec));
+}
+
+#if DC_METRICS
+// Count every message a successful decode accepted into dec->fields
+static void count_valid(odid_decoder *dec) {
+  const odid_fields *f = &dec->fields;
+  dc_decode_stats *s = &dec->stats;
+  s->ok[ODID_MESSAGETYPE_BASIC_ID] += __builtin_popcount(f->basic_id_valid);
+  s->ok[ODID_MESSAGETYPE_AUTH] += __builtin_popcount(f->auth_pages);
+  for (int t = ODID_MESSAGETYPE_LOCATION; t <= ODID_MESSAGETYPE_OPERATOR_ID; t++)
+    if (t != ODID_MESSAGETYPE_AUTH) s->ok[t] += (f->present >> t) & 1;
+}
+#define COUNT_VALID(dec)   count_valid(dec)
+#else
+#define COUNT_VALID(dec)   ((void)0)
+#endif
+
+// NAN service discovery frame up to the ODID message pack: management
+// header, public action header, Service Descriptor Attribute, service info
+#define NAN_SDA_OFFSET     (sizeof(struct ieee80211_mgmt) + sizeof(struct nan_service_discovery))
+#define NAN_PACK_OFFSET    (NAN_SDA_OFFSET + sizeof(struct nan_service_descriptor_attribute) + \
+                            sizeof(struct ODID_service_info))
+#define NAN_SDEA_LEN       sizeof(struct nan_service_descriptor_extension_attribute)
+
+static const uint8_t nan_action_hdr[6] = {0x04, 0x09, 0x50, 0x6f, 0x9a, 0x13};
+static const uint8_t nan_service_id[6] = {0x88, 0x69, 0x19, 0x9d, 0x92, 0x09};
+
+static uint16_t le16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+// The checks of odid_wifi_receive_message_pack_nan_action_frame(), with the
+// pack decoded into dec->fields. The destination was matched by the caller.
+static bool decode_nan(odid_decoder *dec, const uint8_t *payload, int length) {
+  if ((le16(payload) & 0x00fc) != 0x00d0) return false;  // management action
+  memcpy(dec->mac, &payload[10], 6);
+  if (length < (int)(NAN_PACK_OFFSET + NAN_SDEA_LEN - 1)) return false;
+  if (memcmp(&payload[sizeof(struct ieee80211_mgmt)], nan_action_hdr, 6) != 0) return false;
+
+  const uint8_t *sda = payload + NAN_SDA_OFFSET;
+  if (sda[0] != 0x03 || memcmp(&sda[3], nan_service_id, 6) != 0 || sda[9] != 0x01 ||
+      sda[11] != 0x10)
+    return false;
+
+  // The library bounds the pack by what is left after the header and the
+  // extension attribute, counted from the service info byte
+  int ret = odid_fields_decode_pack(&dec->fields, payload + NAN_PACK_OFFSET,
+                                    length - (NAN_PACK_OFFSET - 1) - NAN_SDEA_LEN);
+  if (ret < 0) return false;
+  uint8_t info_len = sda[12];
+  if (info_len != sizeof(struct ODID_service_info) + ret ||
+      le16(&sda[1]) != sizeof(struct nan_service_descriptor_attribute) -
+                       sizeof(struct nan_attribute_header) + info_len)
+    return false;
+
+  int at = NAN_PACK_OFFSET + ret;
+  if (at + (int)NAN_SDEA_LEN > length) return false;
+  const uint8_t *sdea = payload + at;
+  return sdea[0] == 0x0e && le16(&sdea[1]) == 0x0004 && sdea[3] == 0x01 &&
+         le16(&sdea[4]) == 0x0200;
+}
+
+// OUI bytes as read by a little-endian 32-bit load of ie[2..5], with the
+// OUI type byte (ie[5]) masked off
+#define OUI_KEY(a, b, c)   ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16))
+#define OUI_KEY_MASK       0x00ffffffu
+#define OUI_ASD_STAN       OUI_KEY(0x90, 0x3a, 0xe6)
+#define OUI_ASTM           OUI_KEY(0xfa, 0x0b, 0xbc)
+
+const uint8_t *odid_find_vendor_ie(const uint8_t *ie, const uint8_t *end,
+                                   uint32_t *examined) {
+  uint32_t seen = 0;
+  const uint8_t *found = nullptr;
+  while (end - ie >= 2) {
+    uint8_t id = ie[0], len = ie[1];
+    seen += 2;
+    if (end - ie < 2 + len) break;  // truncated IE
+
+    // Non-vendor IEs are skipped on the header alone
+    if (id == 0xdd && len >= ODID_VENDOR_HDR - 2) {
+      uint32_t word;
+      memcpy(&word, &ie[2], sizeof(word));  // unaligned-safe single load
+      seen += sizeof(word);
+      word &= OUI_KEY_MASK;
+      if (word == OUI_ASTM || word == OUI_ASD_STAN) {
+        found = ie;
+        break;
+      }
+    }
+    ie += 2 + len;
+  }
+  *examined += seen;
+  return found;
+}
+
+odid_frame_kind odid_decode_wifi_frame(odid_decoder *dec, uint8_t *payload, int length) {
+  if (length < (int)sizeof(struct ieee80211_mgmt)) return ODID_FRAME_NONE;
+
+  // NAN Action Frame (WiFi Aware RemoteID)
+  if (memcmp(nan_dest, &payload[4], 6) == 0) {
+    DC_METRIC_INC(dec->stats.seen[DC_FRAME_NAN]);
+    if (!decode_nan(dec, payload, length)) {
+      DC_METRIC_INC(dec->stats.fail[DC_MSG_PACKED]);
+      return ODID_FRAME_NONE;
+    }
+    DC_METRIC_INC(dec->stats.ok[DC_MSG_PACKED]);
+    COUNT_VALID(dec);
+    return ODID_FRAME_NAN;
+  }
+
+  // Beacon Frame with RemoteID Vendor Specific IE
+  if (payload[0] == 0x80 && length > BEACON_IE_OFFSET) {
+    const uint8_t *end = payload + length;
+    dec->beacons_scanned++;
+    const uint8_t *ie = odid_find_vendor_ie(payload + BEACON_IE_OFFSET, end,
+                                            &dec->ie_bytes_examined);
+    if (!ie) return ODID_FRAME_NONE;
+
+    DC_METRIC_INC(dec->stats.seen[DC_FRAME_BEACON]);
+    uint8_t *pack = (uint8_t *)ie + ODID_VENDOR_HDR;
+    if (pack >= end || odid_fields_decode_pack(&dec->fields, pack, end - pack) < 0) {
+      DC_METRIC_INC(dec->stats.fail[DC_MSG_PACKED]);
+      return ODID_FRAME_NONE;
+    }
+    DC_METRIC_INC(dec->stats.ok[DC_MSG_PACKED]);
+    COUNT_VALID(dec);
+    memcpy(dec->mac, &payload[10], 6);
+    return ODID_FRAME_BEACON;
+  }
+  return ODID_FRAME_NONE;
+}
+
+odid_frame_kind odid_decode_ble_adv(odid_decoder *dec, const uint8_t *payload, int length) {
+  // RemoteID BLE advertisement: Service Data, UUID 0xFFFA, app code 0x0D,
+  // message counter, then one message or a message pack. Extended
+  // advertisements may put Flags first, so walk the AD structures.
+  const uint8_t *ad = payload, *end = payload + length;
+  for (;;) {
+    if (end - ad < 2 || ad[0] == 0 || end - ad < 1 + ad[0]) return ODID_FRAME_NONE;
+    if (ad[1] == 0x16 && ad[0] >= 5 && ad[2] == 0xFA &&
+        ad[3] == 0xFF && ad[4] == 0x0D) break;
+    ad += 1 + ad[0];
+  }
+
+  DC_METRIC_INC(dec->stats.seen[DC_FRAME_BLE]);
+  uint8_t *odid = (uint8_t *)&ad[6];
+  int avail = 1 + ad[0] - 6;
+  if (avail < ODID_MESSAGE_SIZE) {
+    // Too short for any message: a failure in the pack bucket, so every
+    // seen frame ends up in ok or fail
+    DC_METRIC_INC(dec->stats.fail[DC_MSG_PACKED]);
+    return ODID_FRAME_NONE;
+  }
+
+  int type = odid[0] >> 4;
+  bool packed = type == ODID_MESSAGETYPE_PACKED;
+  // Failure bucket: the message type, or the pack (also for unknown types)
+  int stat = type <= ODID_MESSAGETYPE_OPERATOR_ID ? type : DC_MSG_PACKED;
+  (void)stat;  // unused with DC_METRICS=0
+  bool ok;
+  if (packed) {
+    ok = odid_fields_decode_pack(&dec->fields, odid, avail) >= 0;
+  } else {
+    odid_fields_reset(&dec->fields);
+    ok = odid_fields_decode_message(&dec->fields, odid) != ODID_MESSAGETYPE_INVALID;
+  }
+  if (!ok) {
+    DC_METRIC_INC(dec->stats.fail[stat]);
+    return ODID_FRAME_NONE;
+  }
+  COUNT_VALID(dec);
+  if (packed) {
+    DC_METRIC_INC(dec->stats.ok[DC_MSG_PACKED]);
+    dec->ble_packs++;
+    return ODID_FRAME_BLE_PACK;
+  }
+  dec->ble_messages++;
+  return ODID_FRAME_BLE;
+}
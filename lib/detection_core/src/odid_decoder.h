@@ -0,0 +1,55 @@
+/*
+ * odid_decoder.h - Open Drone ID frame recognisers for WiFi and BLE.
+ *
+ * Each decoding task owns its own odid_decoder, so the WiFi decode task and
+ * the BLE scan callback can run concurrently without sharing state.
+ * A successful decode leaves the result in dec->fields (odid_fields.h,
+ * present bits set for each message type) and the transmitter MAC in
+ * dec->mac.
+ */
+
+#ifndef _ODID_DECODER_H_
+#define _ODID_DECODER_H_
+
+#include <stdint.h>
+#include "odid_fields.h"
+#include "dc_metrics.h"
+
+enum odid_frame_kind {
+  ODID_FRAME_NONE = 0,
+  ODID_FRAME_NAN,       // WiFi NAN action frame (WiFi Aware)
+  ODID_FRAME_BEACON,    // WiFi beacon with ODID vendor-specific IE
+  ODID_FRAME_BLE,       // BLE advertisement with one ODID message
+  ODID_FRAME_BLE_PACK   // BT5 extended advertisement with a message pack
+};
+
+struct odid_decoder {
+  odid_fields   fields;
+  uint8_t       mac[6];
+  // Beacon IE scan cost: bytes examined / beacons scanned = per-frame cost
+  uint32_t      beacons_scanned;
+  uint32_t      ie_bytes_examined;
+  // BLE decodes by kind: single messages vs whole message packs
+  uint32_t      ble_messages;
+  uint32_t      ble_packs;
+  dc_decode_stats stats;            // DC_METRICS counters
+};
+
+void odid_decoder_init(odid_decoder *dec);
+
+// First ODID vendor-specific IE in [ie, end), or nullptr. Only IE headers
+// are read until an 0xDD with an ODID OUI turns up; *examined is
+// incremented by the number of bytes read.
+const uint8_t *odid_find_vendor_ie(const uint8_t *ie, const uint8_t *end,
+                                   uint32_t *examined);
+
+// Decode one 802.11 management frame (payload starts at frame control).
+odid_frame_kind odid_decode_wifi_frame(odid_decoder *dec, uint8_t *payload, int length);
+
+// Decode a BLE advertisement payload carrying ODID service data: one
+// message (legacy advertising) or a message pack (BT5 extended advertising,
+// typically on the Coded PHY). Packs fill every message type they carry.
+// The advertiser address is not part of the payload; dec->mac is untouched.
+odid_frame_kind odid_decode_ble_adv(odid_decoder *dec, const uint8_t *payload, int length);
+
+#endif // _ODID_DECODER_H_
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "odid_fields.h"
+
+// Message pack header: type/version, single message size, message count
+#define ODID_PACK_HDR 3
+
+static_assert(ODID_AUTH_MAX_PAGES <= 32, "auth_pages is a 32-bit mask");
+
+// safe_dec_copyfill() + strncpy(): up to ODID_ID_SIZE chars, zero-filled
+static void copy_id(char *dst, const char *src) {
+  strncpy(dst, src, ODID_ID_SIZE);
+  dst[ODID_ID_SIZE] = '\0';
+}
+
+static int decode_basic_id(odid_fields *f, const ODID_BasicID_encoded *m) {
+  // Same slot choice as decodeOpenDroneID(): first slot that is free or
+  // already holds this ID type
+  uint8_t id_type = m->IDType;
+  for (int i = 0; i < ODID_BASIC_ID_MAX_MESSAGES; i++) {
+    if (f->basic_id_type[i] != ODID_IDTYPE_NONE && f->basic_id_type[i] != id_type) continue;
+    f->basic_id_type[i] = id_type;
+    f->basic_id_valid |= 1u << i;
+    if (i == 0) {
+      f->ua_type = m->UAType;
+      copy_id(f->uas_id, m->UASID);
+    } else {
+      f->basic_id_2 = m;
+    }
+    f->present |= ODID_HAS(ODID_MESSAGETYPE_BASIC_ID);
+    return ODID_MESSAGETYPE_BASIC_ID;
+  }
+  return ODID_MESSAGETYPE_INVALID;
+}
+
+static int decode_location(odid_fields *f, const ODID_Location_encoded *m) {
+  f->status = m->Status;
+  f->height_type = m->HeightType;
+  f->direction = (uint16_t)(m->Direction + (m->EWDirection ? 180 : 0));
+  f->speed_q = m->SpeedMult ? (uint16_t)(m->SpeedHorizontal * 3 + 255)
+                            : m->SpeedHorizontal;
+  f->speed_vertical_h = m->SpeedVertical;
+  f->lat_e7 = m->Latitude;
+  f->long_e7 = m->Longitude;
+  f->alt_baro_h = ODID_ALT_HALF_M(m->AltitudeBaro);
+  f->alt_geo_h = ODID_ALT_HALF_M(m->AltitudeGeo);
+  f->height_h = ODID_ALT_HALF_M(m->Height);
+  f->timestamp_ds = m->TimeStamp;
+  f->present |= ODID_HAS(ODID_MESSAGETYPE_LOCATION);
+  return ODID_MESSAGETYPE_LOCATION;
+}
+
+// Page checks of getAuthPageNum() and decodeAuthMessage(); the page is
+// referenced, not copied
+static int decode_auth(odid_fields *f, const ODID_Auth_encoded *m) {
+  int page = m->page_zero.DataPage;
+  if (page >= ODID_AUTH_MAX_PAGES) return ODID_MESSAGETYPE_INVALID;
+  if (page == 0) {
+    int last = m->page_zero.LastPageIndex;
+    if (last >= ODID_AUTH_MAX_PAGES) return ODID_MESSAGETYPE_INVALID;
+    if (ODID_AUTH_PAGE_ZERO_DATA_SIZE + last * ODID_AUTH_PAGE_NONZERO_DATA_SIZE <
+        m->page_zero.Length)
+      return ODID_MESSAGETYPE_INVALID;
+  }
+  f->auth_pages |= 1u << page;
+  f->auth[page] = m;
+  f->present |= ODID_HAS(ODID_MESSAGETYPE_AUTH);
+  return ODID_MESSAGETYPE_AUTH;
+}
+
+static int decode_system(odid_fields *f, const ODID_System_encoded *m) {
+  f->op_location_type = m->OperatorLocationType;
+  f->op_lat_e7 = m->OperatorLatitude;
+  f->op_long_e7 = m->OperatorLongitude;
+  f->op_alt_geo_h = ODID_ALT_HALF_M(m->OperatorAltitudeGeo);
+  f->present |= ODID_HAS(ODID_MESSAGETYPE_SYSTEM);
+  return ODID_MESSAGETYPE_SYSTEM;
+}
+
+static int decode_operator_id(odid_fields *f, const ODID_OperatorID_encoded *m) {
+  f->op_id_type = m->OperatorIdType;
+  copy_id(f->operator_id, m->OperatorId);
+  f->present |= ODID_HAS(ODID_MESSAGETYPE_OPERATOR_ID);
+  return ODID_MESSAGETYPE_OPERATOR_ID;
+}
+
+int odid_fields_decode_message(odid_fields *f, const uint8_t *msg) {
+  const ODID_Message_encoded *m = (const ODID_Message_encoded *)msg;
+  switch (msg[0] >> 4) {
+    case ODID_MESSAGETYPE_BASIC_ID:    return decode_basic_id(f, &m->basicId);
+    case ODID_MESSAGETYPE_LOCATION:    return decode_location(f, &m->location);
+    case ODID_MESSAGETYPE_AUTH:        return decode_auth(f, &m->auth);
+    case ODID_MESSAGETYPE_SELF_ID:
+      f->self_id = &m->selfId;
+      f->present |= ODID_HAS(ODID_MESSAGETYPE_SELF_ID);
+      return ODID_MESSAGETYPE_SELF_ID;
+    case ODID_MESSAGETYPE_SYSTEM:      return decode_system(f, &m->system);
+    case ODID_MESSAGETYPE_OPERATOR_ID: return decode_operator_id(f, &m->operatorId);
+    default:                           return ODID_MESSAGETYPE_INVALID;
+  }
+}
+
+int odid_fields_decode_pack(odid_fields *f, const uint8_t *pack, size_t avail) {
+  odid_fields_reset(f);
+  if (avail < ODID_PACK_HDR) return -1;
+  int count = pack[2];
+  size_t size = ODID_PACK_HDR + (size_t)count * ODID_MESSAGE_SIZE;
+  if (size > avail) return -1;
+  if ((pack[0] >> 4) != ODID_MESSAGETYPE_PACKED || pack[1] != ODID_MESSAGE_SIZE ||
+      count < 1 || count > ODID_PACK_MAX_MESSAGES)
+    return -1;
+
+  // checkPackContent(): no nested packs, at most one of each message type
+  // except Basic ID and Auth
+  const uint8_t *msg = pack + ODID_PACK_HDR;
+  uint8_t seen[ODID_MESSAGETYPE_OPERATOR_ID + 1] = {0};
+  for (int i = 0; i < count; i++) {
+    int type = msg[i * ODID_MESSAGE_SIZE] >> 4;
+    if (type > ODID_MESSAGETYPE_OPERATOR_ID) return -1;
+    seen[type]++;
+  }
+  if (seen[ODID_MESSAGETYPE_BASIC_ID] > ODID_BASIC_ID_MAX_MESSAGES ||
+      seen[ODID_MESSAGETYPE_LOCATION] > 1 ||
+      seen[ODID_MESSAGETYPE_AUTH] > ODID_AUTH_MAX_PAGES ||
+      seen[ODID_MESSAGETYPE_SELF_ID] > 1 ||
+      seen[ODID_MESSAGETYPE_SYSTEM] > 1 ||
+      seen[ODID_MESSAGETYPE_OPERATOR_ID] > 1)
+    return -1;
+
+  // Rejected messages are skipped, as decodeMessagePack() does
+  for (int i = 0; i < count; i++) odid_fields_decode_message(f, msg + i * ODID_MESSAGE_SIZE);
+  return (int)size;
+}
@@ -0,0 +1,82 @@
+/*
+ * odid_fields.h - Lean Open Drone ID decode straight from the wire format.
+ *
+ * opendroneid.c turns every field of every message into float or double
+ * and re-initialises a whole ODID_UAS_Data (float defaults included) per
+ * frame. The tracker needs a handful of those fields as integers, and the
+ * C3 has no FPU, so this decoder copies just those out in the units the
+ * wire already uses: 1e-7 degrees, half metres, quarter m/s, tenths of a
+ * second. The accuracy enums are not kept; nothing downstream prints them.
+ *
+ * Acceptance matches opendroneid.c: the same pack content rules, Basic ID
+ * slot assignment and Auth page checks, so decode counters are unchanged.
+ */
+
+#ifndef _ODID_FIELDS_H_
+#define _ODID_FIELDS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "opendroneid.h"
+
+#define ODID_HAS(type)      (1u << (type))    // present bit per ODID_MESSAGETYPE_*
+#define ODID_ALT_HALF_M(raw) ((int32_t)(raw) - 2000)  // wire altitude -> half metres
+
+struct odid_fields {
+  uint8_t  present;               // ODID_HAS() bits of the messages decoded
+  // Basic ID: slot types as in ODID_UAS_Data.BasicID[], contents of slot 0
+  uint8_t  basic_id_valid;        // bit per slot
+  uint8_t  basic_id_type[ODID_BASIC_ID_MAX_MESSAGES];
+  uint8_t  ua_type;
+  char     uas_id[ODID_ID_SIZE + 1];
+  uint32_t auth_pages;            // bit per Auth page accepted
+  // Bulky messages are not copied: pointers into the decoded buffer, valid
+  // until it is released. uav_tracker_store() copies them out.
+  const ODID_BasicID_encoded *basic_id_2;           // slot 1, basic_id_valid & 2
+  const ODID_Auth_encoded    *auth[ODID_AUTH_MAX_PAGES];   // per auth_pages bit
+  const ODID_SelfID_encoded  *self_id;              // when SELF_ID is present
+  // Location
+  uint8_t  status;
+  uint8_t  height_type;
+  int8_t   speed_vertical_h;      // 0.5 m/s
+  uint16_t direction;             // degrees, 0..434 as sent
+  uint16_t speed_q;               // horizontal, 0.25 m/s
+  uint16_t timestamp_ds;          // 0.1 s after the hour, 0xFFFF = unknown
+  int32_t  lat_e7;
+  int32_t  long_e7;
+  int32_t  alt_baro_h;            // half metres, ODID_ALT_HALF_M()
+  int32_t  alt_geo_h;
+  int32_t  height_h;
+  // System
+  uint8_t  op_location_type;
+  int32_t  op_lat_e7;
+  int32_t  op_long_e7;
+  int32_t  op_alt_geo_h;
+  // Operator ID
+  uint8_t  op_id_type;
+  char     operator_id[ODID_ID_SIZE + 1];
+};
+
+// Forget the previous frame. Only the present masks are cleared; fields
+// of messages not flagged present are stale and must not be read.
+static inline void odid_fields_reset(odid_fields *f) {
+  f->present = 0;
+  f->basic_id_valid = 0;
+  f->auth_pages = 0;
+  for (int i = 0; i < ODID_BASIC_ID_MAX_MESSAGES; i++) f->basic_id_type[i] = ODID_IDTYPE_NONE;
+}
+
+// Decode one ODID_MESSAGE_SIZE message (not a pack) into f. Returns its
+// ODID_MESSAGETYPE_*, or ODID_MESSAGETYPE_INVALID if it was rejected.
+int odid_fields_decode_message(odid_fields *f, const uint8_t *msg);
+
+// Decode a message pack of at most avail bytes into f, which is reset
+// first. Returns the pack length, or -1 if the pack is malformed.
+int odid_fields_decode_pack(odid_fields *f, const uint8_t *pack, size_t avail);
+
+// Merge helpers for the integer fields the tracker keeps. Each matches the
+// (int) cast of the matching opendroneid float, truncation included.
+static inline int odid_half_m_to_int(int32_t h) { return (int)(h / 2); }
+static inline int odid_speed_to_int(uint16_t q) { return (int)(q / 4); }
+
+#endif // _ODID_FIELDS_H_
@@ -162,7 +162,7 @@ void odid_initUasData(ODID_UAS_Data *data)
                      East (0 - 179 degrees) or West (180 - 359)
 * @return Encoded Direction in a single byte
 */
-static uint8_t encodeDirection(float Direction, uint8_t *EWDirection)
+uint8_t encodeDirection(float Direction, uint8_t *EWDirection)
 {
     unsigned int direction_int = (unsigned int) roundf(Direction);
     if (direction_int < 180) {
@@ -186,7 +186,7 @@ static uint8_t encodeDirection(float Direction, uint8_t *EWDirection)
 * @param mult a (write only) value that sets the multiplier flag
 * @return Encoded Speed in a single byte or max speed if over max encoded speed.
 */
-static uint8_t encodeSpeedHorizontal(float Speed_data, uint8_t *mult)
+uint8_t encodeSpeedHorizontal(float Speed_data, uint8_t *mult)
 {
     if (Speed_data <= UINT8_MAX * SPEED_DIV[0]) {
         *mult = 0;
@@ -219,7 +219,7 @@ static int8_t encodeSpeedVertical(float SpeedVertical_data)
 * @param LatLon_data Either Lat or Lon double float value
 * @return Encoded Lat or Lon
 */
-static int32_t encodeLatLon(double LatLon_data)
+int32_t encodeLatLon(double LatLon_data)
 {
     return (int32_t) intRangeMax((int64_t) (LatLon_data * LATLON_MULT), -180 * LATLON_MULT, 180 * LATLON_MULT);
 }
@@ -233,7 +233,7 @@ static int32_t encodeLatLon(double LatLon_data)
 * @param Alt_data Altitude to encode (in meters)
 * @return Encoded Altitude
 */
-static uint16_t encodeAltitude(float Alt_data)
+uint16_t encodeAltitude(float Alt_data)
 {
     return (uint16_t) intRangeMax( (int) ((Alt_data + (float) ALT_ADDER) / ALT_DIV), 0, UINT16_MAX);
 }
@@ -566,7 +566,7 @@ int encodeMessagePack(ODID_MessagePack_encoded *outEncoded, ODID_MessagePack_dat
 * @param EWDirection East/West direction flag
 * @return direction in degrees (0 - 359)
 */
-static float decodeDirection(uint8_t Direction_enc, uint8_t EWDirection)
+float decodeDirection(uint8_t Direction_enc, uint8_t EWDirection)
 {
     if (EWDirection)
         return (float) Direction_enc + 180;
@@ -581,7 +581,7 @@ static float decodeDirection(uint8_t Direction_enc, uint8_t EWDirection)
 * @param mult multiplier flag
 * @return decoded speed in m/s
 */
-static float decodeSpeedHorizontal(uint8_t Speed_enc, uint8_t mult)
+float decodeSpeedHorizontal(uint8_t Speed_enc, uint8_t mult)
 {
     if (mult)
         return ((float) Speed_enc * SPEED_DIV[1]) + (UINT8_MAX * SPEED_DIV[0]);
@@ -606,7 +606,7 @@ static float decodeSpeedVertical(int8_t SpeedVertical_enc)
 * @param LatLon_enc Either Lat or Lon ecoded int value
 * @return decoded (double) Lat or Lon
 */
-static double decodeLatLon(int32_t LatLon_enc)
+double decodeLatLon(int32_t LatLon_enc)
 {
     return (double) LatLon_enc / LATLON_MULT;
 }
@@ -617,7 +617,7 @@ static double decodeLatLon(int32_t LatLon_enc)
 * @param Alt_enc Encoded Altitude to decode
 * @return decoded Altitude (in meters)
 */
-static float decodeAltitude(uint16_t Alt_enc)
+float decodeAltitude(uint16_t Alt_enc)
 {
     return (float) Alt_enc * ALT_DIV - (float) ALT_ADDER;
 }
@@ -745,6 +745,17 @@ int odid_message_process_pack(ODID_UAS_Data *UAS_Data, uint8_t *pack, size_t buf
 int odid_wifi_receive_message_pack_nan_action_frame(ODID_UAS_Data *UAS_Data,
                                                     char *mac, uint8_t *buf, size_t buf_size);
 
+/* Field codecs used by the message encoders/decoders above, exposed for the
+ * compact mesh frame (mesh_frame.h) so it shares ODID's wire encoding */
+uint8_t encodeDirection(float Direction, uint8_t *EWDirection);
+uint8_t encodeSpeedHorizontal(float Speed_data, uint8_t *mult);
+int32_t encodeLatLon(double LatLon_data);
+uint16_t encodeAltitude(float Alt_data);
+float decodeDirection(uint8_t Direction_enc, uint8_t EWDirection);
+float decodeSpeedHorizontal(uint8_t Speed_enc, uint8_t mult);
+double decodeLatLon(int32_t LatLon_enc);
+float decodeAltitude(uint16_t Alt_enc);
+
 #ifndef ODID_DISABLE_PRINTF
 void printByteArray(uint8_t *byteArray, uint16_t asize, int spaced);
 void printBasicID_data(ODID_BasicID_data *BasicID);
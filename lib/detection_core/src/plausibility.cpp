@@ -0,0 +1,61 @@
+#include <string.h>
+#include "plausibility.h"
+
+// cos() every 5 degrees of latitude, Q15
+static const uint16_t COS_Q15[19] = {
+  32767, 32642, 32269, 31650, 30791, 29697, 28377, 26841, 25101, 23170,
+  21062, 18794, 16384, 13848, 11207, 8481, 5690, 2856, 0
+};
+
+#define DM_PER_E7_Q16 7296       // 1e-7 degree of latitude, 0.011132 m, in dm Q16
+#define SPEED_Q_UNKNOWN 1020     // odid_fields speed_q of ODID's 255 m/s "invalid"
+
+static inline int32_t abs32(int32_t v) { return v < 0 ? -v : v; }
+
+static bool range_ok(const odid_fields *f) {
+  if (f->present & ODID_HAS(ODID_MESSAGETYPE_LOCATION)) {
+    if (abs32(f->lat_e7) > 900000000 || abs32(f->long_e7) > 1800000000) return false;
+    if (f->direction > MAX_DIR && f->direction != INV_DIR) return false;
+    int v = f->speed_vertical_h;
+    if (v < -2 * MAX_SPEED_V || (v > 2 * MAX_SPEED_V && v != 2 * INV_SPEED_V)) return false;
+  }
+  if (f->basic_id_valid & 1) {
+    for (int i = 0; i < ODID_ID_SIZE && f->uas_id[i]; i++)
+      if ((uint8_t)f->uas_id[i] < 0x20 || (uint8_t)f->uas_id[i] > 0x7E) return false;
+  }
+  return true;
+}
+
+// Squared distance in decimetres between two positions on a local plane
+static int64_t dist2_dm(int32_t lat_a, int32_t long_a, int32_t lat_b, int32_t long_b) {
+  int64_t dlong = (int64_t)long_b - long_a;
+  if (dlong > 1800000000) dlong -= 3600000000LL;
+  if (dlong < -1800000000) dlong += 3600000000LL;
+  int64_t dy = (((int64_t)lat_b - lat_a) * DM_PER_E7_Q16) >> 16;
+  uint32_t band = ((uint32_t)abs32(lat_b) + 25000000u) / 50000000u;
+  int64_t dx = (((dlong * DM_PER_E7_Q16) >> 16) * COS_Q15[band > 18 ? 18 : band]) >> 15;
+  return dx * dx + dy * dy;
+}
+
+static bool teleported(const id_data *UAV, const odid_fields *f, uint32_t now) {
+  if (UAV->location_ms == 0 || now - UAV->location_ms > PLAUS_TRACK_MS) return false;
+  if (UAV->lat_e7 == 0 && UAV->long_e7 == 0) return false;
+  int speed = f->speed_q == SPEED_Q_UNKNOWN ? INV_SPEED_H : odid_speed_to_int(f->speed_q);
+  if (UAV->speed > speed) speed = UAV->speed;
+  int64_t allowed_dm = (int64_t)(speed + PLAUS_SPEED_SLACK_MS) * (now - UAV->location_ms) / 100 +
+                       PLAUS_POS_SLACK_M * 10;
+  return dist2_dm(UAV->lat_e7, UAV->long_e7, f->lat_e7, f->long_e7) > allowed_dm * allowed_dm;
+}
+
+uint8_t plaus_check(const id_data *UAV, const odid_fields *f, uint32_t now) {
+  if (!range_ok(f)) return PLAUS_RANGE;
+  uint8_t flags = 0;
+  if (f->present & ODID_HAS(ODID_MESSAGETYPE_LOCATION)) {
+    if (f->lat_e7 == 0 && f->long_e7 == 0) flags |= PLAUS_NO_FIX;
+    else if (teleported(UAV, f, now)) flags |= PLAUS_TELEPORT;
+  }
+  if ((f->basic_id_valid & 1) && UAV->uav_id[0] && UAV->id_type == f->basic_id_type[0] &&
+      strncmp(UAV->uav_id, f->uas_id, ODID_ID_SIZE) != 0)
+    flags |= PLAUS_ID_CHANGE;
+  return flags;
+}
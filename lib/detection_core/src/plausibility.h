@@ -0,0 +1,67 @@
+/*
+ * plausibility.h - Per-drone sanity checks on decoded ODID updates.
+ *
+ * Anything that decodes gets forwarded, impossible tracks included, and
+ * each one costs serial bandwidth, mesh airtime and mapper CPU. The
+ * tracker runs plaus_check() on every store, against the drone's record
+ * as it was before the update:
+ *
+ *   PLAUS_RANGE      a value ODID cannot mean: latitude past 90, longitude
+ *                    past 180, direction past 360 (361 is "unknown"),
+ *                    vertical speed past 62 m/s, a UAS ID with
+ *                    non-printable bytes
+ *   PLAUS_NO_FIX     Location of exactly 0,0, ODID's "no position"; normal
+ *                    before a GNSS fix, so it is only reported
+ *   PLAUS_TELEPORT   moved further since the previous Location than the
+ *                    faster of the two reported speeds allows, plus
+ *                    PLAUS_SPEED_SLACK_MS and PLAUS_POS_SLACK_M
+ *   PLAUS_ID_CHANGE  this MAC sent a different UAS ID of the same ID type
+ *                    before
+ *
+ * Flags gather on the record until it is printed ("plaus" in the JSON).
+ * Stores with a flag in the tracker's suppress mask (PLAUS_SUPPRESS_MASK)
+ * are dropped before they are merged, so they never reach USB or the
+ * mesh, and the next check still runs against the last good state. A
+ * drone that really did jump or change ID gets through after
+ * PLAUS_REJECT_RUN dropped stores in a row; RANGE and NO_FIX never do.
+ *
+ * Integer only (the C3 has no FPU). Distances use a 5 degree cosine
+ * table, a few percent off at most, well inside the slack.
+ */
+
+#ifndef _PLAUSIBILITY_H_
+#define _PLAUSIBILITY_H_
+
+#include <stdint.h>
+#include "uav_tracker.h"
+
+#define PLAUS_RANGE      0x01
+#define PLAUS_NO_FIX     0x02
+#define PLAUS_TELEPORT   0x04
+#define PLAUS_ID_CHANGE  0x08
+#define PLAUS_STATELESS  (PLAUS_RANGE | PLAUS_NO_FIX)   // never re-accepted
+
+// Default: only values ODID cannot encode are dropped; the track checks
+// are reported and the mapper decides
+#ifndef PLAUS_SUPPRESS_MASK
+#define PLAUS_SUPPRESS_MASK PLAUS_RANGE
+#endif
+#ifndef PLAUS_SPEED_SLACK_MS
+#define PLAUS_SPEED_SLACK_MS 10     // on top of the reported speed
+#endif
+#ifndef PLAUS_POS_SLACK_M
+#define PLAUS_POS_SLACK_M    50     // GNSS noise between two fixes
+#endif
+#ifndef PLAUS_TRACK_MS
+#define PLAUS_TRACK_MS       10000  // older Locations start a new track
+#endif
+#ifndef PLAUS_REJECT_RUN
+#define PLAUS_REJECT_RUN     5
+#endif
+
+// PLAUS_* flags for merging f into UAV at now. UAV is the record before
+// the update (a fresh one has every *_ms at 0). Caller holds the tracker
+// lock.
+uint8_t plaus_check(const id_data *UAV, const odid_fields *f, uint32_t now);
+
+#endif // _PLAUSIBILITY_H_
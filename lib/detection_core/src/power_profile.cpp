@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include "power_profile.h"
+
+static const char *const mode_names[POWER_MODES] = {"active", "sentinel"};
+
+void power_profile_init(power_profile *p, uint32_t quiet_ms, uint16_t burst_ms,
+                        uint16_t period_ms, uint16_t ma_on, uint16_t ma_off, uint32_t now) {
+  memset(p, 0, sizeof(*p));
+  p->mode = POWER_MODE_ACTIVE;
+  p->radios_on = true;
+  p->quiet_ms = quiet_ms;
+  p->period_ms = period_ms ? period_ms : 1;
+  p->burst_ms = burst_ms < p->period_ms ? burst_ms : p->period_ms;
+  p->ma_on = ma_on;
+  p->ma_off = ma_off;
+  p->last_detection = now;
+  p->mode_since = now;
+  p->last_account = now;
+}
+
+bool power_profile_detection(power_profile *p, uint32_t now) {
+  p->last_detection = now;
+  return p->mode != POWER_MODE_ACTIVE;
+}
+
+// Charge the time since the last call to the current mode and radio state
+static void account(power_profile *p, uint32_t now) {
+  uint32_t spent = now - p->last_account;
+  if (p->radios_on) p->on_ms[p->mode] += spent;
+  else p->off_ms[p->mode] += spent;
+  p->last_account = now;
+}
+
+uint8_t power_profile_update(power_profile *p, uint32_t now, uint32_t *next_ms) {
+  account(p, now);
+  uint8_t ev = 0;
+
+  uint32_t quiet = now - p->last_detection;
+  if ((int32_t)quiet < 0) quiet = 0;   // detection stamped after our now
+  uint8_t mode = quiet < p->quiet_ms ? POWER_MODE_ACTIVE : POWER_MODE_SENTINEL;
+  if (mode != p->mode) {
+    p->mode = mode;
+    p->mode_since = now;
+    p->switches++;
+    ev |= POWER_EV_MODE;
+  }
+
+  bool on;
+  uint32_t next;
+  if (mode == POWER_MODE_ACTIVE) {
+    on = true;
+    next = p->quiet_ms - quiet;
+  } else {
+    // Bursts are phased from the mode switch, so the first one starts at once
+    uint32_t phase = (now - p->mode_since) % p->period_ms;
+    on = phase < p->burst_ms;
+    next = on ? p->burst_ms - phase : p->period_ms - phase;
+  }
+  if (on != p->radios_on) {
+    p->radios_on = on;
+    if (on) p->bursts++;
+    ev |= POWER_EV_RADIOS;
+  }
+  *next_ms = next ? next : 1;
+  return ev;
+}
+
+// Estimated average draw over on/off time, mA
+static uint32_t average_ma(const power_profile *p, uint64_t on, uint64_t off) {
+  uint64_t total = on + off;
+  if (total == 0) return 0;
+  return (uint32_t)((on * p->ma_on + off * p->ma_off + total / 2) / total);
+}
+
+int power_profile_format_json(power_profile *p, char *buf, size_t size, uint32_t now) {
+  account(p, now);
+  uint64_t on = 0, off = 0;
+  for (int m = 0; m < POWER_MODES; m++) {
+    on += p->on_ms[m];
+    off += p->off_ms[m];
+  }
+  // mA*ms -> tenths of mAh
+  uint64_t mah10 = (on * p->ma_on + off * p->ma_off) / 360000;
+  uint64_t sentinel = p->on_ms[POWER_MODE_SENTINEL] + p->off_ms[POWER_MODE_SENTINEL];
+  uint32_t duty = sentinel ? (uint32_t)(p->on_ms[POWER_MODE_SENTINEL] * 100 / sentinel) : 0;
+
+  return snprintf(buf, size,
+                  "\"power\":{\"mode\":\"%s\",\"radios\":\"%s\",\"light_sleep\":%s,"
+                  "\"switches\":%u,\"bursts\":%u,"
+                  "\"active\":{\"time_s\":%u,\"est_ma\":%u},"
+                  "\"sentinel\":{\"time_s\":%u,\"duty_pct\":%u,\"est_ma\":%u},"
+                  "\"est_avg_ma\":%u,\"est_mah\":%u.%u}",
+                  mode_names[p->mode], p->radios_on ? "on" : "off",
+                  p->light_sleep ? "true" : "false", (unsigned)p->switches,
+                  (unsigned)p->bursts,
+                  (unsigned)((p->on_ms[POWER_MODE_ACTIVE] + p->off_ms[POWER_MODE_ACTIVE]) / 1000),
+                  (unsigned)average_ma(p, p->on_ms[POWER_MODE_ACTIVE], p->off_ms[POWER_MODE_ACTIVE]),
+                  (unsigned)(sentinel / 1000), (unsigned)duty,
+                  (unsigned)average_ma(p, p->on_ms[POWER_MODE_SENTINEL],
+                                       p->off_ms[POWER_MODE_SENTINEL]),
+                  (unsigned)average_ma(p, on, off), (unsigned)(mah10 / 10),
+                  (unsigned)(mah10 % 10));
+}
@@ -0,0 +1,72 @@
+/*
+ * power_profile.h - Adaptive radio duty cycle for solar/battery nodes.
+ *
+ * ACTIVE keeps WiFi promiscuous capture and the BLE scan running
+ * continuously, as the mains-powered firmwares do. Once no detection has
+ * been output for quiet_ms the node drops to SENTINEL: the radios listen
+ * for burst_ms out of every period_ms and are stopped in between, so the
+ * CPU can sit in light sleep. The first detection in a burst puts the node
+ * straight back into ACTIVE.
+ *
+ * Draw is not measured. It is estimated from the per-state currents
+ * passed to init times the time spent in each state, split by mode, and
+ * reported as est_* next to those times. The estimate is only as good as
+ * the currents the firmware was built with.
+ *
+ * The printer task calls power_profile_detection(); everything else runs
+ * from one task (the Arduino loop).
+ */
+
+#ifndef _POWER_PROFILE_H_
+#define _POWER_PROFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum power_mode {
+  POWER_MODE_ACTIVE = 0,
+  POWER_MODE_SENTINEL,
+  POWER_MODES
+};
+
+// power_profile_update() results
+#define POWER_EV_MODE    0x01   // mode changed
+#define POWER_EV_RADIOS  0x02   // radios_on changed, apply it
+
+struct power_profile {
+  uint8_t  mode;                // power_mode
+  bool     radios_on;
+  bool     light_sleep;         // set by the firmware when auto light sleep is on
+  uint16_t burst_ms;
+  uint16_t period_ms;
+  uint16_t ma_on;               // assumed draw with both radios listening
+  uint16_t ma_off;              // assumed draw with the radios stopped
+  uint32_t quiet_ms;
+  volatile uint32_t last_detection;   // written by the printer task
+  uint32_t mode_since;          // millis() the current mode was entered
+  uint32_t last_account;
+  uint32_t switches;
+  uint32_t bursts;
+  uint64_t on_ms[POWER_MODES];  // radios listening, per mode
+  uint64_t off_ms[POWER_MODES];
+};
+
+// Starts in ACTIVE with the radios on, as if a drone was seen at now.
+void power_profile_init(power_profile *p, uint32_t quiet_ms, uint16_t burst_ms,
+                        uint16_t period_ms, uint16_t ma_on, uint16_t ma_off, uint32_t now);
+
+// A detection was output. Returns true when the node is in SENTINEL and
+// the caller should wake the task running power_profile_update().
+bool power_profile_detection(power_profile *p, uint32_t now);
+
+// Advance the mode and the sentinel burst schedule. Returns POWER_EV_*
+// bits; *next_ms is how long until the next call is due.
+uint8_t power_profile_update(power_profile *p, uint32_t now, uint32_t *next_ms);
+
+// "power":{"mode":..,"radios":..,"light_sleep":..,"switches":..,"bursts":..,
+//  "active":{"time_s":..,"est_ma":..},"sentinel":{"time_s":..,"duty_pct":..,
+//  "est_ma":..},"est_avg_ma":..,"est_mah":..} (no enclosing braces). Returns
+// the snprintf length.
+int power_profile_format_json(power_profile *p, char *buf, size_t size, uint32_t now);
+
+#endif // _POWER_PROFILE_H_
@@ -0,0 +1,235 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rssi_fusion.h"
+#include "detection_json.h"
+
+// Metres per 1e-7 degree of latitude; longitude scales by cos(latitude)
+#define M_PER_E7_LAT 0.011132f
+
+void rssi_fusion_init(rssi_fusion *f, float rssi_1m, float path_loss_n,
+                      uint32_t window_ms, uint32_t max_age_ms) {
+  memset(f, 0, sizeof(*f));
+  f->rssi_1m = rssi_1m;
+  f->path_loss_n = path_loss_n > 0.5f ? path_loss_n : 2.0f;
+  f->window_ms = window_ms;
+  f->max_age_ms = max_age_ms;
+  f->m_per_e7_lat = M_PER_E7_LAT;
+  f->m_per_e7_long = M_PER_E7_LAT;
+}
+
+bool rssi_fusion_add_node(rssi_fusion *f, uint16_t node_id, int32_t lat_e7, int32_t long_e7) {
+  if (f->node_count >= FUSION_MAX_NODES) return false;
+  if (f->node_count == 0) {
+    f->m_per_e7_long = M_PER_E7_LAT * cosf((float)lat_e7 * 1e-7f * (float)M_PI / 180.0f);
+  }
+  fusion_node *n = &f->nodes[f->node_count++];
+  n->id = node_id;
+  n->lat_e7 = lat_e7;
+  n->long_e7 = long_e7;
+  n->x_m = (float)(long_e7 - f->nodes[0].long_e7) * f->m_per_e7_long;
+  n->y_m = (float)(lat_e7 - f->nodes[0].lat_e7) * f->m_per_e7_lat;
+  return true;
+}
+
+int rssi_fusion_parse_nodes(rssi_fusion *f, const char *spec) {
+  int added = 0;
+  const char *p = spec;
+  while (p && *p) {
+    char *end;
+    unsigned long id = strtoul(p, &end, 16);
+    if (end == p || *end != '=' || id > 0xFFFF) break;
+    double lat = strtod(end + 1, &end);
+    if (*end != ',') break;
+    double lon = strtod(end + 1, &end);
+    if (*end != ';' && *end != '\0') break;
+    if (lat < -90 || lat > 90 || lon < -180 || lon > 180) break;
+    if (!rssi_fusion_add_node(f, (uint16_t)id, (int32_t)lround(lat * 1e7),
+                              (int32_t)lround(lon * 1e7)))
+      break;
+    added++;
+    p = *end ? end + 1 : end;
+  }
+  return added;
+}
+
+static int find_node(const rssi_fusion *f, uint16_t node_id) {
+  for (int i = 0; i < f->node_count; i++)
+    if (f->nodes[i].id == node_id) return i;
+  return -1;
+}
+
+static fusion_slot *find_slot(rssi_fusion *f, const uint8_t *mac) {
+  for (int i = 0; i < FUSION_SLOTS; i++)
+    if (f->slots[i].used && memcmp(f->slots[i].mac, mac, 6) == 0) return &f->slots[i];
+  return nullptr;
+}
+
+// Free slot, else the one whose latest activity is oldest
+static fusion_slot *take_slot(rssi_fusion *f, const uint8_t *mac, uint32_t now) {
+  fusion_slot *victim = nullptr;
+  uint32_t oldest = 0;
+  for (int i = 0; i < FUSION_SLOTS; i++) {
+    fusion_slot *s = &f->slots[i];
+    if (!s->used) {
+      victim = s;
+      break;
+    }
+    uint32_t last = s->window_start ? s->window_start : s->estimate_ms;
+    if (!victim || now - last > oldest) {
+      victim = s;
+      oldest = now - last;
+    }
+  }
+  if (victim->used) f->slot_reuse++;
+  memset(victim, 0, sizeof(*victim));
+  victim->used = true;
+  memcpy(victim->mac, mac, 6);
+  return victim;
+}
+
+// Range from mean RSSI: rssi = rssi_1m - 10 n log10(d)
+static float range_m(const rssi_fusion *f, const fusion_report *r) {
+  float rssi = (float)r->rssi_sum / (float)r->count;
+  float d = powf(10.0f, (f->rssi_1m - rssi) / (10.0f * f->path_loss_n));
+  if (d < 1.0f) d = 1.0f;
+  if (d > FUSION_MAX_RANGE_M) d = FUSION_MAX_RANGE_M;
+  return d;
+}
+
+static void solve(rssi_fusion *f, fusion_slot *s, uint32_t now) {
+  int k = s->nreports;
+  s->window_start = 0;
+  s->nreports = 0;
+  if (k < 2) {
+    f->single_node++;
+    return;
+  }
+
+  float d[FUSION_MAX_REPORTS];
+  int ref = 0;
+  for (int i = 0; i < k; i++) {
+    d[i] = range_m(f, &s->reports[i]);
+    if (d[i] < d[ref]) ref = i;
+  }
+  const fusion_node *r = &f->nodes[s->reports[ref].node];
+
+  float x, y;
+  bool ok = false;
+  if (k >= 3) {
+    // Subtracting the nearest node's circle from each other one gives a
+    // line 2(xi-xr)x + 2(yi-yr)y = dr^2 - di^2 + |pi|^2 - |pr|^2. Working
+    // relative to pr keeps |pr| = 0; rows are weighted by 1/di.
+    float a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+    for (int i = 0; i < k; i++) {
+      if (i == ref) continue;
+      const fusion_node *n = &f->nodes[s->reports[i].node];
+      float ax = 2.0f * (n->x_m - r->x_m), ay = 2.0f * (n->y_m - r->y_m);
+      float px = n->x_m - r->x_m, py = n->y_m - r->y_m;
+      float b = d[ref] * d[ref] - d[i] * d[i] + px * px + py * py;
+      float w = 1.0f / d[i];
+      a11 += w * ax * ax;
+      a12 += w * ax * ay;
+      a22 += w * ay * ay;
+      b1 += w * ax * b;
+      b2 += w * ay * b;
+    }
+    float det = a11 * a22 - a12 * a12;
+    // Near-collinear nodes leave the cross-track position undetermined
+    if (fabsf(det) > 1e-6f * (a11 * a22 + 1.0f)) {
+      x = r->x_m + (a22 * b1 - a12 * b2) / det;
+      y = r->y_m + (a11 * b2 - a12 * b1) / det;
+      ok = true;
+    }
+  }
+  if (!ok) {
+    // Weighted centroid, 1/d^2; for two nodes the point splitting the
+    // baseline by range ratio
+    float sw = 0, sx = 0, sy = 0;
+    for (int i = 0; i < k; i++) {
+      const fusion_node *n = &f->nodes[s->reports[i].node];
+      float w = (k == 2) ? d[1 - i] : 1.0f / (d[i] * d[i]);
+      sw += w;
+      sx += w * n->x_m;
+      sy += w * n->y_m;
+    }
+    x = sx / sw;
+    y = sy / sw;
+  }
+
+  float err = 0;
+  for (int i = 0; i < k; i++) {
+    const fusion_node *n = &f->nodes[s->reports[i].node];
+    float e = hypotf(x - n->x_m, y - n->y_m) - d[i];
+    err += e * e;
+  }
+  err = sqrtf(err / (float)k);
+
+  s->est_lat_e7 = f->nodes[0].lat_e7 + (int32_t)lroundf(y / f->m_per_e7_lat);
+  s->est_long_e7 = f->nodes[0].long_e7 + (int32_t)lroundf(x / f->m_per_e7_long);
+  s->est_err_m = err > 65535.0f ? 65535 : (uint16_t)err;
+  s->est_nodes = (uint8_t)k;
+  s->estimate_ms = now ? now : 1;
+  f->solved++;
+}
+
+void rssi_fusion_sample(rssi_fusion *f, const uint8_t *mac, uint16_t node_id, int rssi,
+                        uint32_t now) {
+  int node = find_node(f, node_id);
+  if (node < 0) {
+    f->unknown_node++;
+    return;
+  }
+  f->samples++;
+
+  fusion_slot *s = find_slot(f, mac);
+  if (!s) s = take_slot(f, mac, now);
+  if (s->window_start && now - s->window_start >= f->window_ms) solve(f, s, now);
+  if (!s->window_start) s->window_start = now ? now : 1;
+
+  if (rssi < -127) rssi = -127;
+  if (rssi > 0) rssi = 0;
+  for (int i = 0; i < s->nreports; i++) {
+    fusion_report *r = &s->reports[i];
+    if (r->node != node) continue;
+    if (r->count < 255) {   // 255 x -127 still fits rssi_sum
+      r->rssi_sum += (int16_t)rssi;
+      r->count++;
+    }
+    return;
+  }
+  if (s->nreports == FUSION_MAX_REPORTS) return;
+  fusion_report *r = &s->reports[s->nreports++];
+  r->node = (uint8_t)node;
+  r->count = 1;
+  r->rssi_sum = (int16_t)rssi;
+}
+
+void rssi_fusion_tick(rssi_fusion *f, uint32_t now) {
+  for (int i = 0; i < FUSION_SLOTS; i++) {
+    fusion_slot *s = &f->slots[i];
+    if (s->used && s->window_start && now - s->window_start >= f->window_ms) solve(f, s, now);
+  }
+}
+
+const fusion_slot *rssi_fusion_estimate(const rssi_fusion *f, const uint8_t *mac,
+                                        uint32_t now) {
+  for (int i = 0; i < FUSION_SLOTS; i++) {
+    const fusion_slot *s = &f->slots[i];
+    if (!s->used || memcmp(s->mac, mac, 6) != 0) continue;
+    if (s->estimate_ms == 0 || now - s->estimate_ms > f->max_age_ms) return nullptr;
+    return s;
+  }
+  return nullptr;
+}
+
+int rssi_fusion_format(const fusion_slot *s, char *buf, size_t size) {
+  char lat[16], lon[16];
+  format_coord(lat, sizeof(lat), s->est_lat_e7);
+  format_coord(lon, sizeof(lon), s->est_long_e7);
+  return snprintf(buf, size,
+                  ",\"estimated_lat\":%s,\"estimated_long\":%s,\"estimate_nodes\":%u,"
+                  "\"estimate_err_m\":%u",
+                  lat, lon, (unsigned)s->est_nodes, (unsigned)s->est_err_m);
+}
@@ -0,0 +1,108 @@
+/*
+ * rssi_fusion.h - Home node position estimate from multi-node RSSI.
+ *
+ * Every remote node's copy of a detection carries its node_id and RSSI.
+ * For each drone MAC the copies arriving within window_ms are folded into
+ * one running mean per node (O(1) per copy after a scan of the nodes
+ * already heard). When the window closes the means become ranges through
+ * a log-distance path loss model and the position is solved by weighted
+ * linear least squares around the nearest node. That is one 2x2 system
+ * accumulated in a single pass over the nodes, so the cost is linear in
+ * the number of nodes that reported. Two nodes give the point between them
+ * split by range ratio; one node gives nothing.
+ *
+ * Node positions are fixed at boot (rssi_fusion_parse_nodes()) and kept
+ * in metres east/north of the first node, so the solve runs in single
+ * precision float on a local plane. Over the tens of km a mesh covers
+ * that costs a few metres, far below the error of RSSI ranging.
+ *
+ * Single-threaded: the home node only touches it from loop().
+ */
+
+#ifndef _RSSI_FUSION_H_
+#define _RSSI_FUSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FUSION_MAX_NODES
+#define FUSION_MAX_NODES    16      // remote nodes with known positions
+#endif
+#ifndef FUSION_SLOTS
+#define FUSION_SLOTS        32      // drones fused at once
+#endif
+#define FUSION_MAX_REPORTS  8       // distinct nodes per drone per window
+#define FUSION_MAX_RANGE_M  5000.0f // clamp for the path loss model
+
+struct fusion_node {
+  uint16_t id;                  // node_id as sent, "A1B2" = 0xA1B2
+  int32_t  lat_e7;
+  int32_t  long_e7;
+  float    x_m;                 // east of node 0
+  float    y_m;                 // north of node 0
+};
+
+struct fusion_report {
+  uint8_t node;                 // index into nodes[]
+  uint8_t count;
+  int16_t rssi_sum;             // dBm
+};
+
+struct fusion_slot {
+  bool          used;
+  uint8_t       mac[6];
+  uint32_t      window_start;   // first copy of the open window, 0 = none open
+  uint8_t       nreports;
+  fusion_report reports[FUSION_MAX_REPORTS];
+  // Latest solved window
+  uint32_t      estimate_ms;    // millis() of the solve, 0 = never
+  int32_t       est_lat_e7;
+  int32_t       est_long_e7;
+  uint16_t      est_err_m;      // RMS range residual
+  uint8_t       est_nodes;
+};
+
+struct rssi_fusion {
+  fusion_node nodes[FUSION_MAX_NODES];
+  uint8_t     node_count;
+  float       m_per_e7_lat;     // local plane scale at node 0
+  float       m_per_e7_long;
+  float       rssi_1m;          // dBm at 1 m
+  float       path_loss_n;      // exponent, 2 = free space
+  uint32_t    window_ms;
+  uint32_t    max_age_ms;       // estimate attached to output this long
+  fusion_slot slots[FUSION_SLOTS];
+  // Stats
+  uint32_t    samples;
+  uint32_t    unknown_node;     // copies from nodes without a position
+  uint32_t    solved;
+  uint32_t    single_node;      // windows closed with one node only
+  uint32_t    slot_reuse;       // slots taken from another drone
+};
+
+void rssi_fusion_init(rssi_fusion *f, float rssi_1m, float path_loss_n,
+                      uint32_t window_ms, uint32_t max_age_ms);
+
+// Returns false when the node table is full.
+bool rssi_fusion_add_node(rssi_fusion *f, uint16_t node_id, int32_t lat_e7, int32_t long_e7);
+
+// "A1B2=51.501234,-0.120001;C3D4=..." -> nodes added; stops at the first
+// malformed entry.
+int rssi_fusion_parse_nodes(rssi_fusion *f, const char *spec);
+
+// One copy of a detection: node_id heard mac at rssi dBm.
+void rssi_fusion_sample(rssi_fusion *f, const uint8_t *mac, uint16_t node_id, int rssi,
+                        uint32_t now);
+
+// Close and solve the windows older than window_ms.
+void rssi_fusion_tick(rssi_fusion *f, uint32_t now);
+
+// Slot with an estimate younger than max_age_ms for mac, or nullptr.
+const fusion_slot *rssi_fusion_estimate(const rssi_fusion *f, const uint8_t *mac,
+                                        uint32_t now);
+
+// ,"estimated_lat":..,"estimated_long":..,"estimate_nodes":..,"estimate_err_m":..
+// Returns the snprintf length.
+int rssi_fusion_format(const fusion_slot *s, char *buf, size_t size);
+
+#endif // _RSSI_FUSION_H_
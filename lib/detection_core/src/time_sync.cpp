@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "time_sync.h"
+
+static inline int32_t wrap_hour(int32_t ds) {
+  ds %= TIME_SYNC_HOUR_DS;
+  return ds < 0 ? ds + TIME_SYNC_HOUR_DS : ds;
+}
+
+static inline int32_t local_ds(uint32_t ms) {
+  return (int32_t)((ms / 100) % TIME_SYNC_HOUR_DS);
+}
+
+void time_sync_init(time_sync *ts) {
+  memset(ts, 0, sizeof(*ts));
+}
+
+// Largest group of window samples within TIME_SYNC_OUTLIER_DS of one
+// another's pivot; *best gets its furthest-ahead member. Returns its size.
+static int best_group(const time_sync *ts, int32_t *best) {
+  int n = ts->window_samples < TIME_SYNC_WINDOW_SAMPLES ? ts->window_samples
+                                                         : TIME_SYNC_WINDOW_SAMPLES;
+  int top = 0;
+  for (int i = 0; i < n; i++) {
+    int count = 0;
+    int32_t ahead = ts->window[i];
+    for (int j = 0; j < n; j++) {
+      int32_t d = time_sync_diff_ds((uint16_t)ts->window[j], (uint16_t)ts->window[i]);
+      if (abs(d) > TIME_SYNC_OUTLIER_DS) continue;
+      count++;
+      if (time_sync_diff_ds((uint16_t)ts->window[j], (uint16_t)ahead) > 0) ahead = ts->window[j];
+    }
+    if (count > top) {
+      top = count;
+      *best = ahead;
+    }
+  }
+  return top;
+}
+
+void time_sync_sample(time_sync *ts, uint16_t utc_ds, uint32_t now) {
+  if (utc_ds >= TIME_SYNC_HOUR_DS) return;
+  if (ts->locked && now - ts->synced_ms >= TIME_SYNC_HOLD_MS) {
+    ts->locked = false;
+    ts->window_samples = 0;
+  }
+  int32_t s = wrap_hour((int32_t)utc_ds - local_ds(now));
+  ts->samples++;
+
+  if (ts->locked && abs(time_sync_diff_ds((uint16_t)s, (uint16_t)ts->offset_ds)) >
+                        TIME_SYNC_OUTLIER_DS) {
+    ts->outliers++;
+    if (++ts->outlier_run >= TIME_SYNC_RELOCK) {
+      // Our clock jumped (millis() wrap) or the drones we trusted were wrong
+      ts->locked = false;
+      ts->outlier_run = 0;
+      ts->window_samples = 0;
+    }
+    return;
+  }
+  ts->outlier_run = 0;
+
+  if (ts->window_samples == 0) ts->window_start = now;
+  ts->window[ts->window_samples % TIME_SYNC_WINDOW_SAMPLES] = (int16_t)s;
+  if (ts->window_samples < UINT16_MAX) ts->window_samples++;
+
+  // A first lock only waits for a few Location updates
+  uint32_t window = ts->locked ? TIME_SYNC_WINDOW_MS : TIME_SYNC_WINDOW_MS / 8;
+  if (now - ts->window_start < window || ts->window_samples < TIME_SYNC_MIN_SAMPLES) return;
+  int32_t best;
+  if (best_group(ts, &best) >= TIME_SYNC_MIN_SAMPLES) {
+    if (!ts->locked) ts->locks++;
+    ts->offset_ds = best;
+    ts->locked = true;
+    ts->synced_ms = now;
+  }
+  ts->window_samples = 0;
+}
+
+uint16_t time_sync_ds(const time_sync *ts, uint32_t ms) {
+  if (!ts->locked || (int32_t)(ms - ts->synced_ms) >= (int32_t)TIME_SYNC_HOLD_MS)
+    return TIME_SYNC_NONE;
+  return (uint16_t)wrap_hour(local_ds(ms) + ts->offset_ds);
+}
+
+int time_sync_format_json(const time_sync *ts, char *buf, size_t size, uint32_t now) {
+  uint16_t utc = time_sync_ds(ts, now);
+  char utc_str[8];
+  if (utc == TIME_SYNC_NONE) snprintf(utc_str, sizeof(utc_str), "null");
+  else snprintf(utc_str, sizeof(utc_str), "%u", (unsigned)utc);
+  return snprintf(buf, size,
+                  "\"time_sync\":{\"locked\":%s,\"utc_ds\":%s,\"samples\":%u,"
+                  "\"outliers\":%u,\"locks\":%u}",
+                  utc == TIME_SYNC_NONE ? "false" : "true", utc_str,
+                  (unsigned)ts->samples, (unsigned)ts->outliers, (unsigned)ts->locks);
+}
@@ -0,0 +1,90 @@
+/*
+ * time_sync.h - Node clock synced to UTC from ODID Location timestamps.
+ *
+ * millis() means nothing on another node, so copies of one drone that
+ * reach the home node over different relay paths cannot be ordered. Every
+ * ODID Location message carries the drone's GNSS time, in tenths of a
+ * second after the UTC hour, so each one a node hears is a sample of
+ * UTC - millis(). No GPS or network is needed on the node.
+ *
+ * Reception always comes after the fix and drones repeat a fix between
+ * updates, so samples only ever run behind the true offset. Each window
+ * of TIME_SYNC_WINDOW_MS keeps its latest TIME_SYNC_WINDOW_SAMPLES; at
+ * the close the largest group agreeing to within TIME_SYNC_OUTLIER_DS
+ * wins, so a drone with a bad clock or a spoofer is outvoted, and the
+ * offset is that group's sample running furthest ahead (NTP's
+ * minimum-delay idea). Re-taking it every window follows crystal drift.
+ * Once locked, samples further than TIME_SYNC_OUTLIER_DS off are ignored;
+ * a run of TIME_SYNC_RELOCK of them starts over, as does
+ * TIME_SYNC_HOLD_MS without any window closing.
+ *
+ * Timestamps are mod one hour: enough to order copies that are minutes
+ * apart at most. Compare them with time_sync_diff_ds().
+ *
+ * No lock of its own: uav_tracker_store() feeds and reads it under the
+ * tracker lock; the heartbeats only print its counters.
+ */
+
+#ifndef _TIME_SYNC_H_
+#define _TIME_SYNC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIME_SYNC_HOUR_DS   36000       // deciseconds per hour
+#define TIME_SYNC_NONE      0xFFFF      // no synced time
+
+#ifndef TIME_SYNC_WINDOW_MS
+#define TIME_SYNC_WINDOW_MS  60000
+#endif
+#ifndef TIME_SYNC_MIN_SAMPLES
+#define TIME_SYNC_MIN_SAMPLES 3         // agreeing, per window
+#endif
+#define TIME_SYNC_WINDOW_SAMPLES 32
+#ifndef TIME_SYNC_OUTLIER_DS
+#define TIME_SYNC_OUTLIER_DS 50
+#endif
+#ifndef TIME_SYNC_RELOCK
+#define TIME_SYNC_RELOCK     16
+#endif
+#ifndef TIME_SYNC_HOLD_MS
+#define TIME_SYNC_HOLD_MS    (6UL * 3600 * 1000)   // ~0.4 s of 20 ppm drift
+#endif
+
+struct time_sync {
+  bool     locked;
+  int32_t  offset_ds;        // UTC ds after the hour - millis() / 100, mod hour
+  uint32_t synced_ms;        // millis() the offset was last taken
+  uint32_t window_start;
+  int16_t  window[TIME_SYNC_WINDOW_SAMPLES];   // offsets, ring of the latest
+  uint16_t window_samples;   // taken this window, may exceed the ring
+  uint16_t outlier_run;
+  // Stats
+  uint32_t samples;
+  uint32_t outliers;
+  uint32_t locks;            // times the offset was taken from scratch
+};
+
+void time_sync_init(time_sync *ts);
+
+// One ODID Location TimeStamp (deciseconds after the hour) heard at now.
+// Values past the hour (no value, 0xFFFF) are ignored.
+void time_sync_sample(time_sync *ts, uint16_t utc_ds, uint32_t now);
+
+// UTC deciseconds after the hour at millis() ms, TIME_SYNC_NONE when not
+// locked.
+uint16_t time_sync_ds(const time_sync *ts, uint32_t ms);
+
+// a - b in deciseconds, wrapped into -18000..17999
+static inline int32_t time_sync_diff_ds(uint16_t a, uint16_t b) {
+  int32_t d = ((int32_t)a - (int32_t)b) % TIME_SYNC_HOUR_DS;
+  if (d >= TIME_SYNC_HOUR_DS / 2) d -= TIME_SYNC_HOUR_DS;
+  if (d < -TIME_SYNC_HOUR_DS / 2) d += TIME_SYNC_HOUR_DS;
+  return d;
+}
+
+// "time_sync":{"locked":..,"utc_ds":..,"samples":..,"outliers":..,"locks":..}
+// Returns the snprintf length.
+int time_sync_format_json(const time_sync *ts, char *buf, size_t size, uint32_t now);
+
+#endif // _TIME_SYNC_H_
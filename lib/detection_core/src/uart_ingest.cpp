@@ -0,0 +1,73 @@
+#include "uart_ingest.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+void uart_ingest_begin(uart_ingest *u, HardwareSerial &port, unsigned long baud,
+                       int rx_pin, int tx_pin, TaskHandle_t consumer) {
+  memset(u, 0, sizeof(*u));
+  u->port = &port;
+  u->consumer = consumer;
+
+  // Ring size and callbacks must be set before begin() installs the driver
+  port.setRxBufferSize(UART_INGEST_RX_BUFFER);
+  port.onReceive([u]() {
+    u->rx_event_us = micros();
+    if (u->consumer) xTaskNotifyGive(u->consumer);
+  }, false);
+  port.onReceiveError([u](hardwareSerial_error_t err) {
+    if (err == UART_FIFO_OVF_ERROR || err == UART_BUFFER_FULL_ERROR) u->overruns++;
+  });
+  port.begin(baud, SERIAL_8N1, rx_pin, tx_pin);
+  port.setRxTimeout(UART_INGEST_RX_TIMEOUT);
+}
+
+void uart_ingest_wait(uart_ingest *u, uint32_t timeout_ms) {
+  // Data that arrived before the consumer started has no pending event
+  if (u->port->available()) return;
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+}
+
+int uart_ingest_poll(uart_ingest *u, uart_line_cb cb) {
+  uint8_t chunk[128];
+  int lines = 0;
+  int n;
+  while ((n = u->port->available()) > 0) {
+    if (n > (int)sizeof(chunk)) n = sizeof(chunk);
+    n = u->port->read(chunk, n);
+    uint32_t event_us = u->rx_event_us;
+    u->bytes += n;
+
+    for (int i = 0; i < n; i++) {
+      char c = (char)chunk[i];
+      if (c == '\n' || c == '\r') {
+        if (u->pos > 0 && !u->discarding) {
+          u->line[u->pos] = '\0';
+          uint32_t latency = micros() - u->line_start_us;
+          if (latency > u->latency_max_us) u->latency_max_us = latency;
+          u->latency_sum_us += latency;
+          u->lines++;
+          lines++;
+          cb(u->line, u->pos);
+        }
+        u->pos = 0;
+        u->discarding = false;
+      } else if (u->discarding) {
+        continue;
+      } else if (u->pos < UART_INGEST_LINE_MAX - 1) {
+        if (u->pos == 0) u->line_start_us = event_us;
+        u->line[u->pos++] = c;
+      } else {
+        // Line too long - drop it up to the next newline
+        u->overlong++;
+        u->discarding = true;
+      }
+    }
+  }
+  return lines;
+}
+
+uint32_t uart_ingest_latency_avg_us(const uart_ingest *u) {
+  return u->lines ? (uint32_t)(u->latency_sum_us / u->lines) : 0;
+}
+
+#endif // ARDUINO_ARCH_ESP32
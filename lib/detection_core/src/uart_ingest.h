@@ -0,0 +1,71 @@
+/*
+ * uart_ingest.h - Event-driven line reader for the Heltec UART link.
+ *
+ * The UART driver's RX event (FIFO threshold or a short idle timeout
+ * after the last byte, i.e. right after each burst) notifies the
+ * consuming task, which blocks until then instead of polling. The
+ * driver's RX ring is sized for a burst of full mesh lines so nothing is
+ * lost while the consumer is busy.
+ *
+ * Line latency is measured from the RX event that delivered a line's
+ * first byte to the moment the complete line is handed on; overruns are
+ * the driver's FIFO-overflow and ring-full error events.
+ */
+
+#ifndef _UART_INGEST_H_
+#define _UART_INGEST_H_
+
+// Needs the Arduino UART driver; compiled out of host (native) builds
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifndef UART_INGEST_LINE_MAX
+#define UART_INGEST_LINE_MAX   512      // Max line length from Heltec
+#endif
+#ifndef UART_INGEST_RX_BUFFER
+#define UART_INGEST_RX_BUFFER  4096     // Driver RX ring, ~8 full lines
+#endif
+// Idle time (in symbols, ~87us each at 115200) before the RX event fires
+#define UART_INGEST_RX_TIMEOUT 2
+
+typedef void (*uart_line_cb)(const char *line, int len);
+
+struct uart_ingest {
+  HardwareSerial   *port;
+  TaskHandle_t      consumer;        // task woken on RX events
+  volatile uint32_t rx_event_us;     // micros() of the latest RX event
+  char              line[UART_INGEST_LINE_MAX];
+  int               pos;
+  uint32_t          line_start_us;   // RX event that brought the line's first byte
+  bool              discarding;      // rest of an overlong line
+  // Stats
+  uint32_t          bytes;
+  uint32_t          lines;
+  uint32_t          overlong;        // lines dropped for exceeding LINE_MAX
+  volatile uint32_t overruns;        // FIFO overflow / RX ring full events
+  uint32_t          latency_max_us;
+  uint64_t          latency_sum_us;
+};
+
+// Sets up the port (RX ring, RX timeout, event callbacks) and begins it.
+// consumer is the task that calls uart_ingest_wait/poll.
+void uart_ingest_begin(uart_ingest *u, HardwareSerial &port, unsigned long baud,
+                       int rx_pin, int tx_pin, TaskHandle_t consumer);
+
+// Blocks the consumer until an RX event or timeout_ms passes.
+void uart_ingest_wait(uart_ingest *u, uint32_t timeout_ms);
+
+// Drains the RX ring, calling cb for each complete non-empty line
+// (NUL-terminated, CR/LF stripped). Returns the number of lines.
+int uart_ingest_poll(uart_ingest *u, uart_line_cb cb);
+
+// Mean line latency in microseconds
+uint32_t uart_ingest_latency_avg_us(const uart_ingest *u);
+
+#endif // ARDUINO_ARCH_ESP32
+
+#endif // _UART_INGEST_H_
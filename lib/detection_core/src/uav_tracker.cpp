@@ -0,0 +1,336 @@
+#include <string.h>
+#include "uav_tracker.h"
+#include "detection_json.h"
+#include "plausibility.h"
+
+// Fibonacci hash over the MAC; the low (NIC) bytes carry most entropy
+static inline uint32_t uav_hash(const uint8_t *mac) {
+  uint32_t h = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+                (uint32_t)mac[4] << 8  | mac[5]) ^
+               ((uint32_t)mac[0] << 8 | mac[1]);
+  return (h * 2654435769u) & UAV_INDEX_MASK;
+}
+
+// Index position holding mac, or the empty position where it would go
+static uint32_t index_probe(const uav_tracker *t, const uint8_t *mac) {
+  uint32_t i = uav_hash(mac);
+  while (t->index[i] != 0 &&
+         memcmp(t->uavs[t->index[i] - 1].mac, mac, 6) != 0)
+    i = (i + 1) & UAV_INDEX_MASK;
+  return i;
+}
+
+// Backward-shift delete so probe chains never need tombstones
+static void index_remove(uav_tracker *t, uint32_t hole) {
+  uint32_t j = hole;
+  for (;;) {
+    j = (j + 1) & UAV_INDEX_MASK;
+    uint16_t r = t->index[j];
+    if (r == 0) break;
+    uint32_t home = uav_hash(t->uavs[r - 1].mac);
+    // Entry stays put if its home lies cyclically in (hole, j]
+    if (((j - home) & UAV_INDEX_MASK) < ((j - hole) & UAV_INDEX_MASK)) continue;
+    t->index[hole] = r;
+    hole = j;
+  }
+  t->index[hole] = 0;
+}
+
+static void lru_unlink(uav_tracker *t, uint16_t n) {
+  uint16_t p = t->lru_prev[n], x = t->lru_next[n];
+  if (p != UAV_NIL) t->lru_next[p] = x; else t->lru_head = x;
+  if (x != UAV_NIL) t->lru_prev[x] = p; else t->lru_tail = p;
+}
+
+static void lru_push_front(uav_tracker *t, uint16_t n) {
+  t->lru_prev[n] = UAV_NIL;
+  t->lru_next[n] = t->lru_head;
+  if (t->lru_head != UAV_NIL) t->lru_prev[t->lru_head] = n;
+  t->lru_head = n;
+  if (t->lru_tail == UAV_NIL) t->lru_tail = n;
+}
+
+// Take an evicted drone's pending update out of the dirty FIFO, so the
+// slot's next owner starts clean (and gets its own capture_us)
+static void dirty_remove(uav_tracker *t, uint16_t n) {
+  uint16_t kept = 0;
+  for (uint16_t i = 0; i < t->dirty_count; i++) {
+    uint16_t m = t->dirty_fifo[(t->dirty_head + i) & (UAV_TABLE_CAPACITY - 1)];
+    if (m != n) t->dirty_fifo[(t->dirty_head + kept++) & (UAV_TABLE_CAPACITY - 1)] = m;
+  }
+  t->dirty_count = kept;
+  t->dirty[n] = false;
+  t->dirty_evicted++;
+}
+
+bool uav_tracker_init(uav_tracker *t) {
+  if (!t->uavs)
+    t->uavs = (id_data *)dc_calloc_large(sizeof(id_data) * UAV_TABLE_CAPACITY);
+  else
+    memset(t->uavs, 0, sizeof(id_data) * UAV_TABLE_CAPACITY);
+  if (!t->extras)
+    t->extras = (uav_extra *)dc_calloc_large(sizeof(uav_extra) * UAV_EXTRA_SLOTS);
+  else
+    memset(t->extras, 0, sizeof(uav_extra) * UAV_EXTRA_SLOTS);
+  memset(t->extra_owner, 0, sizeof(t->extra_owner));
+  t->extra_evictions = 0;
+  memset(t->index, 0, sizeof(t->index));
+  t->lru_head = t->lru_tail = UAV_NIL;
+  t->count = 0;
+  t->evictions = 0;
+  t->dirty_head = t->dirty_count = 0;
+  memset(t->dirty, 0, sizeof(t->dirty));
+  memset(t->print_after, 0, sizeof(t->print_after));
+  t->coalesced = 0;
+  t->dirty_evicted = 0;
+  t->suppress = PLAUS_SUPPRESS_MASK;
+  t->plaus_flagged = t->plaus_suppressed = 0;
+  dc_lock_init(&t->lock);
+  return t->uavs != nullptr && t->extras != nullptr;
+}
+
+id_data *uav_tracker_find(uav_tracker *t, const uint8_t *mac) {
+  uint16_t r = t->index[index_probe(t, mac)];
+  return r ? &t->uavs[r - 1] : nullptr;
+}
+
+id_data *next_uav(uav_tracker *t, const uint8_t *mac) {
+  uint32_t pos = index_probe(t, mac);
+  uint16_t n;
+  if (t->index[pos] != 0) {
+    n = t->index[pos] - 1;
+    if (t->lru_head != n) {
+      lru_unlink(t, n);
+      lru_push_front(t, n);
+    }
+    return &t->uavs[n];
+  }
+
+  if (t->count < UAV_TABLE_CAPACITY) {
+    n = t->count++;
+  } else {
+    // Pool full: recycle the least recently seen drone
+    n = t->lru_tail;
+    lru_unlink(t, n);
+    if (t->uavs[n].extra) t->extra_owner[t->uavs[n].extra - 1] = 0;
+    index_remove(t, index_probe(t, t->uavs[n].mac));
+    if (t->dirty[n]) dirty_remove(t, n);
+    t->print_after[n] = 0;
+    t->evictions++;
+    pos = index_probe(t, mac);  // removal may have shifted our slot
+  }
+
+  id_data *UAV = &t->uavs[n];
+  memset(UAV, 0, sizeof(*UAV));
+  memcpy(UAV->mac, mac, 6);
+  format_mac(UAV->mac_str, mac);
+  t->print_after[n] = dc_millis();  // new drone prints on its first update
+  t->index[pos] = n + 1;
+  lru_push_front(t, n);
+  return UAV;
+}
+
+void odid_apply(const odid_fields *f, id_data *UAV, uint32_t now) {
+  if (f->basic_id_valid & 1) {
+    memcpy(UAV->uav_id, f->uas_id, ODID_ID_SIZE);
+    UAV->id_type = f->basic_id_type[0];
+    UAV->basic_id_ms = now;
+  }
+  if (f->present & ODID_HAS(ODID_MESSAGETYPE_LOCATION)) {
+    UAV->lat_e7 = f->lat_e7;
+    UAV->long_e7 = f->long_e7;
+    UAV->altitude_msl = odid_half_m_to_int(f->alt_geo_h);
+    UAV->height_agl = odid_half_m_to_int(f->height_h);
+    UAV->speed = odid_speed_to_int(f->speed_q);
+    UAV->heading = f->direction;
+    UAV->location_ms = now;
+  }
+  if (f->present & ODID_HAS(ODID_MESSAGETYPE_SYSTEM)) {
+    UAV->base_lat_e7 = f->op_lat_e7;
+    UAV->base_long_e7 = f->op_long_e7;
+    UAV->system_ms = now;
+  }
+  if (f->present & ODID_HAS(ODID_MESSAGETYPE_OPERATOR_ID)) {
+    memcpy(UAV->op_id, f->operator_id, ODID_ID_SIZE);
+    UAV->operator_id_ms = now;
+  }
+}
+
+// Free slab slot, else the one updated least recently, for pool position n
+static uav_extra *take_extra(uav_tracker *t, uint16_t n, uint32_t now) {
+  int victim = -1;
+  uint32_t oldest = 0;
+  for (int i = 0; i < UAV_EXTRA_SLOTS; i++) {
+    if (t->extra_owner[i] == 0) {
+      victim = i;
+      break;
+    }
+    if (victim < 0 || now - t->extras[i].updated_ms > oldest) {
+      victim = i;
+      oldest = now - t->extras[i].updated_ms;
+    }
+  }
+  if (t->extra_owner[victim]) {
+    t->uavs[t->extra_owner[victim] - 1].extra = 0;
+    t->extra_evictions++;
+  }
+  memset(&t->extras[victim], 0, sizeof(uav_extra));
+  t->extra_owner[victim] = n + 1;
+  t->uavs[n].extra = (uint16_t)(victim + 1);
+  return &t->extras[victim];
+}
+
+// Copy the second Basic ID, Self ID and Auth pages of f into the drone's
+// slab slot straight from the frame. extra_dirty only when something
+// differs, so a drone repeating its Auth pages costs no output.
+static void extra_apply(uav_tracker *t, id_data *UAV, const odid_fields *f, uint32_t now) {
+  bool id2 = (f->basic_id_valid & 2) != 0;
+  bool self = (f->present & ODID_HAS(ODID_MESSAGETYPE_SELF_ID)) != 0;
+  if (!id2 && !self && !f->auth_pages) return;
+  uint16_t n = (uint16_t)(UAV - t->uavs);
+  uav_extra *x = UAV->extra ? &t->extras[UAV->extra - 1] : take_extra(t, n, now);
+  bool changed = false;
+
+  if (id2) {
+    const ODID_BasicID_encoded *m = f->basic_id_2;
+    if (x->id_type_2 != m->IDType || x->ua_type_2 != m->UAType ||
+        strncmp(x->uas_id_2, m->UASID, ODID_ID_SIZE) != 0) {
+      x->id_type_2 = m->IDType;
+      x->ua_type_2 = m->UAType;
+      strncpy(x->uas_id_2, m->UASID, ODID_ID_SIZE);
+      changed = true;
+    }
+  }
+  if (self) {
+    const ODID_SelfID_encoded *m = f->self_id;
+    if (x->self_id_type != m->DescType || strncmp(x->self_id, m->Desc, ODID_STR_SIZE) != 0) {
+      x->self_id_type = m->DescType;
+      strncpy(x->self_id, m->Desc, ODID_STR_SIZE);
+      changed = true;
+    }
+  }
+  for (uint32_t pages = f->auth_pages; pages; pages &= pages - 1) {
+    int page = __builtin_ctz(pages);
+    const ODID_Auth_encoded *m = f->auth[page];
+    if (m->page_zero.AuthType != x->auth_type) {
+      // A new signature: pages of the old one no longer belong with it
+      x->auth_type = m->page_zero.AuthType;
+      x->auth_pages = 0;
+    }
+    const uint8_t *data;
+    size_t off, len;
+    if (page == 0) {
+      data = m->page_zero.AuthData;
+      off = 0;
+      len = ODID_AUTH_PAGE_ZERO_DATA_SIZE;
+      if (x->auth_last_page != m->page_zero.LastPageIndex ||
+          x->auth_length != m->page_zero.Length || x->auth_timestamp != m->page_zero.Timestamp)
+        changed = true;
+      x->auth_last_page = m->page_zero.LastPageIndex;
+      x->auth_length = m->page_zero.Length;
+      x->auth_timestamp = m->page_zero.Timestamp;
+    } else {
+      data = m->page_non_zero.AuthData;
+      off = ODID_AUTH_PAGE_ZERO_DATA_SIZE + (page - 1) * ODID_AUTH_PAGE_NONZERO_DATA_SIZE;
+      len = ODID_AUTH_PAGE_NONZERO_DATA_SIZE;
+    }
+    if (!(x->auth_pages & (1u << page)) || memcmp(x->auth_data + off, data, len) != 0) {
+      memcpy(x->auth_data + off, data, len);
+      changed = true;
+    }
+    x->auth_pages |= (uint16_t)(1u << page);
+  }
+  x->updated_ms = now;
+  if (changed) UAV->extra_dirty = 1;
+}
+
+bool uav_tracker_store(uav_tracker *t, const uint8_t *mac, int rssi,
+                       uint8_t band, uint8_t channel, uint32_t capture_us,
+                       const odid_fields *f, id_data *out) {
+  uint32_t now = dc_millis();
+  bool wake = false;
+  dc_lock(&t->lock);
+  // Check before next_uav(): a dropped update from an unknown MAC must not
+  // take a slot, let alone evict a real drone for it
+  static const id_data fresh = {};
+  id_data *known = uav_tracker_find(t, mac);
+  uint8_t plaus = plaus_check(known ? known : &fresh, f, now);
+  if (plaus) {
+    t->plaus_flagged++;
+    if ((plaus & t->suppress & PLAUS_STATELESS) ||
+        ((plaus & t->suppress) && known && ++known->plaus_rejects < PLAUS_REJECT_RUN)) {
+      t->plaus_suppressed++;
+      dc_unlock(&t->lock);
+      if (out) out->flag = 0;
+      return false;
+    }
+  }
+  id_data *UAV = next_uav(t, mac);
+  UAV->plaus |= plaus;
+  UAV->plaus_rejects = 0;
+  UAV->rssi = rssi;
+  UAV->last_seen = now;
+  UAV->band = band;
+  UAV->channel = channel;
+  odid_apply(f, UAV, now);
+  extra_apply(t, UAV, f, now);
+  UAV->flag = 1;
+  if (t->clock) {
+    if (f->present & ODID_HAS(ODID_MESSAGETYPE_LOCATION))
+      time_sync_sample(t->clock, f->timestamp_ds, now);
+    UAV->utc_ds = time_sync_ds(t->clock, now);
+  } else {
+    UAV->utc_ds = TIME_SYNC_NONE;
+  }
+
+  uint16_t n = (uint16_t)(UAV - t->uavs);
+  if (t->dirty[n]) {
+    t->coalesced++;
+  } else {
+    wake = t->dirty_count == 0;
+    t->dirty[n] = true;
+    UAV->capture_us = capture_us;
+    t->dirty_fifo[(t->dirty_head + t->dirty_count) & (UAV_TABLE_CAPACITY - 1)] = n;
+    t->dirty_count++;
+  }
+  if (out) {
+    *out = *UAV;
+    UAV->plaus = 0;
+    UAV->extra_dirty = 0;
+  }
+  dc_unlock(&t->lock);
+  return wake;
+}
+
+bool uav_tracker_next_dirty(uav_tracker *t, uint32_t now, id_data *out) {
+  bool found = false;
+  dc_lock(&t->lock);
+  // One pass over the FIFO at most; rate-limited drones go to the back
+  for (uint16_t pending = t->dirty_count; pending > 0 && !found; pending--) {
+    uint16_t n = t->dirty_fifo[t->dirty_head];
+    t->dirty_head = (t->dirty_head + 1) & (UAV_TABLE_CAPACITY - 1);
+    t->dirty_count--;
+    if (UAV_PRINT_INTERVAL_MS && (int32_t)(now - t->print_after[n]) < 0) {
+      t->dirty_fifo[(t->dirty_head + t->dirty_count) & (UAV_TABLE_CAPACITY - 1)] = n;
+      t->dirty_count++;
+      continue;
+    }
+    t->dirty[n] = false;
+    t->print_after[n] = now + UAV_PRINT_INTERVAL_MS;
+    *out = t->uavs[n];
+    t->uavs[n].plaus = 0;
+    t->uavs[n].extra_dirty = 0;
+    found = true;
+  }
+  dc_unlock(&t->lock);
+  return found;
+}
+
+bool uav_tracker_get_extra(uav_tracker *t, const uint8_t *mac, uav_extra *out) {
+  dc_lock(&t->lock);
+  const id_data *UAV = uav_tracker_find(t, mac);
+  bool found = UAV && UAV->extra;
+  if (found) *out = t->extras[UAV->extra - 1];
+  dc_unlock(&t->lock);
+  return found;
+}
@@ -0,0 +1,210 @@
+/*
+ * uav_tracker.h - Per-drone detection state shared by every firmware.
+ *
+ * One id_data record per transmitter MAC. WiFi and BLE decoders run on
+ * different tasks, so all access to the table goes through the tracker
+ * lock and callers only ever see a snapshot copy.
+ *
+ * Records live in a fixed pool allocated once at init (PSRAM when the
+ * board has it). A linear-probed index of pool positions gives O(1)
+ * lookup by MAC, and an intrusive LRU list picks the victim when the
+ * pool is full. Index value 0 means "empty", so any MAC is a valid key.
+ *
+ * Output is coalesced: a store marks the drone dirty and the printer
+ * drains the latest state of each dirty drone, so a drone beaconing at
+ * 10 Hz on two radios still costs one line per drain, not a queue of
+ * stale copies.
+ *
+ * The ODID content that is bulky and rarely changes (second Basic ID,
+ * Self ID text, Auth pages) lives out of line in a slab of
+ * UAV_EXTRA_SLOTS uav_extra records, taken by the drones that send it.
+ * id_data only holds the slot number, so the snapshots the printer
+ * copies stay small; uav_tracker_get_extra() fetches the rest when
+ * extra_dirty says it changed. A full slab recycles the slot updated
+ * least recently.
+ */
+
+#ifndef _UAV_TRACKER_H_
+#define _UAV_TRACKER_H_
+
+#include <stdint.h>
+#include "odid_fields.h"
+#include "time_sync.h"
+#include "dc_port.h"
+
+// Number of drones tracked at once. Must be a power of two (index sizing).
+#ifndef UAV_TABLE_CAPACITY
+#if defined(BOARD_HAS_PSRAM)
+#define UAV_TABLE_CAPACITY 256
+#else
+#define UAV_TABLE_CAPACITY 64
+#endif
+#endif
+
+#if (UAV_TABLE_CAPACITY & (UAV_TABLE_CAPACITY - 1)) != 0 || UAV_TABLE_CAPACITY > 16384
+#error "UAV_TABLE_CAPACITY must be a power of two no larger than 16384"
+#endif
+
+// Drones holding Self ID / Auth / second Basic ID content at once
+#ifndef UAV_EXTRA_SLOTS
+#if defined(BOARD_HAS_PSRAM)
+#define UAV_EXTRA_SLOTS 64
+#else
+#define UAV_EXTRA_SLOTS 16
+#endif
+#endif
+
+#if UAV_EXTRA_SLOTS < 1 || UAV_EXTRA_SLOTS > UAV_TABLE_CAPACITY
+#error "UAV_EXTRA_SLOTS must be between 1 and UAV_TABLE_CAPACITY"
+#endif
+
+// Auth data across pages 0..ODID_AUTH_MAX_PAGES-1
+#define UAV_AUTH_DATA_SIZE \
+  (ODID_AUTH_PAGE_ZERO_DATA_SIZE + (ODID_AUTH_MAX_PAGES - 1) * ODID_AUTH_PAGE_NONZERO_DATA_SIZE)
+
+// Minimum gap between printed updates for one drone, 0 = every change
+#ifndef UAV_PRINT_INTERVAL_MS
+#define UAV_PRINT_INTERVAL_MS 0
+#endif
+
+// Index runs at <= 50% load so probe chains stay short
+#define UAV_INDEX_SIZE  (UAV_TABLE_CAPACITY * 2)
+#define UAV_INDEX_MASK  (UAV_INDEX_SIZE - 1)
+#define UAV_NIL         0xFFFF
+
+enum WiFiBand {
+  BAND_UNKNOWN = 0,
+  BAND_2_4GHZ  = 1,
+  BAND_5GHZ    = 2,
+  BAND_BLE     = 3
+};
+
+struct id_data {
+  uint8_t  mac[6];
+  char     mac_str[18];   // format_mac(mac), filled when the record is keyed
+  int      rssi;
+  uint32_t last_seen;
+  char     op_id[ODID_ID_SIZE + 1];
+  char     uav_id[ODID_ID_SIZE + 1];
+  uint8_t  id_type;       // ODID_IDTYPE_* of uav_id
+  // Positions in ODID's 1e-7 degree fixed point, as sent; decodeLatLon()
+  // gives degrees where one is printed
+  int32_t  lat_e7;
+  int32_t  long_e7;
+  int32_t  base_lat_e7;
+  int32_t  base_long_e7;
+  int      altitude_msl;
+  int      height_agl;
+  int      speed;
+  int      heading;
+  int      flag;
+  uint8_t  band;      // WiFiBand
+  uint8_t  channel;   // WiFi channel, 0 for BLE
+  // millis() of the frame that last set each field group, 0 = never seen
+  uint32_t basic_id_ms;     // uav_id
+  uint32_t location_ms;     // lat/long, altitude, height, speed, heading
+  uint32_t system_ms;       // base_lat/base_long
+  uint32_t operator_id_ms;  // op_id
+  // UTC of the latest store on the node's synced clock, 0.1 s after the
+  // hour (time_sync.h); TIME_SYNC_NONE when the node has no sync
+  uint16_t utc_ds;
+  // PLAUS_* flags (plausibility.h) since the record was last handed out,
+  // and suppressed stores in a row
+  uint8_t  plaus;
+  uint8_t  plaus_rejects;
+  // dc_micros() at capture of the oldest update not yet handed to the
+  // printer; capture-to-output latency is measured from here
+  uint32_t capture_us;
+  // Slab slot + 1 of this drone's uav_extra, 0 = none; extra_dirty when
+  // its content changed since the record was last handed out
+  uint16_t extra;
+  uint8_t  extra_dirty;
+};
+
+// Out-of-line ODID content of one drone, as sent
+struct uav_extra {
+  uint8_t  id_type_2;                    // Basic ID slot 1, ODID_IDTYPE_NONE = none
+  uint8_t  ua_type_2;
+  char     uas_id_2[ODID_ID_SIZE + 1];
+  uint8_t  self_id_type;                 // DescType
+  char     self_id[ODID_STR_SIZE + 1];   // empty = no Self ID
+  uint8_t  auth_type;
+  uint8_t  auth_last_page;
+  uint8_t  auth_length;                  // bytes of auth_data, from page 0
+  uint16_t auth_pages;                   // bit per DataPage received
+  uint32_t auth_timestamp;               // s since 2019-01-01, from page 0
+  uint8_t  auth_data[UAV_AUTH_DATA_SIZE];
+  uint32_t updated_ms;                   // millis() of the latest store into it
+};
+
+struct uav_tracker {
+  id_data  *uavs;                           // pool, UAV_TABLE_CAPACITY records
+  uint16_t  index[UAV_INDEX_SIZE];          // pool position + 1, 0 = empty
+  uint16_t  lru_prev[UAV_TABLE_CAPACITY];
+  uint16_t  lru_next[UAV_TABLE_CAPACITY];
+  uint16_t  lru_head;                       // most recently seen
+  uint16_t  lru_tail;                       // eviction victim
+  uint16_t  count;
+  uint32_t  evictions;
+  // Dirty set: FIFO of pool positions, each queued at most once
+  uint16_t  dirty_fifo[UAV_TABLE_CAPACITY];
+  uint16_t  dirty_head;
+  uint16_t  dirty_count;
+  bool      dirty[UAV_TABLE_CAPACITY];
+  uint32_t  print_after[UAV_TABLE_CAPACITY];
+  uint32_t  coalesced;                      // stores folded into a pending update
+  uint32_t  dirty_evicted;                  // pending updates lost with their drone
+  // Stores with any of these PLAUS_* flags are dropped unmerged;
+  // PLAUS_SUPPRESS_MASK at init
+  uint8_t   suppress;
+  uint32_t  plaus_flagged;                  // stores with any flag
+  uint32_t  plaus_suppressed;
+  uav_extra *extras;                        // slab, UAV_EXTRA_SLOTS records
+  uint16_t  extra_owner[UAV_EXTRA_SLOTS];   // pool position + 1, 0 = free
+  uint32_t  extra_evictions;                // slots taken from another drone
+  // Nullable, set by the firmware: fed every Location TimeStamp stored
+  // and stamps utc_ds on each record
+  time_sync *clock;
+  dc_lock_t lock;
+};
+
+// Allocates the record pool and slab; returns false if no heap could hold
+// them.
+bool uav_tracker_init(uav_tracker *t);
+
+// Record for mac, marked most recently used. A MAC not yet in the table
+// gets a zeroed record (evicting the least recently seen drone when the
+// pool is full) with only mac filled in. Caller must hold t->lock.
+id_data *next_uav(uav_tracker *t, const uint8_t *mac);
+
+// Existing record for mac or nullptr; does not touch LRU order.
+// Caller must hold t->lock.
+id_data *uav_tracker_find(uav_tracker *t, const uint8_t *mac);
+
+// Merge the ODID message types present in f into UAV and stamp their
+// field groups with now. Everything else is kept, so a Location-only
+// frame leaves Basic ID and operator position intact.
+void odid_apply(const odid_fields *f, id_data *UAV, uint32_t now);
+
+// Merge one decoded frame into the tracker and mark the drone dirty.
+// capture_us is dc_micros() when the frame was received. *out (nullable)
+// receives a snapshot for printing, which takes the record's plaus flags
+// with it. Returns true when the dirty set was empty before, i.e. the
+// printer needs waking. With t->clock set, a Location timestamp in f is
+// sampled first, so the record's utc_ds already benefits. A store that
+// fails plaus_check() in t->suppress changes nothing but the counters;
+// *out then only gets flag = 0.
+bool uav_tracker_store(uav_tracker *t, const uint8_t *mac, int rssi,
+                       uint8_t band, uint8_t channel, uint32_t capture_us,
+                       const odid_fields *f, id_data *out);
+
+// Latest state of the next dirty drone whose UAV_PRINT_INTERVAL_MS has
+// passed, clearing its dirty mark, plaus flags and extra_dirty. False when
+// nothing is ready.
+bool uav_tracker_next_dirty(uav_tracker *t, uint32_t now, id_data *out);
+
+// Copy of mac's uav_extra; false when the drone has none (never sent any,
+// or its slot was recycled).
+bool uav_tracker_get_extra(uav_tracker *t, const uint8_t *mac, uav_extra *out);
+
+#endif // _UAV_TRACKER_H_
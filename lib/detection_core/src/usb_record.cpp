@@ -0,0 +1,97 @@
+#include <string.h>
+#include "usb_record.h"
+
+uint16_t usb_record_crc16(const uint8_t *p, size_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, int32_t v) {
+  uint32_t u = (uint32_t)v;
+  p[0] = (uint8_t)u;
+  p[1] = (uint8_t)(u >> 8);
+  p[2] = (uint8_t)(u >> 16);
+  p[3] = (uint8_t)(u >> 24);
+}
+
+int usb_record_detection_payload(uint8_t *p, size_t size, const id_data *UAV) {
+  size_t id_len = strnlen(UAV->uav_id, ODID_ID_SIZE);
+  size_t payload = USB_RECORD_DETECTION_CORE + id_len;
+  if (size < payload) return 0;
+
+  int rssi = UAV->rssi < -128 ? -128 : (UAV->rssi > 127 ? 127 : UAV->rssi);
+  int alt = UAV->altitude_msl < INT16_MIN ? INT16_MIN :
+            (UAV->altitude_msl > INT16_MAX ? INT16_MAX : UAV->altitude_msl);
+
+  memcpy(&p[0], UAV->mac, 6);
+  p[6] = (uint8_t)(int8_t)rssi;
+  p[7] = UAV->band;
+  p[8] = UAV->channel;
+  put_le32(&p[9], UAV->lat_e7);
+  put_le32(&p[13], UAV->long_e7);
+  put_le16(&p[17], (uint16_t)(int16_t)alt);
+  put_le32(&p[19], UAV->base_lat_e7);
+  put_le32(&p[23], UAV->base_long_e7);
+  p[27] = (uint8_t)id_len;
+  memcpy(&p[28], UAV->uav_id, id_len);
+  return (int)payload;
+}
+
+// Sync, length and type around a payload already at buf + 4, then the CRC
+static int frame_record(uint8_t *buf, uint8_t type, size_t payload) {
+  size_t len = USB_RECORD_HEADER_LEN + payload + 2;
+  buf[0] = USB_RECORD_SYNC0;
+  buf[1] = USB_RECORD_SYNC1;
+  buf[2] = (uint8_t)payload;
+  buf[3] = type;
+  put_le16(&buf[len - 2], usb_record_crc16(&buf[2], len - 4));
+  return (int)len;
+}
+
+int usb_record_encode(uint8_t *buf, size_t size, const id_data *UAV) {
+  if (size < USB_RECORD_HEADER_LEN + 2) return 0;
+  int payload = usb_record_detection_payload(&buf[USB_RECORD_HEADER_LEN],
+                                             size - USB_RECORD_HEADER_LEN - 2, UAV);
+  if (payload == 0) return 0;
+  return frame_record(buf, USB_RECORD_T_DETECTION, (size_t)payload);
+}
+
+int usb_record_encode_logged(uint8_t *buf, size_t size, const uint8_t *detection, size_t len,
+                             uint32_t age_s, uint16_t utc_ds) {
+  size_t payload = USB_RECORD_LOGGED_PREFIX + len;
+  if (payload > 255 || size < USB_RECORD_HEADER_LEN + payload + 2) return 0;
+  uint8_t *p = &buf[USB_RECORD_HEADER_LEN];
+  put_le32(&p[0], (int32_t)age_s);
+  put_le16(&p[4], utc_ds);
+  memcpy(&p[USB_RECORD_LOGGED_PREFIX], detection, len);
+  return frame_record(buf, USB_RECORD_T_LOGGED, payload);
+}
+
+void usb_batch_init(usb_batch *b) {
+  b->len = 0;
+  b->records = 0;
+  b->writes = 0;
+}
+
+bool usb_batch_add(usb_batch *b, const id_data *UAV) {
+  int n = usb_record_encode(b->buf + b->len, sizeof(b->buf) - b->len, UAV);
+  if (n == 0) return false;
+  b->len += n;
+  b->records++;
+  return true;
+}
+
+void usb_batch_reset(usb_batch *b) {
+  b->len = 0;
+  b->writes++;
+}
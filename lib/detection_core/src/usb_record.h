@@ -0,0 +1,89 @@
+/*
+ * usb_record.h - Optional binary USB output for mesh-mapper.
+ *
+ * JSON costs ~250 bytes and a %.6f snprintf per detection. In binary mode
+ * a detection is a 34-44 byte record, and the printer appends every record
+ * of one drain to a batch that goes out in a single Serial.write().
+ *
+ * Record (multi-byte fields little-endian):
+ *   0-1    sync 0xA5 0x5A (never valid UTF-8, so it cannot occur in the
+ *          ASCII status lines that share the port)
+ *   2      payload length
+ *   3      type (USB_RECORD_T_*)
+ *   4..    payload
+ *   last 2 CRC-16/CCITT-FALSE over length, type and payload
+ *
+ * Detection payload, type 1:
+ *   0-5    MAC
+ *   6      RSSI (int8)
+ *   7      band (WiFiBand), 8 channel
+ *   9-16   drone lat, lon (int32, 1e-7 deg)
+ *   17-18  drone altitude MSL (int16, m)
+ *   19-26  pilot lat, lon (int32, 1e-7 deg)
+ *   27     basic_id length, then basic_id bytes
+ *
+ * Logged detection payload, type 2 (replayed from flash_log.h):
+ *   0-3    age in seconds when replayed, 0xFFFFFFFF when it was logged
+ *          before the node's last reboot
+ *   4-5    UTC deciseconds after the hour at capture (time_sync.h),
+ *          0xFFFF when the node had no sync
+ *   6..    detection payload as in type 1
+ *
+ * Status and heartbeat lines stay plain text. mesh-mapper treats any
+ * bytes outside a record as text lines.
+ */
+
+#ifndef _USB_RECORD_H_
+#define _USB_RECORD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "uav_tracker.h"
+
+#define USB_RECORD_SYNC0        0xA5
+#define USB_RECORD_SYNC1        0x5A
+#define USB_RECORD_T_DETECTION  0x01
+#define USB_RECORD_T_LOGGED     0x02
+#define USB_RECORD_AGE_UNKNOWN  0xFFFFFFFF
+
+#define USB_RECORD_HEADER_LEN   4
+#define USB_RECORD_DETECTION_CORE  28
+#define USB_RECORD_DETECTION_MAX   (USB_RECORD_DETECTION_CORE + ODID_ID_SIZE)
+#define USB_RECORD_LOGGED_PREFIX   6
+#define USB_RECORD_MAX_LEN      (USB_RECORD_HEADER_LEN + USB_RECORD_DETECTION_MAX + 2)
+#define USB_RECORD_LOGGED_MAX_LEN  (USB_RECORD_MAX_LEN + USB_RECORD_LOGGED_PREFIX)
+
+#ifndef USB_BATCH_SIZE
+#define USB_BATCH_SIZE          1024
+#endif
+
+struct usb_batch {
+  uint8_t  buf[USB_BATCH_SIZE];
+  uint16_t len;
+  uint32_t records;    // total records encoded
+  uint32_t writes;     // total flushes
+};
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+uint16_t usb_record_crc16(const uint8_t *p, size_t len);
+
+// Encode one detection record into buf; returns its length, 0 if too small.
+int usb_record_encode(uint8_t *buf, size_t size, const id_data *UAV);
+
+// Just the type 1 payload, for storing; returns its length, 0 if too small.
+int usb_record_detection_payload(uint8_t *p, size_t size, const id_data *UAV);
+
+// Logged record around a stored detection payload of len bytes.
+int usb_record_encode_logged(uint8_t *buf, size_t size, const uint8_t *detection, size_t len,
+                             uint32_t age_s, uint16_t utc_ds);
+
+void usb_batch_init(usb_batch *b);
+
+// Append UAV; returns false (and appends nothing) when the batch has no
+// room for the record, in which case flush and retry.
+bool usb_batch_add(usb_batch *b, const id_data *UAV);
+
+// Call after writing buf[0..len) out in one go.
+void usb_batch_reset(usb_batch *b);
+
+#endif // _USB_RECORD_H_
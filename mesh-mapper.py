@@ -12,6 +12,7 @@ import serial.tools.list_ports
 import signal
 import sys
 import argparse
+import struct
 from datetime import datetime, timedelta
 from typing import Optional, List
 from requests.adapters import HTTPAdapter
@@ -249,6 +250,34 @@ last_mac_by_port = {}
 serial_objs = {}
 serial_objs_lock = threading.Lock()
 
+# Firmware {"metrics":...} records (built with DC_METRICS), per port.
+# At the default 10 s period this keeps about an hour per node.
+NODE_METRICS_HISTORY = 360
+node_metrics = {}
+node_metrics_lock = threading.Lock()
+
+# Multi-radio aggregation: sniffers built with -DSNIFFER_COUNT/-DSNIFFER_INDEX
+# split the channel plan, but a drone can still reach more than one of them
+# (BLE and WiFi leaking across adjacent channels). The same drone state from
+# another port within MERGE_WINDOW_S is one reception, not two; the reader
+# threads drop it so update_detection() sees a single stream.
+MERGE_WINDOW_S = 1.0
+# No 'ts': that is each sniffer's own clock at capture, not the drone's, and
+# two boards rarely agree on the decisecond; the window bounds the time
+MERGE_KEY_FIELDS = ('drone_lat', 'drone_long', 'drone_altitude', 'pilot_lat',
+                    'pilot_long', 'basic_id')
+merge_lock = threading.Lock()
+merge_recent = {}   # mac -> (time, port, state key) of the copy passed on
+merge_stats = {'passed': 0, 'merged': 0}
+sniffer_by_port = {}   # port -> firmware {"sniffer":{...}} status block
+build_by_port = {}     # port -> firmware {"build":{...}}: board, radios, outputs
+
+# Flash log replay: remote nodes that lost their link send the detections
+# they logged as binary records when this side opens the port. They go to
+# the CSV history at the time they were heard, not onto the live map.
+replay_lock = threading.Lock()
+replay_stats = {}   # port -> {'records', 'undated', 'last_batch'}
+
 startup_timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
 # Updated detections CSV header to include faa_data.
 CSV_FILENAME = os.path.join(BASE_DIR, f"detections_{startup_timestamp}.csv")
@@ -783,11 +812,19 @@ generate_cumulative_kml()
 # ----------------------
 # Detection Update & CSV Logging
 # ----------------------
+# Out-of-line ODID content; firmware sends it only on the line after it
+# changes, so it is carried over from the previous detection of the MAC
+ODID_EXTRA_FIELDS = ('basic_id_2', 'id_type_2', 'self_id', 'self_id_type', 'auth')
+
 def update_detection(detection):
     mac = detection.get("mac")
     if not mac:
         return
     prev = tracked_pairs.get(mac)
+    if prev:
+        for key in ODID_EXTRA_FIELDS:
+            if key not in detection and key in prev:
+                detection[key] = prev[key]
 
     # Retrieve new drone coordinates from the detection
     new_drone_lat = detection.get("drone_lat", 0)
@@ -3956,7 +3993,26 @@ def api_ports():
 # Updated status endpoint: returns a dict of statuses for each selected USB.
 @app.route('/api/serial_status', methods=['GET'])
 def api_serial_status():
-    return jsonify({"statuses": serial_connected_status})
+    with merge_lock:
+        merge = dict(merge_stats)
+    with replay_lock:
+        replay = {port: dict(stats) for port, stats in replay_stats.items()}
+    return jsonify({"statuses": serial_connected_status, "sniffers": sniffer_by_port,
+                    "builds": build_by_port, "merge": merge, "replay": replay})
+
+# Perf counter history per port; ?port=<device> narrows it, ?latest=1 keeps
+# only the newest record
+@app.route('/api/metrics', methods=['GET'])
+def api_metrics():
+    wanted = request.args.get('port')
+    latest = request.args.get('latest') == '1'
+    with node_metrics_lock:
+        result = {
+            port: ([history[-1]] if latest else list(history))
+            for port, history in node_metrics.items()
+            if history and (wanted is None or port == wanted)
+        }
+    return jsonify({"metrics": result})
 
 # New endpoint to get currently selected ports
 @app.route('/api/selected_ports', methods=['GET'])
@@ -3994,8 +4050,200 @@ def api_paths():
 # ----------------------
 # Serial Reader Threads: Each selected port gets its own thread.
 # ----------------------
+# ----------------------
+# Binary USB records (firmware built with -DUSB_BINARY_OUTPUT=1, and
+# flash log replays). Layout: lib/detection_core/src/usb_record.h
+# ----------------------
+USB_RECORD_SYNC = b'\xa5\x5a'
+USB_RECORD_T_DETECTION = 0x01
+USB_RECORD_T_LOGGED = 0x02
+USB_RECORD_LOGGED_PREFIX = 6
+USB_RECORD_AGE_UNKNOWN = 0xFFFFFFFF
+UTC_DS_NONE = 0xFFFF
+USB_RECORD_DETECTION_CORE = 28
+USB_BAND_NAMES = {1: '2.4GHz', 2: '5GHz', 3: 'BLE'}
+
+def crc16_ccitt(data):
+    """CRC-16/CCITT-FALSE, as computed by the firmware"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+def decode_usb_detection(payload):
+    """Detection record payload -> the same dict the JSON line would give"""
+    if len(payload) < USB_RECORD_DETECTION_CORE:
+        return None
+    rssi, band, channel, lat, lon, alt, plat, plon, id_len = \
+        struct.unpack_from('<bBBiihiiB', payload, 6)
+    if len(payload) != USB_RECORD_DETECTION_CORE + id_len:
+        return None
+    detection = {
+        'mac': ':'.join(f'{b:02x}' for b in payload[0:6]),
+        'rssi': rssi,
+        'drone_lat': lat / 1e7,
+        'drone_long': lon / 1e7,
+        'drone_altitude': alt,
+        'pilot_lat': plat / 1e7,
+        'pilot_long': plon / 1e7,
+        'basic_id': payload[28:28 + id_len].decode('ascii', errors='ignore'),
+    }
+    if band in USB_BAND_NAMES:
+        detection['band'] = USB_BAND_NAMES[band]
+        detection['channel'] = channel
+    return detection
+
+def decode_usb_logged(payload):
+    """Logged record payload -> detection dict marked 'replayed', with the
+    node's 'age_s' (None across a node reboot) and 'ts' when it had UTC"""
+    if len(payload) < USB_RECORD_LOGGED_PREFIX:
+        return None
+    age_s, utc_ds = struct.unpack_from('<IH', payload, 0)
+    detection = decode_usb_detection(payload[USB_RECORD_LOGGED_PREFIX:])
+    if detection is None:
+        return None
+    detection['replayed'] = True
+    detection['age_s'] = None if age_s == USB_RECORD_AGE_UNKNOWN else age_s
+    if utc_ds != UTC_DS_NONE:
+        detection['ts'] = utc_ds
+    return detection
+
+class SerialStreamDecoder:
+    """Splits a serial byte stream into text lines and binary detection records.
+
+    Bytes outside a record are text; a text line interrupted by a record
+    write is stitched back together.
+    """
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.records = 0
+        self.bad_records = 0
+
+    def feed(self, data):
+        """Returns the text lines (str) and detections (dict) completed by data"""
+        self.buf += data
+        items = []
+        while self.buf:
+            i = self.buf.find(USB_RECORD_SYNC)
+            if i < 0:
+                # Keep a trailing first sync byte; the second may be in flight
+                keep = 1 if self.buf[-1] == USB_RECORD_SYNC[0] else 0
+                self.text += self.buf[:len(self.buf) - keep]
+                del self.buf[:len(self.buf) - keep]
+                break
+            self.text += self.buf[:i]
+            del self.buf[:i]
+            if len(self.buf) < 4:
+                break
+            total = 4 + self.buf[2] + 2
+            if len(self.buf) < total:
+                break
+            record = bytes(self.buf[:total])
+            crc = record[-2] | (record[-1] << 8)
+            detection = None
+            if crc16_ccitt(record[2:-2]) == crc:
+                if record[3] == USB_RECORD_T_DETECTION:
+                    detection = decode_usb_detection(record[4:-2])
+                elif record[3] == USB_RECORD_T_LOGGED:
+                    detection = decode_usb_logged(record[4:-2])
+            if detection is None:
+                # Not a record after all: skip the sync byte and rescan
+                self.bad_records += 1
+                del self.buf[:1]
+                continue
+            self.records += 1
+            items.append(detection)
+            del self.buf[:total]
+
+        while True:
+            nl = self.text.find(b'\n')
+            if nl < 0:
+                break
+            items.append(self.text[:nl].decode('utf-8', errors='ignore'))
+            del self.text[:nl + 1]
+        # A runaway line with no newline must not grow without bound
+        if len(self.text) > 4096:
+            items.append(self.text.decode('utf-8', errors='ignore'))
+            self.text.clear()
+        return items
+
+def record_node_metrics(port, metrics):
+    """Keep a node's perf counters for /api/metrics and push them to the UI"""
+    entry = dict(metrics)
+    entry['time'] = time.time()
+    with node_metrics_lock:
+        history = node_metrics.setdefault(port, deque(maxlen=NODE_METRICS_HISTORY))
+        history.append(entry)
+    try:
+        socketio.emit('node_metrics', {'port': port, 'metrics': entry})
+    except Exception as e:
+        logger.debug(f"Error emitting node metrics: {e}")
+
+def is_merged_copy(detection, port):
+    """True when another port already delivered this drone state within
+    MERGE_WINDOW_S. Caller holds merge_lock."""
+    mac = detection.get('mac')
+    if not mac or MERGE_WINDOW_S <= 0:
+        return False
+    now = time.time()
+    key = tuple(detection.get(k) for k in MERGE_KEY_FIELDS)
+    prev = merge_recent.get(mac)
+    if prev and prev[1] != port and prev[2] == key and now - prev[0] < MERGE_WINDOW_S:
+        merge_stats['merged'] += 1
+        return True
+    merge_stats['passed'] += 1
+    merge_recent[mac] = (now, port, key)
+    if len(merge_recent) > 1024:
+        for m in [m for m, v in merge_recent.items() if now - v[0] >= MERGE_WINDOW_S]:
+            del merge_recent[m]
+    return False
+
+def replay_time(detection, now):
+    """When a replayed detection was heard: from the node's age, else the
+    latest UTC that matches its ts (deciseconds after the hour), else now.
+    Returns (time, dated)."""
+    if detection.get('age_s') is not None:
+        return now - detection['age_s'], True
+    ts = detection.get('ts')
+    if ts is not None:
+        hour = int(now // 3600) * 3600
+        t = hour + ts / 10.0
+        return (t - 3600 if t > now else t), True
+    return now, False
+
+def record_replayed_detection(detection, port):
+    """Append a replayed detection to the session and cumulative CSVs"""
+    t, dated = replay_time(detection, time.time())
+    mac = detection.get('mac', '')
+    row = {
+        'timestamp': datetime.fromtimestamp(t).isoformat(),
+        'alias': ALIASES.get(mac, ''),
+        'mac': mac,
+        'rssi': detection.get('rssi', ''),
+        'drone_lat': detection.get('drone_lat', ''),
+        'drone_long': detection.get('drone_long', ''),
+        'drone_altitude': detection.get('drone_altitude', ''),
+        'pilot_lat': detection.get('pilot_lat', ''),
+        'pilot_long': detection.get('pilot_long', ''),
+        'basic_id': detection.get('basic_id', ''),
+        'faa_data': json.dumps({})
+    }
+    for filename in (CSV_FILENAME, CUMULATIVE_CSV_FILENAME):
+        with open(filename, mode='a', newline='') as csvfile:
+            csv.DictWriter(csvfile, fieldnames=list(row.keys())).writerow(row)
+    with replay_lock:
+        stats = replay_stats.setdefault(port, {'records': 0, 'undated': 0, 'last_batch': None})
+        stats['records'] += 1
+        if not dated:
+            stats['undated'] += 1
+
 def serial_reader(port):
     ser = None
+    decoder = SerialStreamDecoder()
     connection_attempts = 0
     max_connection_attempts = 5
     data_received_count = 0
@@ -4008,6 +4256,7 @@ def serial_reader(port):
         if ser is None or not getattr(ser, 'is_open', False):
             try:
                 ser = serial.Serial(port, BAUD_RATE, timeout=1)
+                decoder = SerialStreamDecoder()
                 serial_connected_status[port] = True
                 connection_attempts = 0  # Reset counter on successful connection
                 logger.info(f"Opened serial port {port} at {BAUD_RATE} baud.")
@@ -4045,10 +4294,22 @@ def serial_reader(port):
                 continue
 
         try:
-            # Always try to read data, don't rely only on in_waiting
-            line = ser.readline().decode('utf-8', errors='ignore').strip()
+            # Binary records and text lines share the port; the decoder
+            # splits them (firmware built with -DUSB_BINARY_OUTPUT=1)
+            chunk = ser.read(ser.in_waiting or 1)
+            items = decoder.feed(chunk) if chunk else []
             
-            if line:
+            for item in items:
+                if isinstance(item, dict) and item.get('replayed'):
+                    record_replayed_detection(item, port)
+                    continue
+                if isinstance(item, dict):
+                    line = f"<binary record {item.get('mac', '?')}>"
+                else:
+                    line = item.strip()
+                    if not line:
+                        continue
+                
                 data_received_count += 1
                 last_data_time = time.time()
                 
@@ -4056,15 +4317,39 @@ def serial_reader(port):
                 if data_received_count <= 10 or data_received_count % 50 == 0:
                     logger.info(f"Data from {port} (#{data_received_count}): {line[:200]}")
                 
-                # JSON extraction and detection handling...
-                json_str = line
-                if '{' in line:
-                    json_str = line[line.find('{'):]
-                    
                 try:
-                    detection = json.loads(json_str)
+                    if isinstance(item, dict):
+                        detection = item
+                    else:
+                        # JSON extraction and detection handling...
+                        json_str = line
+                        if '{' in line:
+                            json_str = line[line.find('{'):]
+                        detection = json.loads(json_str)
                     logger.debug(f"Parsed JSON from {port}: {detection}")
                     
+                    # Perf counters, not a detection: must not pick up a cached MAC
+                    if isinstance(detection.get('metrics'), dict):
+                        record_node_metrics(port, detection['metrics'])
+                        continue
+                    if isinstance(detection.get('build'), dict):
+                        build_by_port[port] = detection['build']
+                        if isinstance(detection.get('sniffer'), dict):
+                            sniffer_by_port[port] = detection['sniffer']
+                        continue
+                    if isinstance(detection.get('sniffer'), dict):
+                        sniffer_by_port[port] = detection['sniffer']
+                        continue
+                    if isinstance(detection.get('flash_log_replay'), dict):
+                        entries = detection['flash_log_replay'].get('entries', 0)
+                        logger.info(f"Flash log replay from {port}: {entries} detections")
+                        with replay_lock:
+                            stats = replay_stats.setdefault(
+                                port, {'records': 0, 'undated': 0, 'last_batch': None})
+                            stats['last_batch'] = entries
+                        generate_cumulative_kml_throttled()
+                        continue
+                    
                     # MAC tracking logic...
                     if 'mac' in detection:
                         last_mac_by_port[port] = detection['mac']
@@ -4092,6 +4377,11 @@ def serial_reader(port):
                     # Add port information for debugging
                     detection['source_port'] = port
                     
+                    with merge_lock:
+                        if is_merged_copy(detection, port):
+                            logger.debug(f"Merged copy of {detection.get('mac')} from {port}")
+                            continue
+                    
                     # Process the detection
                     logger.info(f"Processing detection from {port}: MAC={detection.get('mac', 'N/A')}, "
                               f"RSSI={detection.get('rssi', 'N/A')}, "
@@ -4108,7 +4398,8 @@ def serial_reader(port):
                     # Log non-JSON data for debugging
                     logger.debug(f"Non-JSON data from {port}: {line[:100]}")
                     continue
-            else:
+            
+            if not chunk:
                 # Short sleep when no data
                 time.sleep(0.1)
                 
@@ -4247,6 +4538,8 @@ Examples:
   python mapper.py --no-auto-start    # Disable automatic port connection
   python mapper.py --port-interval 5  # Check for ports every 5 seconds
   python mapper.py --debug            # Enable debug logging
+  python mapper.py --baud 921600      # Binary USB output firmware (-DUSB_BINARY_OUTPUT=1)
+  python mapper.py --merge-window 0   # Keep every port's copy of a detection
         """
     )
     
@@ -4282,11 +4575,26 @@ Examples:
         help='Enable debug logging'
     )
     
+    parser.add_argument(
+        '--baud',
+        type=int,
+        default=BAUD_RATE,
+        help=f'Serial baud rate (default: {BAUD_RATE}; use 921600 for -DUSB_BINARY_OUTPUT=1 firmware)'
+    )
+    
+    parser.add_argument(
+        '--merge-window',
+        type=float,
+        default=MERGE_WINDOW_S,
+        help=f'Seconds within which the same drone state from another port is merged '
+             f'(default: {MERGE_WINDOW_S}; 0 disables)'
+    )
+    
     return parser.parse_args()
 
 def main():
     """Main function with enhanced startup and configuration"""
-    global HEADLESS_MODE, AUTO_START_ENABLED, PORT_MONITOR_INTERVAL
+    global HEADLESS_MODE, AUTO_START_ENABLED, PORT_MONITOR_INTERVAL, BAUD_RATE, MERGE_WINDOW_S
     
     # Parse command line arguments
     args = parse_arguments()
@@ -4295,6 +4603,8 @@ def main():
     HEADLESS_MODE = args.headless
     AUTO_START_ENABLED = not args.no_auto_start
     PORT_MONITOR_INTERVAL = args.port_interval
+    BAUD_RATE = args.baud
+    MERGE_WINDOW_S = args.merge_window
     
     # Configure logging level
     if args.debug:
@@ -19,6 +19,31 @@
  *   - After 500ms: next detection goes through (new position data)
  *   - Result: near real-time tracking with no multi-node spam
  *   - Stale entries auto-cleared after 30s of no activity
+ *   - Table is hashed on the binary MAC (see dedup_table.h), so the cost
+ *     per line stays flat with hundreds of drones in view
+ *
+ * MESH FRAMES:
+ *   Remote nodes send compact "RIDB:" binary frames (see mesh_frame.h)
+ *   instead of JSON to save LoRa airtime. They are expanded back into the
+ *   usual mesh-mapper JSON here, before dedup. basic_id only rides along
+ *   every few frames, so the last one seen is cached per drone MAC. The
+ *   uplink is change-only: a drone that has not moved is sent as a short
+ *   keepalive frame, rebuilt here from the drone's last full frame.
+ *   Plain JSON lines from older remotes are still accepted.
+ *
+ * ORDERING:
+ *   Remote nodes stamp each detection with "ts", UTC tenths of a second
+ *   after the hour from a clock synced to the drones' own ODID Location
+ *   timestamps (time_sync.h). A copy more than DEDUP_LATE_DS older than
+ *   the newest one seen for its drone arrived late over a slower relay
+ *   path and is dropped instead of overwriting newer data downstream.
+ *
+ * RSSI FUSION (optional, -DRSSI_FUSION=1):
+ *   Copies suppressed by dedup still carry each node's RSSI. With the
+ *   remote nodes' positions given in FUSION_NODES, the copies of a drone
+ *   from several nodes are fused into a position estimate (rssi_fusion.h)
+ *   that is added to its forwarded lines as estimated_lat/estimated_long,
+ *   for drones sending no position or a spoofed one.
  *
  * NO WiFi scanning. NO BLE scanning. NO detection.
  * This node is purely a smart bridge: Heltec V3 UART -> dedup -> USB Serial.
@@ -35,6 +60,13 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include "mesh_frame.h"
+#include "detection_json.h"
+#include "dedup_table.h"
+#include "json_scan.h"
+#include "uart_ingest.h"
+#include "rssi_fusion.h"
+#include "time_sync.h"
 
 // =============================================================================
 // Pin Definitions
@@ -53,115 +85,100 @@ static const int SERIAL1_RX_PIN = 6;   // GPIO6 <- Heltec TX
 #define HEARTBEAT_MS       30000    // Heartbeat interval (30s)
 #define LED_FLASH_MS       50       // LED on-time per forwarded message
 #define STATS_INTERVAL     60000    // Print stats every 60s
+#define LOOP_IDLE_MS       10       // Max sleep waiting for UART data (LED/holdback timing)
 
 // Dedup tuning
 // Remote nodes fire as fast as they detect - no rate limiting.
 // Multi-node duplicates for the same detection event arrive within a few
 // hundred ms of each other over mesh. 500ms window catches the burst of
 // copies while letting every new position update through near-instantly.
-#define DEDUP_MAX_DRONES   16       // Max simultaneous tracked drone MACs
+// Table size and stale timeout: DEDUP_TABLE_CAPACITY / DEDUP_STALE_MS
 #define DEDUP_WINDOW_MS    500      // 500ms - tight dedup, near real-time updates
-#define DEDUP_STALE_MS     30000    // Clear entry after 30s of no activity
-
-// =============================================================================
-// Lightweight JSON Field Extractor
-// Pulls string/int values from flat JSON without a full parser library.
-// =============================================================================
-
-// Extract a string value for a given key. Returns length, or 0 if not found.
-// Example: extractJsonString(line, "mac", out, 18) -> "aa:bb:cc:dd:ee:ff"
-static int extractJsonString(const char* json, const char* key, char* out, int outSize) {
-  // Build search pattern: "key":"
-  char pattern[48];
-  snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
-
-  const char* p = strstr(json, pattern);
-  if (!p) return 0;
-
-  p += strlen(pattern);  // skip past opening quote
-  int i = 0;
-  while (*p && *p != '"' && i < outSize - 1) {
-    out[i++] = *p++;
-  }
-  out[i] = '\0';
-  return i;
-}
+#define STATS_MAX_DRONES   16       // Per-drone lines in the stats dump
+
+// 1: after the window, a copy identical to the last forwarded one apart
+// from node_id/rssi (a late relay of the same broadcast) is still dropped,
+// up to DEDUP_CONTENT_REFRESH_MS after that forward, so a parked drone
+// still reaches mesh-mapper well inside its 3 minute inactive timeout
+#ifndef DEDUP_CONTENT_HASH
+#define DEDUP_CONTENT_HASH 0
+#endif
+#ifndef DEDUP_CONTENT_REFRESH_MS
+#define DEDUP_CONTENT_REFRESH_MS 30000
+#endif
+
+// Quality-aware mode: >0 holds the first copy of each window for this long,
+// swaps in any better copy that arrives meanwhile, then forwards the best.
+// Must be shorter than DEDUP_WINDOW_MS. 0 = first in wins (zero latency).
+#ifndef DEDUP_HOLDBACK_MS
+#define DEDUP_HOLDBACK_MS  0
+#endif
+#define HOLD_SLOTS         16       // Drones held back at once; overflow forwards immediately
+#define NODE_STATS_MAX     32       // Distinct node_ids with win counts
+
+#if DEDUP_HOLDBACK_MS >= DEDUP_WINDOW_MS
+#error "DEDUP_HOLDBACK_MS must be shorter than DEDUP_WINDOW_MS"
+#endif
+
+// Copies whose "ts" is this much older than the newest seen for the drone
+// are dropped as out of order (deciseconds; covers node clock sync error)
+#ifndef DEDUP_LATE_DS
+#define DEDUP_LATE_DS      20
+#endif
+
+// RSSI position fusion across remote nodes. FUSION_NODES lists the nodes'
+// fixed positions as "node_id=lat,long;..." (node_id as in their JSON),
+// e.g. -DFUSION_NODES='"A1B2=51.501234,-0.120001;C3D4=51.498800,-0.115020"'.
+// Path loss model: FUSION_RSSI_1M dBm at 1 m, exponent FUSION_PATH_LOSS_X10/10.
+#ifndef RSSI_FUSION
+#define RSSI_FUSION 0
+#endif
+#ifndef FUSION_NODES
+#define FUSION_NODES ""
+#endif
+#ifndef FUSION_WINDOW_MS
+#define FUSION_WINDOW_MS    6000    // Covers one MESH_DRONE_INTERVAL_MS round of every node
+#endif
+#ifndef FUSION_MAX_AGE_MS
+#define FUSION_MAX_AGE_MS   15000   // Estimates older than this are not attached
+#endif
+#ifndef FUSION_RSSI_1M
+#define FUSION_RSSI_1M      -40
+#endif
+#ifndef FUSION_PATH_LOSS_X10
+#define FUSION_PATH_LOSS_X10 27
+#endif
+
+// Holdback ranks copies by content hash too
+#define DEDUP_WANT_HASH    (DEDUP_CONTENT_HASH || DEDUP_HOLDBACK_MS > 0)
 
 // =============================================================================
 // Deduplication Engine
 // =============================================================================
-struct dedup_entry {
-  char     mac[18];             // Drone MAC address (key) "xx:xx:xx:xx:xx:xx"
-  uint32_t windowStart;         // When the dedup window opened (ms)
-  uint32_t lastSeen;            // Last time this MAC was seen (ms)
-  bool     active;              // Slot in use
-  char     firstNodeId[8];      // node_id that won (first in)
-  uint8_t  dupsBlocked;         // How many duplicates were blocked this window
-};
-
-static dedup_entry dedupTable[DEDUP_MAX_DRONES];
+static dedup_table dedupTable;
 
-// Initialize the dedup table
-static void dedupInit() {
-  memset(dedupTable, 0, sizeof(dedupTable));
-}
-
-// Find or allocate a dedup slot for a drone MAC
-static dedup_entry* dedupFind(const char* mac) {
-  // Search for existing entry
-  for (int i = 0; i < DEDUP_MAX_DRONES; i++) {
-    if (dedupTable[i].active && strcmp(dedupTable[i].mac, mac) == 0) {
-      return &dedupTable[i];
-    }
-  }
-  return nullptr;
-}
-
-static dedup_entry* dedupAlloc(const char* mac) {
-  // Find empty slot
-  for (int i = 0; i < DEDUP_MAX_DRONES; i++) {
-    if (!dedupTable[i].active) {
-      memset(&dedupTable[i], 0, sizeof(dedup_entry));
-      strncpy(dedupTable[i].mac, mac, sizeof(dedupTable[i].mac) - 1);
-      dedupTable[i].active = true;
-      return &dedupTable[i];
-    }
-  }
-  // Table full - evict oldest entry
-  uint32_t oldestTime = UINT32_MAX;
-  int oldestIdx = 0;
-  for (int i = 0; i < DEDUP_MAX_DRONES; i++) {
-    if (dedupTable[i].lastSeen < oldestTime) {
-      oldestTime = dedupTable[i].lastSeen;
-      oldestIdx = i;
-    }
-  }
-  memset(&dedupTable[oldestIdx], 0, sizeof(dedup_entry));
-  strncpy(dedupTable[oldestIdx].mac, mac, sizeof(dedupTable[oldestIdx].mac) - 1);
-  dedupTable[oldestIdx].active = true;
-  return &dedupTable[oldestIdx];
-}
-
-// Clean stale entries periodically
+// Drop entries idle for DEDUP_STALE_MS; only the wheel slots that fell due
 static void dedupCleanStale(uint32_t now) {
-  for (int i = 0; i < DEDUP_MAX_DRONES; i++) {
-    if (dedupTable[i].active && (now - dedupTable[i].lastSeen > DEDUP_STALE_MS)) {
-      Serial.printf("[DEDUP] Cleared stale drone %s (no activity %lus)\n",
-                    dedupTable[i].mac, (now - dedupTable[i].lastSeen) / 1000);
-      dedupTable[i].active = false;
-    }
+  dedup_entry stale;
+  while (dedup_table_expire(&dedupTable, now, &stale)) {
+    char macStr[18];
+    format_mac(macStr, stale.mac);
+    Serial.printf("[DEDUP] Cleared stale drone %s (no activity %lus)\n",
+                  macStr, (now - stale.last_seen) / 1000);
   }
 }
 
+#if RSSI_FUSION
+static rssi_fusion fusion;
+#endif
+
 // =============================================================================
 // State
 // =============================================================================
-static char lineBuf[LINE_BUF_SIZE];
-static int  linePos = 0;
+static uart_ingest heltecUart;   // Heltec V3 -> lines, woken by UART RX events
 
 static unsigned long lastHeartbeat  = 0;
 static unsigned long lastStats      = 0;
-static unsigned long lastCleanup    = 0;
 static unsigned long ledOffAt       = 0;
 static bool          ledActive      = false;
 
@@ -169,22 +186,61 @@ static bool          ledActive      = false;
 static uint32_t msgReceived   = 0;   // Total JSON messages from mesh
 static uint32_t msgForwarded  = 0;   // Messages forwarded to USB (after dedup)
 static uint32_t msgSuppressed = 0;   // Duplicates suppressed
+static uint32_t msgLate       = 0;   // Copies older than the newest "ts" seen
+#if DEDUP_CONTENT_HASH
+static uint32_t msgSameContent = 0;  // ...of which repeated content after the window
+#endif
 static uint32_t msgNonJson    = 0;   // Non-JSON lines
-static uint32_t totalBytes    = 0;   // Total bytes received from UART
-
-// =============================================================================
-// JSON Validation
-// =============================================================================
-static bool looksLikeJSON(const char* line, int len) {
-  if (len < 2) return false;
-  int start = 0;
-  while (start < len && (line[start] == ' ' || line[start] == '\t')) start++;
-  if (start >= len) return false;
-  int end = len - 1;
-  while (end > start && (line[end] == ' ' || line[end] == '\t')) end--;
-  return (line[start] == '{' && line[end] == '}');
+static uint32_t msgFrames     = 0;   // RIDB: binary frames decoded
+static uint32_t msgBadFrames  = 0;   // RIDB: frames failing length/CRC checks
+static uint32_t msgKeepalives = 0;   // ...of the decoded, keepalive frames
+static uint32_t msgOrphanKeepalives = 0;  // Keepalives with no full frame to expand
+#if RSSI_FUSION
+static uint32_t msgEstimated  = 0;   // Forwarded lines carrying an RSSI estimate
+#endif
+#if DEDUP_HOLDBACK_MS > 0
+static uint32_t msgReplaced   = 0;   // Held copies displaced by a better one
+static uint32_t holdOverflow  = 0;   // Windows forwarded at once, no free hold slot
+#endif
+
+// Which remote node's copy was forwarded, per node_id
+struct node_stat {
+  char     nodeId[8];
+  uint32_t wins;
+};
+static node_stat nodeStats[NODE_STATS_MAX];
+static int       nodeStatCount = 0;
+static uint32_t  nodeStatOverflow = 0;   // Wins by nodes past NODE_STATS_MAX
+
+static void nodeWin(const char* nodeId) {
+  for (int i = 0; i < nodeStatCount; i++) {
+    if (strcmp(nodeStats[i].nodeId, nodeId) == 0) {
+      nodeStats[i].wins++;
+      return;
+    }
+  }
+  if (nodeStatCount == NODE_STATS_MAX) {
+    nodeStatOverflow++;
+    return;
+  }
+  strncpy(nodeStats[nodeStatCount].nodeId, nodeId, sizeof(nodeStats[0].nodeId) - 1);
+  nodeStats[nodeStatCount++].wins = 1;
 }
 
+#if DEDUP_HOLDBACK_MS > 0
+// One held candidate: the best copy of a drone's current window so far
+struct hold_slot {
+  bool     used;
+  uint8_t  mac[6];
+  uint32_t due;                 // millis() to forward at
+  int32_t  score;
+  uint32_t contentHash;
+  char     nodeId[8];
+  char     line[LINE_BUF_SIZE];
+};
+static hold_slot holdSlots[HOLD_SLOTS];
+#endif
+
 // =============================================================================
 // LED Helpers
 // =============================================================================
@@ -201,68 +257,258 @@ static inline void ledUpdate() {
   }
 }
 
+// =============================================================================
+// Forward one detection to mesh-mapper as the winner of its window
+// =============================================================================
+static void forwardWinner(dedup_entry* entry, const char* line,
+                          const char* nodeId, uint32_t contentHash) {
+  if (entry) {
+    entry->content_hash = contentHash;
+    strncpy(entry->first_node_id, nodeId, sizeof(entry->first_node_id) - 1);
+  }
+  nodeWin(nodeId);
+#if RSSI_FUSION
+  // Latest fused position goes in before the closing brace
+  const fusion_slot* est = entry ? rssi_fusion_estimate(&fusion, entry->mac, millis()) : nullptr;
+  size_t len = strlen(line);
+  if (est && len > 0 && line[len - 1] == '}') {
+    char extra[128];
+    rssi_fusion_format(est, extra, sizeof(extra));
+    Serial.write((const uint8_t*)line, len - 1);
+    Serial.print(extra);
+    Serial.println("}");
+    msgEstimated++;
+  } else {
+    Serial.println(line);
+  }
+#else
+  Serial.println(line);
+#endif
+  msgForwarded++;
+  ledFlash();
+}
+
+#if DEDUP_HOLDBACK_MS > 0
+// Position first, then news (content differs from the copy mesh-mapper
+// already has, i.e. a fresher ODID broadcast), then signal strength
+static int32_t candidateScore(const json_fields* f, uint32_t lastHash) {
+  int32_t score = 0;
+  if (JSON_HAS(f, JSON_KEY_DRONE_LAT) && JSON_HAS(f, JSON_KEY_DRONE_LONG) &&
+      (strtod(f->v[JSON_KEY_DRONE_LAT].p, nullptr) != 0.0 ||
+       strtod(f->v[JSON_KEY_DRONE_LONG].p, nullptr) != 0.0)) {
+    score += 1 << 16;
+  }
+  if (f->content_hash != lastHash) score += 1 << 12;
+  if (JSON_HAS(f, JSON_KEY_RSSI)) {
+    score += 200 + (int32_t)strtol(f->v[JSON_KEY_RSSI].p, nullptr, 10);
+  }
+  return score;
+}
+
+static hold_slot* holdFind(const uint8_t* mac) {
+  for (int i = 0; i < HOLD_SLOTS; i++) {
+    if (holdSlots[i].used && memcmp(holdSlots[i].mac, mac, 6) == 0) return &holdSlots[i];
+  }
+  return nullptr;
+}
+
+static void holdStore(hold_slot* h, const char* line, const json_fields* f,
+                      const char* nodeId, int32_t score) {
+  h->score = score;
+  h->contentHash = f->content_hash;
+  strncpy(h->nodeId, nodeId, sizeof(h->nodeId) - 1);
+  h->nodeId[sizeof(h->nodeId) - 1] = '\0';
+  strncpy(h->line, line, sizeof(h->line) - 1);
+  h->line[sizeof(h->line) - 1] = '\0';
+}
+
+// Open a new window: hold the copy if a slot is free, else forward it now
+static void holdOpen(dedup_entry* entry, const char* line, const json_fields* f,
+                     const char* nodeId, uint32_t now) {
+  for (int i = 0; i < HOLD_SLOTS; i++) {
+    hold_slot* h = &holdSlots[i];
+    if (h->used) continue;
+    h->used = true;
+    memcpy(h->mac, entry->mac, 6);
+    h->due = now + DEDUP_HOLDBACK_MS;
+    holdStore(h, line, f, nodeId, candidateScore(f, entry->content_hash));
+    return;
+  }
+  holdOverflow++;
+  forwardWinner(entry, line, nodeId, f->content_hash);
+}
+
+// Forward the held candidates whose holdback has run out
+static void holdFlush(uint32_t now) {
+  for (int i = 0; i < HOLD_SLOTS; i++) {
+    hold_slot* h = &holdSlots[i];
+    if (!h->used || (int32_t)(now - h->due) < 0) continue;
+    h->used = false;
+    forwardWinner(dedup_table_find(&dedupTable, h->mac), h->line, h->nodeId, h->contentHash);
+  }
+}
+#endif
+
 // =============================================================================
 // Process a complete JSON line through the dedup engine
 //
-// SIMPLE RULE: First detection in wins. Everything else within the dedup
+// DEFAULT RULE: First detection in wins. Everything else within the dedup
 // window is dropped. No RSSI comparison, no "better data" updates.
 // The drone's lat/long comes from Remote ID broadcast and is the same
 // regardless of which node picks it up. First in = mapped. Done.
+//
+// With DEDUP_HOLDBACK_MS the first copy is held instead, and a later copy
+// in the holdback that scores higher (candidateScore) replaces it; the
+// winner is forwarded when the holdback ends. One line per window either way.
+//
+// Returns false only for a copy dropped as older than data already seen,
+// so callers keep no state from it; forwarded and deduplicated copies are
+// current.
 // =============================================================================
-static void processJsonLine(const char* line, int len) {
+static bool processJsonLine(const char* line, const json_fields* f) {
   uint32_t now = millis();
 
-  // Extract drone MAC (dedup key)
-  char droneMac[18] = {0};
+  // Drone MAC (dedup key)
   char nodeIdBuf[8] = {0};
+  uint8_t mac[6];
 
-  if (extractJsonString(line, "mac", droneMac, sizeof(droneMac)) == 0) {
+  if (!JSON_HAS(f, JSON_KEY_MAC) || f->v[JSON_KEY_MAC].len != 17 ||
+      !parse_mac(f->v[JSON_KEY_MAC].p, mac)) {
     // No MAC field - not a drone detection JSON, forward as-is
     Serial.println(line);
     msgForwarded++;
     ledFlash();
-    return;
+    return true;
   }
 
-  extractJsonString(line, "node_id", nodeIdBuf, sizeof(nodeIdBuf));
+  if (JSON_HAS(f, JSON_KEY_NODE_ID)) {
+    int n = f->v[JSON_KEY_NODE_ID].len;
+    if (n > (int)sizeof(nodeIdBuf) - 1) n = sizeof(nodeIdBuf) - 1;
+    memcpy(nodeIdBuf, f->v[JSON_KEY_NODE_ID].p, n);
+  }
   msgReceived++;
 
+#if RSSI_FUSION
+  // Every copy counts for fusion, including the ones dedup drops below
+  if (nodeIdBuf[0] && JSON_HAS(f, JSON_KEY_RSSI)) {
+    rssi_fusion_sample(&fusion, mac, (uint16_t)strtoul(nodeIdBuf, nullptr, 16),
+                       (int)strtol(f->v[JSON_KEY_RSSI].p, nullptr, 10), now);
+  }
+#endif
+
   // Look up this drone in the dedup table
-  dedup_entry* entry = dedupFind(droneMac);
+  dedup_entry* entry = dedup_table_find(&dedupTable, mac);
+  bool newWindow;
 
   if (!entry) {
     // *** NEW DRONE - never seen before ***
-    // Forward immediately, zero delay
-    entry = dedupAlloc(droneMac);
-    entry->windowStart = now;
-    entry->lastSeen = now;
-    entry->dupsBlocked = 0;
-    strncpy(entry->firstNodeId, nodeIdBuf, sizeof(entry->firstNodeId) - 1);
+    entry = dedup_table_alloc(&dedupTable, mac, now);
+    newWindow = true;
+  } else {
+    // *** KNOWN DRONE ***
+    dedup_table_touch(&dedupTable, entry, now);
+    newWindow = (now - entry->window_start >= DEDUP_WINDOW_MS);
+  }
 
-    Serial.println(line);
-    msgForwarded++;
-    ledFlash();
-    return;
+  // Out-of-order copy: the sender captured it before data already seen
+  if (JSON_HAS(f, JSON_KEY_TS)) {
+    unsigned long ts = strtoul(f->v[JSON_KEY_TS].p, nullptr, 10);
+    if (ts < TIME_SYNC_HOUR_DS) {
+      if (entry->newest_ts != TIME_SYNC_NONE) {
+        int32_t age = time_sync_diff_ds(entry->newest_ts, (uint16_t)ts);
+        if (age > DEDUP_LATE_DS) {
+          msgLate++;
+          return false;
+        }
+        if (age < 0) entry->newest_ts = (uint16_t)ts;
+      } else {
+        entry->newest_ts = (uint16_t)ts;
+      }
+    }
   }
 
-  // *** KNOWN DRONE ***
-  entry->lastSeen = now;
+  if (newWindow) {
+#if DEDUP_CONTENT_HASH
+    if (entry->window_start != 0 && f->content_hash == entry->content_hash &&
+        now - entry->window_start < DEDUP_CONTENT_REFRESH_MS) {
+      // Nothing new since the last forwarded copy
+      msgSuppressed++;
+      msgSameContent++;
+      return true;
+    }
+#endif
+    entry->window_start = now;
+    entry->dups_blocked = 0;
+#if DEDUP_HOLDBACK_MS > 0
+    holdOpen(entry, line, f, nodeIdBuf, now);
+#else
+    // Forward immediately, zero delay
+    forwardWinner(entry, line, nodeIdBuf, f->content_hash);
+#endif
+    return true;
+  }
 
-  // Has the dedup window expired? First in for the new window wins.
-  if (now - entry->windowStart >= DEDUP_WINDOW_MS) {
-    entry->windowStart = now;
-    entry->dupsBlocked = 0;
-    strncpy(entry->firstNodeId, nodeIdBuf, sizeof(entry->firstNodeId) - 1);
+  // *** WITHIN DEDUP WINDOW ***
+#if DEDUP_HOLDBACK_MS > 0
+  hold_slot* held = holdFind(mac);
+  if (held) {
+    int32_t score = candidateScore(f, entry->content_hash);
+    if (score > held->score) {
+      holdStore(held, line, f, nodeIdBuf, score);
+      msgReplaced++;
+    }
+  }
+#endif
+  // One of the copies is dropped either way
+  if (entry->dups_blocked < UINT8_MAX) entry->dups_blocked++;
+  msgSuppressed++;
+  return true;
+}
 
-    Serial.println(line);
-    msgForwarded++;
-    ledFlash();
+// =============================================================================
+// Expand a binary mesh frame into mesh-mapper JSON and dedup it like any
+// other detection. Frames without basic_id reuse the cached one; keepalives
+// take their position from the drone's last full frame.
+// =============================================================================
+static void processMeshFrame(const char* line) {
+  id_data UAV;
+  uint16_t nodeNum = 0;
+  mesh_frame_kind kind = mesh_frame_from_text(line, &UAV, &nodeNum);
+  if (kind == MESH_FRAME_INVALID) {
+    msgBadFrames++;
     return;
   }
+  msgFrames++;
+
+  dedup_entry* entry = dedup_table_find(&dedupTable, UAV.mac);
+  if (kind == MESH_FRAME_KEEPALIVE) {
+    msgKeepalives++;
+    if (!entry || !entry->mesh_state.valid) {
+      // Nothing to rebuild from (home rebooted, full frame lost); the
+      // sender's next refresh brings the drone back
+      msgOrphanKeepalives++;
+      return;
+    }
+    mesh_frame_load_state(&entry->mesh_state, &UAV);
+  }
+  bool hasId = UAV.uav_id[0] != '\0';
+  if (!hasId && entry) {
+    strncpy(UAV.uav_id, entry->basic_id, ODID_ID_SIZE);
+  }
 
-  // *** WITHIN DEDUP WINDOW - DROP IT ***
-  entry->dupsBlocked++;
-  msgSuppressed++;
+  char nodeIdStr[8];
+  snprintf(nodeIdStr, sizeof(nodeIdStr), "%04X", nodeNum);
+  char json[LINE_BUF_SIZE];
+  int len = format_detection_json(json, sizeof(json), &UAV, DETECTION_JSON_TIME, nodeIdStr);
+  json_fields fields;
+  json_scan(json, len, &fields, DEDUP_WANT_HASH);
+  bool current = processJsonLine(json, &fields);
+
+  // A late full frame must not replace the state later keepalives expand to
+  if (current && kind == MESH_FRAME_FULL && (entry = dedup_table_find(&dedupTable, UAV.mac)) != nullptr) {
+    if (hasId) strncpy(entry->basic_id, UAV.uav_id, ODID_ID_SIZE);
+    mesh_frame_save_state(&entry->mesh_state, &UAV);
+  }
 }
 
 // =============================================================================
@@ -271,9 +517,13 @@ static void processJsonLine(const char* line, int len) {
 static void processLine(const char* line, int len) {
   if (len == 0) return;
 
-  if (looksLikeJSON(line, len)) {
+  json_fields fields;
+  if (json_scan(line, len, &fields, DEDUP_WANT_HASH)) {
     // JSON line -> run through dedup engine
-    processJsonLine(line, len);
+    processJsonLine(line, &fields);
+  } else if (strstr(line, MESH_FRAME_PREFIX)) {
+    // Binary frame (possibly behind a Meshtastic sender prefix)
+    processMeshFrame(line);
   } else {
     // Not JSON (Meshtastic debug output, status messages, etc.)
     Serial.print("[MESH] ");
@@ -292,15 +542,21 @@ void setup() {
   // USB Serial -> computer (mesh-mapper.py)
   Serial.begin(UART_BAUD);
 
-  // UART -> Heltec V3 (Meshtastic)
-  Serial1.begin(UART_BAUD, SERIAL_8N1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
+  // UART -> Heltec V3 (Meshtastic); RX events wake this (loop) task
+  uart_ingest_begin(&heltecUart, Serial1, UART_BAUD, SERIAL1_RX_PIN, SERIAL1_TX_PIN,
+                    xTaskGetCurrentTaskHandle());
 
   // LED
   pinMode(LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, HIGH);  // OFF (inverted)
 
   // Initialize dedup engine
-  dedupInit();
+  dedup_table_init(&dedupTable, millis());
+#if RSSI_FUSION
+  rssi_fusion_init(&fusion, FUSION_RSSI_1M, FUSION_PATH_LOSS_X10 / 10.0f, FUSION_WINDOW_MS,
+                   FUSION_MAX_AGE_MS);
+  int fusionNodes = rssi_fusion_parse_nodes(&fusion, FUSION_NODES);
+#endif
 
   Serial.println();
   Serial.println("================================================");
@@ -310,14 +566,17 @@ void setup() {
   Serial.println("================================================");
   Serial.println();
   Serial.printf("[HOME] Dedup: %dms window, %d max drones tracked\n",
-                DEDUP_WINDOW_MS, DEDUP_MAX_DRONES);
+                DEDUP_WINDOW_MS, DEDUP_TABLE_CAPACITY);
   Serial.printf("[HOME] UART pins: TX=GPIO%d  RX=GPIO%d  Baud=%d\n",
                 SERIAL1_TX_PIN, SERIAL1_RX_PIN, UART_BAUD);
+#if RSSI_FUSION
+  Serial.printf("[HOME] RSSI fusion: %d node positions, %dms window%s\n", fusionNodes,
+                FUSION_WINDOW_MS, fusionNodes < 2 ? " (needs 2+ nodes in FUSION_NODES)" : "");
+#endif
   Serial.println("[HOME] Listening for mesh data...\n");
 
   lastHeartbeat = millis();
   lastStats = millis();
-  lastCleanup = millis();
 
   // Quick LED triple-blink to show we're alive
   for (int i = 0; i < 3; i++) {
@@ -334,24 +593,8 @@ void setup() {
 void loop() {
   unsigned long now = millis();
 
-  // ----- Read from Heltec V3 UART, buffer lines -----
-  while (Serial1.available()) {
-    char c = Serial1.read();
-    totalBytes++;
-
-    if (c == '\n' || c == '\r') {
-      if (linePos > 0) {
-        lineBuf[linePos] = '\0';
-        processLine(lineBuf, linePos);
-        linePos = 0;
-      }
-    } else if (linePos < LINE_BUF_SIZE - 1) {
-      lineBuf[linePos++] = c;
-    } else {
-      // Buffer overflow - line too long, reset
-      linePos = 0;
-    }
-  }
+  // ----- Complete lines from Heltec V3 UART -----
+  uart_ingest_poll(&heltecUart, processLine);
 
   // ----- Forward USB Serial -> Heltec UART (bidirectional) -----
   // Allows mesh-mapper.py or user to send commands to the Heltec V3
@@ -363,40 +606,75 @@ void loop() {
   // ----- LED update -----
   ledUpdate();
 
-  // ----- Dedup stale entry cleanup (every 10s) -----
-  if (now - lastCleanup >= 10000) {
-    dedupCleanStale(now);
-    lastCleanup = now;
-  }
+#if DEDUP_HOLDBACK_MS > 0
+  // ----- Forward held winners whose holdback ended -----
+  holdFlush(now);
+#endif
+
+  // ----- Dedup stale entry cleanup (wheel slots that fell due) -----
+  dedupCleanStale(now);
+
+#if RSSI_FUSION
+  // ----- Solve fusion windows that closed -----
+  rssi_fusion_tick(&fusion, now);
+#endif
 
   // ----- Heartbeat -----
   if (now - lastHeartbeat >= HEARTBEAT_MS) {
-    // Count active tracked drones
-    int activeDrones = 0;
-    for (int i = 0; i < DEDUP_MAX_DRONES; i++) {
-      if (dedupTable[i].active) activeDrones++;
-    }
-    Serial.printf("{\"heartbeat\":\"home_node active\",\"tracked_drones\":%d}\n", activeDrones);
+    Serial.printf("{\"heartbeat\":\"home_node active\",\"tracked_drones\":%u}\n", dedupTable.count);
     lastHeartbeat = now;
   }
 
   // ----- Stats -----
   if (now - lastStats >= STATS_INTERVAL) {
     Serial.printf("[HOME] Stats: %u received, %u forwarded, %u suppressed, %u non-json, %u bytes\n",
-                  msgReceived, msgForwarded, msgSuppressed, msgNonJson, totalBytes);
+                  msgReceived, msgForwarded, msgSuppressed, msgNonJson, heltecUart.bytes);
+    Serial.printf("[HOME]   UART: %u lines, %u overruns, %u overlong, latency avg %luus max %luus\n",
+                  heltecUart.lines, heltecUart.overruns, heltecUart.overlong,
+                  (unsigned long)uart_ingest_latency_avg_us(&heltecUart),
+                  (unsigned long)heltecUart.latency_max_us);
+    Serial.printf("[HOME]   Mesh frames: %u decoded, %u rejected\n", msgFrames, msgBadFrames);
+    Serial.printf("[HOME]   Keepalives:  %u expanded, %u without state\n",
+                  msgKeepalives - msgOrphanKeepalives, msgOrphanKeepalives);
+    Serial.printf("[HOME]   Out of order: %u copies dropped\n", msgLate);
+#if RSSI_FUSION
+    Serial.printf("[HOME]   Fusion: %u samples, %u solved, %u single-node, %u unknown node, "
+                  "%u slot reuse, %u lines with estimate\n",
+                  fusion.samples, fusion.solved, fusion.single_node, fusion.unknown_node,
+                  fusion.slot_reuse, msgEstimated);
+#endif
+#if DEDUP_CONTENT_HASH
+    Serial.printf("[HOME]   Repeated content dropped: %u\n", msgSameContent);
+#endif
+#if DEDUP_HOLDBACK_MS > 0
+    Serial.printf("[HOME]   Holdback %dms: %u replaced by a better copy, %u overflowed\n",
+                  DEDUP_HOLDBACK_MS, msgReplaced, holdOverflow);
+#endif
+    for (int i = 0; i < nodeStatCount; i++) {
+      Serial.printf("[HOME]   Node %s: %u wins\n", nodeStats[i].nodeId, nodeStats[i].wins);
+    }
+    if (nodeStatOverflow) {
+      Serial.printf("[HOME]   Other nodes: %u wins\n", nodeStatOverflow);
+    }
+
+    Serial.printf("[HOME]   Dedup table: %u/%d drones, %u expired, %u evicted\n",
+                  dedupTable.count, DEDUP_TABLE_CAPACITY, dedupTable.expired, dedupTable.evictions);
 
     // Show active dedup entries
-    for (int i = 0; i < DEDUP_MAX_DRONES; i++) {
-      if (dedupTable[i].active) {
-        Serial.printf("[HOME]   Drone %s: first node %s, %u dups blocked, age %lus\n",
-                      dedupTable[i].mac, dedupTable[i].firstNodeId,
-                      dedupTable[i].dupsBlocked, (now - dedupTable[i].lastSeen) / 1000);
-      }
+    int shown = 0;
+    for (int i = 0; i < DEDUP_INDEX_SIZE && shown < STATS_MAX_DRONES; i++) {
+      if (dedupTable.index[i] == 0) continue;
+      const dedup_entry* e = &dedupTable.entries[dedupTable.index[i] - 1];
+      char macStr[18];
+      format_mac(macStr, e->mac);
+      Serial.printf("[HOME]   Drone %s: first node %s, %u dups blocked, age %lus\n",
+                    macStr, e->first_node_id, e->dups_blocked, (now - e->last_seen) / 1000);
+      shown++;
     }
 
     lastStats = now;
   }
 
-  // Small yield to prevent watchdog
-  delay(1);
+  // Sleep until the Heltec sends something (also yields to the watchdog)
+  uart_ingest_wait(&heltecUart, LOOP_IDLE_MS);
 }
@@ -4,12 +4,14 @@
  * colonelpanichacks
  *
  * Dual-core ESP32S3 firmware:
- *   Core 0: WiFi promiscuous packet sniffing (Open Drone ID NAN/Beacon)
- *   Core 1: BLE scanning (Open Drone ID BLE advertisements)
+ *   Core 0: WiFi promiscuous packet capture into a lock-free frame ring
+ *   Core 1: ODID decode of captured WiFi frames (NAN/Beacon)
+ *   NimBLE host: continuous passive BLE scan, ODID filtered in onResult
  *
- * Detected drone JSON is sent to:
- *   - USB Serial (for local monitoring / direct mesh-mapper.py connection)
- *   - Serial1 UART (GPIO5 TX / GPIO6 RX -> Heltec V3 running Meshtastic)
+ * Detections are sent to:
+ *   - USB Serial as JSON (local monitoring / direct mesh-mapper.py connection)
+ *   - Serial1 UART (GPIO5 TX / GPIO6 RX -> Heltec V3 running Meshtastic) as
+ *     compact "RIDB:" frames, expanded back to this JSON by the home node
  *
  * JSON format (matches mesh-mapper.py API, includes node_id for dedup):
  *   {"mac":"xx:xx:xx:xx:xx:xx","rssi":-50,"drone_lat":0.0,"drone_long":0.0,
@@ -24,18 +26,35 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
-#include <BLEDevice.h>
-#include <BLEUtils.h>
-#include <BLEScan.h>
+#include "dc_config.h"
+#include <NimBLEDevice.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <nvs_flash.h>
-#include "opendroneid.h"
-#include "odid_wifi.h"
+#include "frame_ring.h"
+#include "odid_decoder.h"
+#include "uav_tracker.h"
+#include "time_sync.h"
+#include "detection_json.h"
+#include "mesh_scheduler.h"
+#include "mesh_frame.h"
+#include "uart_ingest.h"
+#include "dc_metrics.h"
+#include "dc_task.h"
+#include "power_profile.h"
+#include "flash_log.h"
+#include "usb_record.h"
+#include <esp_pm.h>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+// The remote node is the mesh sender and scans both radios; dc_config.h
+// picks its board and task core only
+#if !DC_RADIO_BLE || !DC_OUT_MESH || USB_BINARY_OUTPUT
+#error "remote_node needs DC_RADIO_BLE=1, DC_OUT_MESH=1 and JSON USB output"
+#endif
+
 // =============================================================================
 // Pin Definitions
 // =============================================================================
@@ -46,264 +65,286 @@ static const int SERIAL1_RX_PIN = 6;   // GPIO6 <- Heltec TX
 // LED on XIAO ESP32S3 (active LOW / inverted logic)
 #define LED_PIN 21
 
+// =============================================================================
+// WiFi RX Capture Mode
+// =============================================================================
+// 1: the promiscuous callback only copies frames into wifiRing and
+//    wifiProcessTask decodes them on core 1.
+// 0: decode inside the WiFi driver's RX callback (legacy behaviour).
+#ifndef WIFI_DEFERRED_DECODE
+#define WIFI_DEFERRED_DECODE 1
+#endif
+
+// 1: BT5 extended scan on the 1M and Coded PHYs, so Long Range RemoteID
+//    broadcasters and their message packs are received alongside legacy
+//    advertisements. Needs -DCONFIG_BT_NIMBLE_EXT_ADV=1 (S3/C3/C5/C6 only).
+#ifndef BLE_EXTENDED_SCAN
+#define BLE_EXTENDED_SCAN 0
+#endif
+#if BLE_EXTENDED_SCAN && !CONFIG_BT_NIMBLE_EXT_ADV
+#error "BLE_EXTENDED_SCAN=1 needs -DCONFIG_BT_NIMBLE_EXT_ADV=1"
+#endif
+
+// Mesh uplink pacing: each drone at most every MESH_DRONE_INTERVAL_MS,
+// and no more than one Serial1 line per MESH_LINE_GAP_MS overall
+#ifndef MESH_DRONE_INTERVAL_MS
+#define MESH_DRONE_INTERVAL_MS 5000
+#endif
+#ifndef MESH_LINE_GAP_MS
+#define MESH_LINE_GAP_MS 1000
+#endif
+
+// 1: mesh uplink carries 32-byte RIDB: frames (mesh_frame.h) that the home
+//    node expands back to JSON. 0: full JSON line per detection.
+#ifndef MESH_BINARY_FRAMES
+#define MESH_BINARY_FRAMES 1
+#endif
+
+// 1: stamp detections with UTC from a clock synced to the drones' own ODID
+//    Location timestamps (time_sync.h): "ts" in the JSON, utc_ds in frames
+#ifndef TIME_SYNC
+#define TIME_SYNC 1
+#endif
+
+// 1: power-managed scanning for solar/battery nodes (power_profile.h).
+//    After POWER_QUIET_MS without a detection the radios only listen for
+//    POWER_BURST_MS every POWER_PERIOD_MS; the CPU scales between
+//    POWER_MIN_MHZ and 160 MHz and light-sleeps when the build allows it.
+#ifndef POWER_PROFILE
+#define POWER_PROFILE 0
+#endif
+#ifndef POWER_QUIET_MS
+#define POWER_QUIET_MS 120000
+#endif
+#ifndef POWER_BURST_MS
+#define POWER_BURST_MS 1500
+#endif
+#ifndef POWER_PERIOD_MS
+#define POWER_PERIOD_MS 10000
+#endif
+#ifndef POWER_MIN_MHZ
+#define POWER_MIN_MHZ 40
+#endif
+// Assumed draw of a XIAO ESP32S3 at 5 V in, for the status line estimate:
+// WiFi promiscuous + BLE scan, radios stopped in light sleep, and radios
+// stopped without light sleep (no CONFIG_PM_ENABLE in the core). These are
+// not measurements: they are the ESP32-S3 datasheet's RX and light-sleep
+// currents (its "Current Consumption" tables) rounded up for the board's
+// regulator, LED and USB bridge. Override them with figures measured on
+// your own node before trusting est_mah for a solar budget.
+#ifndef POWER_MA_LISTEN
+#define POWER_MA_LISTEN 105
+#endif
+#ifndef POWER_MA_SLEEP
+#define POWER_MA_SLEEP 3
+#endif
+#ifndef POWER_MA_IDLE
+#define POWER_MA_IDLE 28
+#endif
+
+// 1: keep detections in a flash ring (flash_log.h) while the node has no
+//    link, i.e. the Heltec has sent nothing for FLASH_LOG_LINK_MS and no
+//    USB host is attached. Each drone is logged at most every
+//    FLASH_LOG_DRONE_INTERVAL_MS, and only once it has changed (the mesh
+//    delta thresholds) or every FLASH_LOG_REFRESH_MS. The backlog goes out
+//    over USB as binary records when the host sends any line (mesh-mapper
+//    sends WATCHDOG_RESET when it opens the port) or LOG_REPLAY;
+//    LOG_REPLAY_ALL sends the whole ring, LOG_SKIP drops the backlog.
+//    FLASH_LOG_ALWAYS=1 logs with the link up too.
+#ifndef FLASH_LOG
+#define FLASH_LOG 1
+#endif
+#ifndef FLASH_LOG_PARTITION
+#define FLASH_LOG_PARTITION "spiffs"   // unused by this firmware in the stock table
+#endif
+#ifndef FLASH_LOG_LINK_MS
+#define FLASH_LOG_LINK_MS 60000
+#endif
+#ifndef FLASH_LOG_ALWAYS
+#define FLASH_LOG_ALWAYS 0
+#endif
+#ifndef FLASH_LOG_DRONE_INTERVAL_MS
+#define FLASH_LOG_DRONE_INTERVAL_MS 1000
+#endif
+#ifndef FLASH_LOG_REFRESH_MS
+#define FLASH_LOG_REFRESH_MS 30000
+#endif
+#ifndef FLASH_LOG_AUTO_REPLAY
+#define FLASH_LOG_AUTO_REPLAY 1
+#endif
+#ifndef FLASH_LOG_REPLAY_GAP_MS
+#define FLASH_LOG_REPLAY_GAP_MS 20     // between replay batches, for live lines
+#endif
+
 // =============================================================================
 // Unique Node ID (derived from ESP32 MAC at boot)
 // Used by home node to deduplicate detections from multiple remote nodes
 // =============================================================================
 static char nodeId[5] = "0000";  // 4-char hex, e.g. "A1B2"
+static uint16_t nodeIdNum = 0;     // same ID as carried in binary mesh frames
 
 static void generateNodeId() {
   uint8_t mac[6];
   esp_efuse_mac_get_default(mac);
   // Use last 2 bytes of factory MAC -> unique 4-hex-char ID per board
   snprintf(nodeId, sizeof(nodeId), "%02X%02X", mac[4], mac[5]);
+  nodeIdNum = (uint16_t)((mac[4] << 8) | mac[5]);
 }
 
 // =============================================================================
 // UAV Tracking
 // =============================================================================
-struct uav_data {
-  uint8_t  mac[6];
-  int      rssi;
-  uint32_t last_seen;
-  char     op_id[ODID_ID_SIZE + 1];
-  char     uav_id[ODID_ID_SIZE + 1];
-  double   lat_d;
-  double   long_d;
-  double   base_lat_d;
-  double   base_long_d;
-  int      altitude_msl;
-  int      height_agl;
-  int      speed;
-  int      heading;
-  int      flag;
-};
-
-#define MAX_UAVS 8
-static uav_data uavs[MAX_UAVS] = {0};
-static BLEScan* pBLEScan = nullptr;
-static ODID_UAS_Data UAS_data;
+static uav_tracker tracker;
+#if TIME_SYNC
+static time_sync timeSync;   // fed through the tracker
+#endif
+static NimBLEScan* pBLEScan = nullptr;
 static unsigned long last_status = 0;
 
-// Thread-safe print queue (BLE callback + WiFi ISR -> printer task)
-static QueueHandle_t printQueue;
+// Per-task decode contexts: BLE callback and WiFi decode never share state
+static odid_decoder bleDecoder;
+static odid_decoder wifiDecoder;
+
+// ODID advertisements received on the Coded PHY (NimBLE host task only)
+static uint32_t bleCodedHits = 0;
+
+#if DC_METRICS
+// Latency histogram (printer task) and the tasks reported in {"metrics":...}
+static dc_metrics metrics;
+static unsigned long last_metrics = 0;
+#endif
+
+// Printer task, woken when the tracker's dirty set goes non-empty
+static TaskHandle_t printerHandle = nullptr;
+DC_STATIC_TASK(printer, DC_STACK_PRINTER);
+
+// Per-drone mesh uplink schedule (printer task only)
+static mesh_scheduler meshSched;
+
+// Raw frame ring (WiFi RX callback -> WiFi decode task)
+static frame_ring wifiRing;
+static TaskHandle_t wifiProcessHandle = nullptr;
+#if WIFI_DEFERRED_DECODE
+DC_STATIC_TASK(wifiProcess, DC_STACK_WIFI_DECODE);
+#endif
+
+#if POWER_PROFILE
+// Radio duty cycle; the printer reports detections, loop() applies it
+static power_profile power;
+static TaskHandle_t loopHandle = nullptr;
+#endif
+// False while the power profile has the radios stopped
+static volatile bool bleScanWanted = true;
+
+#if FLASH_LOG
+// Flash ring, owned by the log writer task. The printer feeds logSched
+// while logWanted; the writer takes the paced drone states from it.
+static flash_log flashLog;
+static mesh_scheduler logSched;
+static volatile bool logWanted = false;
+static TaskHandle_t logWriterHandle = nullptr;
+DC_STATIC_TASK(logWriter, DC_STACK_FLASH_LOG);
+
+// Notification bits from the USB command reader
+#define LOG_CMD_HOST        0x01   // any line: replay if FLASH_LOG_AUTO_REPLAY
+#define LOG_CMD_REPLAY      0x02
+#define LOG_CMD_REPLAY_ALL  0x04
+#define LOG_CMD_SKIP        0x08
+
+static_assert(2 + USB_RECORD_DETECTION_MAX <= FLASH_LOG_DATA_MAX,
+              "a logged detection must fit a flash_log entry");
+#endif
 
 // Forward declarations
 void callback(void *, wifi_promiscuous_pkt_type_t);
+static void process_wifi_frame(uint8_t *payload, int length, int rssi, uint8_t channel,
+                               uint32_t rx_us);
 
-// =============================================================================
-// UAV Slot Management
-// =============================================================================
-static uav_data* next_uav(uint8_t* mac) {
-  // First: find existing entry for this MAC
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (memcmp(uavs[i].mac, mac, 6) == 0)
-      return &uavs[i];
-  }
-  // Second: find empty slot
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (uavs[i].mac[0] == 0)
-      return &uavs[i];
-  }
-  // Fallback: evict oldest entry
-  uint32_t oldest_time = UINT32_MAX;
-  int oldest_idx = 0;
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (uavs[i].last_seen < oldest_time) {
-      oldest_time = uavs[i].last_seen;
-      oldest_idx = i;
-    }
-  }
-  return &uavs[oldest_idx];
+// Wake the printer when a store made the tracker's dirty set non-empty
+static void wake_printer(bool wake) {
+  if (wake && printerHandle) xTaskNotifyGive(printerHandle);
 }
 
 // =============================================================================
 // BLE Advertisement Callback - Open Drone ID over BLE
+// Continuous passive scan, duplicate filter off, no result list: every
+// advertisement lands here once and is dropped unless it is ODID.
 // =============================================================================
-class DroneIDCallback : public BLEAdvertisedDeviceCallbacks {
+class DroneIDCallback : public NimBLEScanCallbacks {
 public:
-  void onResult(BLEAdvertisedDevice device) override {
-    int len = device.getPayloadLength();
-    if (len <= 5) return;
-
-    uint8_t* payload = device.getPayload();
-    // Check for ODID BLE service data: type=0x16, UUID=0xFFFA, counter=0x0D
-    if (payload[1] != 0x16 || payload[2] != 0xFA ||
-        payload[3] != 0xFF || payload[4] != 0x0D) return;
-
-    uint8_t* mac = (uint8_t*)device.getAddress().getNative();
-    uav_data* UAV = next_uav(mac);
-    UAV->last_seen = millis();
-    UAV->rssi = device.getRSSI();
-    UAV->flag = 1;
-    memcpy(UAV->mac, mac, 6);
-
-    uint8_t* odid = &payload[6];
-    switch (odid[0] & 0xF0) {
-      case 0x00: {  // Basic ID
-        ODID_BasicID_data basic;
-        decodeBasicIDMessage(&basic, (ODID_BasicID_encoded*)odid);
-        strncpy(UAV->uav_id, (char*)basic.UASID, ODID_ID_SIZE);
-        break;
-      }
-      case 0x10: {  // Location
-        ODID_Location_data loc;
-        decodeLocationMessage(&loc, (ODID_Location_encoded*)odid);
-        UAV->lat_d = loc.Latitude;
-        UAV->long_d = loc.Longitude;
-        UAV->altitude_msl = (int)loc.AltitudeGeo;
-        UAV->height_agl = (int)loc.Height;
-        UAV->speed = (int)loc.SpeedHorizontal;
-        UAV->heading = (int)loc.Direction;
-        break;
-      }
-      case 0x40: {  // System (operator location)
-        ODID_System_data sys;
-        decodeSystemMessage(&sys, (ODID_System_encoded*)odid);
-        UAV->base_lat_d = sys.OperatorLatitude;
-        UAV->base_long_d = sys.OperatorLongitude;
-        break;
-      }
-      case 0x50: {  // Operator ID
-        ODID_OperatorID_data op;
-        decodeOperatorIDMessage(&op, (ODID_OperatorID_encoded*)odid);
-        strncpy(UAV->op_id, (char*)op.OperatorId, ODID_ID_SIZE);
-        break;
-      }
-    }
+  void onResult(const NimBLEAdvertisedDevice* device) override {
+    uint32_t rx_us = micros();
+    // ODID BLE service data: type=0x16, UUID=0xFFFA, counter=0x0D
+    const std::vector<uint8_t>& payload = device->getPayload();
+    if (odid_decode_ble_adv(&bleDecoder, payload.data(),
+                            (int)payload.size()) == ODID_FRAME_NONE) return;
+
+    // NimBLE stores the address LSB first; report it in display order
+    const uint8_t* addr = device->getAddress().getBase()->val;
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++) mac[i] = addr[5 - i];
+    wake_printer(uav_tracker_store(&tracker, mac, device->getRSSI(), BAND_BLE, 0, rx_us,
+                                   &bleDecoder.fields, nullptr));
+#if BLE_EXTENDED_SCAN
+    if (device->getPrimaryPhy() == BLE_HCI_LE_PHY_CODED) bleCodedHits++;
+#endif
+  }
 
-    // Queue for printing (non-blocking, ISR-safe)
-    uav_data tmp = *UAV;
-    BaseType_t woken = pdFALSE;
-    xQueueSendFromISR(printQueue, &tmp, &woken);
-    if (woken) portYIELD_FROM_ISR();
+  // A duration-0 scan only ends if the host resets it; resume straight away
+  // unless the power profile stopped it
+  void onScanEnd(const NimBLEScanResults& results, int reason) override {
+    if (bleScanWanted) pBLEScan->start(0, false, true);
   }
 };
 
 // =============================================================================
-// WiFi Promiscuous Callback - Open Drone ID over WiFi (NAN + Beacon)
+// WiFi Promiscuous Callback - capture only, decode happens in wifiProcessTask
 // =============================================================================
 void callback(void *buffer, wifi_promiscuous_pkt_type_t type) {
   if (type != WIFI_PKT_MGMT) return;
 
   wifi_promiscuous_pkt_t *packet = (wifi_promiscuous_pkt_t *)buffer;
-  uint8_t *payload = packet->payload;
   int length = packet->rx_ctrl.sig_len;
 
-  // --- NAN Action Frame (WiFi Aware / Neighbor Awareness Networking) ---
-  static const uint8_t nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
-  if (memcmp(nan_dest, &payload[4], 6) == 0) {
-    if (odid_wifi_receive_message_pack_nan_action_frame(&UAS_data, nullptr, payload, length) == 0) {
-      uav_data UAV;
-      memset(&UAV, 0, sizeof(UAV));
-      memcpy(UAV.mac, &payload[10], 6);
-      UAV.rssi = packet->rx_ctrl.rssi;
-      UAV.last_seen = millis();
-
-      if (UAS_data.BasicIDValid[0])
-        strncpy(UAV.uav_id, (char *)UAS_data.BasicID[0].UASID, ODID_ID_SIZE);
-      if (UAS_data.LocationValid) {
-        UAV.lat_d = UAS_data.Location.Latitude;
-        UAV.long_d = UAS_data.Location.Longitude;
-        UAV.altitude_msl = (int)UAS_data.Location.AltitudeGeo;
-        UAV.height_agl = (int)UAS_data.Location.Height;
-        UAV.speed = (int)UAS_data.Location.SpeedHorizontal;
-        UAV.heading = (int)UAS_data.Location.Direction;
-      }
-      if (UAS_data.SystemValid) {
-        UAV.base_lat_d = UAS_data.System.OperatorLatitude;
-        UAV.base_long_d = UAS_data.System.OperatorLongitude;
-      }
-      if (UAS_data.OperatorIDValid)
-        strncpy(UAV.op_id, (char *)UAS_data.OperatorID.OperatorId, ODID_ID_SIZE);
-
-      uav_data* stored = next_uav(UAV.mac);
-      *stored = UAV;
-      stored->flag = 1;
-
-      uav_data tmp = *stored;
-      BaseType_t woken = pdFALSE;
-      xQueueSendFromISR(printQueue, &tmp, &woken);
-      if (woken) portYIELD_FROM_ISR();
-    }
-    return;
+#if WIFI_DEFERRED_DECODE
+  if (frame_ring_push(&wifiRing, packet->payload, length, packet->rx_ctrl.rssi,
+                      packet->rx_ctrl.channel, 0, micros()) &&
+      wifiProcessHandle) {
+    // Every frame, not just into an empty ring (frame_ring.h). The callback
+    // runs in the WiFi driver task, not an ISR: a plain notify switches to
+    // the decode task straight away if it should
+    xTaskNotifyGive(wifiProcessHandle);
   }
+#else
+  process_wifi_frame(packet->payload, length, packet->rx_ctrl.rssi, packet->rx_ctrl.channel,
+                     micros());
+#endif
+}
 
-  // --- Beacon Frame with ODID vendor-specific IE ---
-  if (payload[0] == 0x80) {
-    int offset = 36;
-    while (offset < length) {
-      int typ = payload[offset];
-      int len = payload[offset + 1];
-      if (offset + len + 2 > length) break;  // bounds check
-
-      if ((typ == 0xdd) &&
-          (((payload[offset + 2] == 0x90 && payload[offset + 3] == 0x3a && payload[offset + 4] == 0xe6)) ||
-           ((payload[offset + 2] == 0xfa && payload[offset + 3] == 0x0b && payload[offset + 4] == 0xbc)))) {
-        int j = offset + 7;
-        if (j < length) {
-          memset(&UAS_data, 0, sizeof(UAS_data));
-          odid_message_process_pack(&UAS_data, &payload[j], length - j);
-
-          uav_data UAV;
-          memset(&UAV, 0, sizeof(UAV));
-          memcpy(UAV.mac, &payload[10], 6);
-          UAV.rssi = packet->rx_ctrl.rssi;
-          UAV.last_seen = millis();
-
-          if (UAS_data.BasicIDValid[0])
-            strncpy(UAV.uav_id, (char *)UAS_data.BasicID[0].UASID, ODID_ID_SIZE);
-          if (UAS_data.LocationValid) {
-            UAV.lat_d = UAS_data.Location.Latitude;
-            UAV.long_d = UAS_data.Location.Longitude;
-            UAV.altitude_msl = (int)UAS_data.Location.AltitudeGeo;
-            UAV.height_agl = (int)UAS_data.Location.Height;
-            UAV.speed = (int)UAS_data.Location.SpeedHorizontal;
-            UAV.heading = (int)UAS_data.Location.Direction;
-          }
-          if (UAS_data.SystemValid) {
-            UAV.base_lat_d = UAS_data.System.OperatorLatitude;
-            UAV.base_long_d = UAS_data.System.OperatorLongitude;
-          }
-          if (UAS_data.OperatorIDValid)
-            strncpy(UAV.op_id, (char *)UAS_data.OperatorID.OperatorId, ODID_ID_SIZE);
-
-          uav_data* stored = next_uav(UAV.mac);
-          *stored = UAV;
-          stored->flag = 1;
-
-          uav_data tmp = *stored;
-          BaseType_t woken = pdFALSE;
-          xQueueSendFromISR(printQueue, &tmp, &woken);
-          if (woken) portYIELD_FROM_ISR();
-        }
-      }
-      offset += len + 2;
-    }
-  }
+// =============================================================================
+// WiFi Frame Decoder - Open Drone ID over WiFi (NAN + Beacon)
+// =============================================================================
+static void process_wifi_frame(uint8_t *payload, int length, int rssi, uint8_t channel,
+                               uint32_t rx_us) {
+  if (odid_decode_wifi_frame(&wifiDecoder, payload, length) == ODID_FRAME_NONE) return;
+
+  wake_printer(uav_tracker_store(&tracker, wifiDecoder.mac, rssi, BAND_2_4GHZ, channel,
+                                 rx_us, &wifiDecoder.fields, nullptr));
 }
 
 // =============================================================================
 // JSON Builder (shared format for USB + mesh, includes node_id)
 // =============================================================================
-static int buildJson(char *buf, size_t bufSize, const uav_data *UAV) {
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-
-  return snprintf(buf, bufSize,
-    "{\"mac\":\"%s\",\"rssi\":%d,\"drone_lat\":%.6f,\"drone_long\":%.6f,"
-    "\"drone_altitude\":%d,\"pilot_lat\":%.6f,\"pilot_long\":%.6f,"
-    "\"basic_id\":\"%s\",\"node_id\":\"%s\"}",
-    mac_str, UAV->rssi, UAV->lat_d, UAV->long_d, UAV->altitude_msl,
-    UAV->base_lat_d, UAV->base_long_d, UAV->uav_id, nodeId);
+static int buildJson(char *buf, size_t bufSize, const id_data *UAV) {
+  return format_detection_json(buf, bufSize, UAV,
+                               DETECTION_JSON_PLAUS | (TIME_SYNC ? DETECTION_JSON_TIME : 0),
+                               nodeId);
 }
 
 // =============================================================================
 // JSON Output - Sends to USB Serial + UART (Heltec V3 mesh)
 // =============================================================================
-static void send_json(const uav_data *UAV) {
+static void send_json(const id_data *UAV) {
   char json[300];
   buildJson(json, sizeof(json), UAV);
 
@@ -314,84 +355,267 @@ static void send_json(const uav_data *UAV) {
   digitalWrite(LED_PIN, LOW);   // ON (inverted)
 }
 
-// Send to Heltec V3 over UART as fast as possible - let Meshtastic
-// handle its own queuing and channel throttling, we don't rate-limit here.
-static void send_to_mesh(const uav_data *UAV) {
-  char json[300];
-  int len = buildJson(json, sizeof(json), UAV);
+// Send to Heltec V3 over UART. Called only when the mesh scheduler
+// releases a drone, so LoRa airtime is shared fairly between drones.
+// sends: earlier mesh lines for this drone (drives basic_id cadence).
+// A keepalive is a 12-byte frame in binary mode, the full line in JSON.
+static void send_to_mesh(const id_data *UAV, mesh_part part, uint16_t sends) {
+#if MESH_BINARY_FRAMES
+  char line[MESH_FRAME_TEXT_MAX];
+  int len = part == MESH_PART_KEEPALIVE
+                ? mesh_frame_keepalive_to_text(line, sizeof(line), UAV, nodeIdNum)
+                : mesh_frame_to_text(line, sizeof(line), UAV, nodeIdNum,
+                                     sends % MESH_FRAME_ID_EVERY == 0);
+#else
+  char line[300];
+  int len = buildJson(line, sizeof(line), UAV);
+  (void)part;
+  (void)sends;
+#endif
 
-  if (Serial1.availableForWrite() >= len) {
-    Serial1.println(json);
+  if (len > 0 && Serial1.availableForWrite() >= len) {
+    Serial1.println(line);
   }
 }
 
+static void service_mesh() {
+  id_data UAV;
+  uint16_t sends = 0;
+  mesh_part part = mesh_scheduler_next(&meshSched, millis(), &UAV, &sends);
+  if (part != MESH_PART_NONE) send_to_mesh(&UAV, part, sends);
+}
+
 // =============================================================================
 // FreeRTOS Tasks
 // =============================================================================
 
-// Printer task: dequeues UAV data and outputs JSON (runs on core 1)
+// Printer task: drains dirty drones from the tracker and outputs JSON (runs on core 1)
 static void printerTask(void *param) {
-  uav_data UAV;
+  id_data UAV;
   for (;;) {
-    if (xQueueReceive(printQueue, &UAV, portMAX_DELAY)) {
+    // Woken by a store into an empty dirty set; the 100 ms timeout keeps
+    // mesh lines and rate-limited drones (UAV_PRINT_INTERVAL_MS) moving
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    while (uav_tracker_next_dirty(&tracker, millis(), &UAV)) {
       send_json(&UAV);
-      send_to_mesh(&UAV);
+#if DC_METRICS
+      dc_latency_record(&metrics.latency, micros() - UAV.capture_us);
+#endif
+      mesh_scheduler_update(&meshSched, &UAV);
+#if FLASH_LOG
+      if (logWanted) mesh_scheduler_update(&logSched, &UAV);
+#endif
+#if POWER_PROFILE
+      if (power_profile_detection(&power, millis()) && loopHandle) xTaskNotifyGive(loopHandle);
+#endif
     }
+    service_mesh();
   }
 }
 
-// BLE scan task (runs on core 1)
-static void bleScanTask(void *param) {
+#if WIFI_DEFERRED_DECODE
+// WiFi processing task - drains the raw frame ring and decodes (runs on core 1).
+// Not created when callback() decodes inline.
+static void wifiProcessTask(void *param) {
   for (;;) {
-    BLEScanResults results = pBLEScan->start(1, false);
-    pBLEScan->clearResults();
-    delay(100);
+    // Woken by callback() for each pushed frame; drain the whole batch
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    captured_frame *frame;
+    while ((frame = frame_ring_peek(&wifiRing)) != nullptr) {
+      process_wifi_frame(frame->data, frame->length, frame->rssi, frame->channel,
+                         frame->timestamp);
+      frame_ring_release(&wifiRing);
+    }
   }
 }
+#endif
 
-// WiFi processing task - just keeps the task alive (runs on core 0)
-static void wifiProcessTask(void *param) {
+// UART forward task: anything the Heltec sends back gets echoed to USB
+// (mesh acknowledgments, Meshtastic debug output, etc.). Sleeps until the
+// UART driver reports data rather than polling.
+static uart_ingest heltecUart;
+DC_STATIC_TASK(uartForward, DC_STACK_UART_FW);
+
+static void echoHeltecLine(const char *line, int len) {
+  Serial.println(line);
+}
+
+static void uartForwardTask(void *param) {
+  heltecUart.consumer = xTaskGetCurrentTaskHandle();
   for (;;) {
-    delay(10);
+    uart_ingest_wait(&heltecUart, 1000);
+    uart_ingest_poll(&heltecUart, echoHeltecLine);
   }
 }
 
-// UART forward task: anything the Heltec sends back gets echoed to USB
-// (mesh acknowledgments, Meshtastic debug output, etc.)
-static void uartForwardTask(void *param) {
-  static char lineBuf[512];
-  static int linePos = 0;
+#if FLASH_LOG
+// =============================================================================
+// Flash Log - detections survive a lost link (flash_log.h)
+// =============================================================================
+// Up while the Heltec has sent a line within FLASH_LOG_LINK_MS (the first
+// FLASH_LOG_LINK_MS after boot count as heard) or a USB host is attached.
+// The Heltec is only known to be there by what it sends, so a quiet mesh
+// reads as a lost one and gets logged.
+static bool link_up(uint32_t now) {
+  static uint32_t lines = 0, heardMs = 0;
+  if (heltecUart.lines != lines) {
+    lines = heltecUart.lines;
+    heardMs = now;
+  }
+  return now - heardMs < FLASH_LOG_LINK_MS || (bool)Serial;
+}
+
+// Entry data: utc_ds, then the binary USB detection payload
+static void log_detection(const id_data *UAV, uint32_t now) {
+  uint8_t data[2 + USB_RECORD_DETECTION_MAX];
+  data[0] = (uint8_t)UAV->utc_ds;
+  data[1] = (uint8_t)(UAV->utc_ds >> 8);
+  int len = usb_record_detection_payload(&data[2], sizeof(data) - 2, UAV);
+  if (len > 0) flash_log_append(&flashLog, data, 2 + len, now);
+}
 
+// Everything after the replay cursor out over USB as logged records, one
+// write per batch with a gap for the printer's live lines, then the
+// cursor is marked so a reboot does not send it again.
+static void replay_log() {
+  static uint8_t batch[USB_BATCH_SIZE];
+  size_t len = 0;
+  uint32_t entries = 0;
+  flash_log_entry e;
+  flash_log_flush(&flashLog);
+  while (flash_log_replay_next(&flashLog, &e)) {
+    if (e.len < 2) continue;
+    if (len + USB_RECORD_LOGGED_MAX_LEN > sizeof(batch)) {
+      Serial.write(batch, len);
+      len = 0;
+      vTaskDelay(pdMS_TO_TICKS(FLASH_LOG_REPLAY_GAP_MS));
+    }
+    // millis() of an earlier boot says nothing about the age
+    uint32_t age = e.boot == flashLog.boot ? (millis() - e.ms) / 1000 : USB_RECORD_AGE_UNKNOWN;
+    uint16_t utc = (uint16_t)(e.data[0] | (e.data[1] << 8));
+    len += usb_record_encode_logged(batch + len, sizeof(batch) - len, &e.data[2], e.len - 2,
+                                    age, utc);
+    entries++;
+  }
+  if (len > 0) Serial.write(batch, len);
+  flash_log_mark(&flashLog, millis());
+  Serial.printf("{\"flash_log_replay\":{\"entries\":%u}}\n", (unsigned)entries);
+}
+
+// Log writer: lowest priority, so flash writes only take time the RX and
+// output tasks leave over. Woken by USB commands, else every 200 ms.
+static void logWriterTask(void *param) {
+  id_data UAV;
   for (;;) {
-    while (Serial1.available()) {
-      char c = Serial1.read();
-      if (c == '\n' || c == '\r') {
-        if (linePos > 0) {
-          lineBuf[linePos] = '\0';
-          Serial.println(lineBuf);
-          linePos = 0;
-        }
-      } else if (linePos < (int)sizeof(lineBuf) - 1) {
-        lineBuf[linePos++] = c;
-      }
+    uint32_t cmd = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &cmd, pdMS_TO_TICKS(200));
+    uint32_t now = millis();
+    logWanted = FLASH_LOG_ALWAYS || !link_up(now);
+
+    mesh_part part;
+    while ((part = mesh_scheduler_next(&logSched, now, &UAV, nullptr)) != MESH_PART_NONE)
+      if (part == MESH_PART_DRONE) log_detection(&UAV, now);
+    flash_log_service(&flashLog, now);
+
+    if (cmd & LOG_CMD_SKIP) {
+      flash_log_skip(&flashLog);
+      flash_log_mark(&flashLog, now);
+    } else if (cmd & LOG_CMD_REPLAY_ALL) {
+      flash_log_rewind(&flashLog);
+      replay_log();
+    } else if ((cmd & LOG_CMD_REPLAY) ||
+               (FLASH_LOG_AUTO_REPLAY && (cmd & LOG_CMD_HOST) &&
+                flash_log_pending_bytes(&flashLog) > 0)) {
+      replay_log();
     }
-    delay(10);
   }
 }
 
+// Lines from the USB host, turned into log writer commands
+static void poll_usb_commands() {
+  static char line[32];
+  static uint8_t len = 0;
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (len < sizeof(line) - 1) line[len++] = c;
+      continue;
+    }
+    if (len == 0) continue;
+    line[len] = '\0';
+    len = 0;
+    uint32_t cmd = LOG_CMD_HOST;
+    if (strcmp(line, "LOG_REPLAY") == 0) cmd = LOG_CMD_REPLAY;
+    else if (strcmp(line, "LOG_REPLAY_ALL") == 0) cmd = LOG_CMD_REPLAY_ALL;
+    else if (strcmp(line, "LOG_SKIP") == 0) cmd = LOG_CMD_SKIP;
+    if (logWriterHandle) xTaskNotify(logWriterHandle, cmd, eSetBits);
+  }
+}
+#endif
+
+// =============================================================================
+// Power Profile
+// =============================================================================
+#if POWER_PROFILE
+// Dynamic frequency scaling with automatic light sleep. Needs CONFIG_PM_ENABLE
+// (and tickless idle for the sleep) in the core's sdkconfig; returns false,
+// leaving the fixed 160 MHz clock, when the build lacks it.
+static bool power_enable_pm() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_pm_config_t pm = {};
+#else
+  esp_pm_config_esp32s3_t pm = {};
+#endif
+  pm.max_freq_mhz = 160;
+  pm.min_freq_mhz = POWER_MIN_MHZ;
+  pm.light_sleep_enable = true;
+  return esp_pm_configure(&pm) == ESP_OK;
+}
+
+// Start or stop both radios for the sentinel duty cycle. WiFi is stopped
+// outright (promiscuous off alone keeps the RF front end on).
+static void power_apply_radios(bool on) {
+  if (on) {
+    esp_wifi_start();
+    esp_wifi_set_promiscuous(true);
+    esp_wifi_set_channel(6, WIFI_SECOND_CHAN_NONE);
+    bleScanWanted = true;
+    pBLEScan->start(0, false, true);
+  } else {
+    bleScanWanted = false;
+    pBLEScan->stop();
+    esp_wifi_set_promiscuous(false);
+    esp_wifi_stop();
+  }
+}
+#endif
+
+#if DC_METRICS
+// Boot-time memory picture; the metrics record repeats the heap figures
+static void report_footprint() {
+  char json[512];
+  int len = dc_metrics_format_footprint(&metrics, json, sizeof(json));
+  if (len < (int)sizeof(json)) Serial.println(json);
+}
+#endif
+
 // =============================================================================
 // Arduino Entry Points
 // =============================================================================
 void setup() {
   delay(3000);  // Boot delay (Meshtastic serial init timing)
   setCpuFrequencyMhz(160);
+#if POWER_PROFILE
+  bool lightSleep = power_enable_pm();
+#endif
 
   // Generate unique node ID from ESP32 factory MAC
   generateNodeId();
 
   // Serial init
   Serial.begin(115200);
-  Serial1.begin(115200, SERIAL_8N1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
+  // Heltec link; uartForwardTask registers itself for the RX events
+  uart_ingest_begin(&heltecUart, Serial1, 115200, SERIAL1_RX_PIN, SERIAL1_TX_PIN, nullptr);
 
   // LED init
   pinMode(LED_PIN, OUTPUT);
@@ -416,35 +640,174 @@ void setup() {
   Serial.println("[REMOTE] WiFi promiscuous mode active (ch6)");
 
   // BLE scanner for ODID BLE advertisements
-  BLEDevice::init("DroneID");
-  pBLEScan = BLEDevice::getScan();
-  pBLEScan->setAdvertisedDeviceCallbacks(new DroneIDCallback());
-  pBLEScan->setActiveScan(true);
+  NimBLEDevice::init("DroneID");
+  pBLEScan = NimBLEDevice::getScan();
+  static DroneIDCallback bleCallbacks;
+  pBLEScan->setScanCallbacks(&bleCallbacks, true);
+  pBLEScan->setDuplicateFilter(0);
+  pBLEScan->setMaxResults(0);
+  pBLEScan->setActiveScan(false);
   pBLEScan->setInterval(100);
-  pBLEScan->setWindow(99);
-  Serial.println("[REMOTE] BLE scanner active");
+  pBLEScan->setWindow(100);
+#if BLE_EXTENDED_SCAN
+  // Scan windows alternate between the 1M and Coded PHYs
+  pBLEScan->setPhy(NimBLEScan::SCAN_ALL);
+#endif
 
-  // Print queue (ISR-safe bridge between callbacks and printer task)
-  printQueue = xQueueCreate(MAX_UAVS * 2, sizeof(uav_data));
+  // Mesh uplink schedule.
+  // Pilot position is already in the JSON line, so no separate pilot line
+  mesh_scheduler_init(&meshSched, MESH_DRONE_INTERVAL_MS, MESH_LINE_GAP_MS, false);
 
-  // Clear tracking array
-  memset(uavs, 0, sizeof(uavs));
+  // Allocate the UAV table and clear decode contexts
+  if (!uav_tracker_init(&tracker))
+    Serial.println("[!] UAV table allocation failed");
+#if TIME_SYNC
+  time_sync_init(&timeSync);
+  tracker.clock = &timeSync;
+#endif
+  odid_decoder_init(&bleDecoder);
+  odid_decoder_init(&wifiDecoder);
+  frame_ring_init(&wifiRing);
+
+#if FLASH_LOG
+  // Every due drone that changed is logged in full; the refresh doubles
+  // as the keepalive, so no keepalives come out
+  mesh_scheduler_init(&logSched, FLASH_LOG_DRONE_INTERVAL_MS, 0, false);
+  logSched.keepalive_ms = FLASH_LOG_REFRESH_MS;
+  logSched.refresh_ms = FLASH_LOG_REFRESH_MS;
+  if (flash_log_open_partition(&flashLog, FLASH_LOG_PARTITION))
+    Serial.printf("[REMOTE] Flash log: %u KB, boot %u, %u KB to replay\n",
+                  (unsigned)(flashLog.sectors * (FLASH_LOG_SECTOR_SIZE / 1024)),
+                  (unsigned)flashLog.boot,
+                  (unsigned)((flash_log_pending_bytes(&flashLog) + 1023) / 1024));
+  else
+    Serial.println("[!] Flash log: no \"" FLASH_LOG_PARTITION "\" partition, logging off");
+#endif
+
+  // Launch FreeRTOS tasks on core 1 (DC_CORE_WORK); stacks and TCBs are
+  // static (dc_task.h)
+#if WIFI_DEFERRED_DECODE
+  wifiProcessHandle = DC_START_TASK(wifiProcess, wifiProcessTask, "WiFi", 2, DC_CORE_WORK);
+#endif
+  printerHandle = DC_START_TASK(printer, printerTask, "Print", 1, DC_CORE_WORK);
+  TaskHandle_t uartForwardHandle =
+      DC_START_TASK(uartForward, uartForwardTask, "UART_FW", 1, DC_CORE_WORK);
+#if FLASH_LOG
+  if (flashLog.mounted)
+    logWriterHandle = DC_START_TASK(logWriter, logWriterTask, "FlashLog", 0, DC_CORE_WORK);
+#endif
+#if DC_METRICS
+  dc_metrics_init(&metrics);
+#if WIFI_DEFERRED_DECODE
+  dc_metrics_add_task(&metrics, "wifi", wifiProcessHandle, DC_TASK_STACK_BYTES(wifiProcess));
+#endif
+  dc_metrics_add_task(&metrics, "printer", printerHandle, DC_TASK_STACK_BYTES(printer));
+  dc_metrics_add_task(&metrics, "uart_fw", uartForwardHandle, DC_TASK_STACK_BYTES(uartForward));
+#if FLASH_LOG
+  dc_metrics_add_task(&metrics, "flash_log", logWriterHandle, DC_TASK_STACK_BYTES(logWriter));
+#endif
+  dc_metrics_add_task(&metrics, "loop", xTaskGetCurrentTaskHandle(), DC_LOOP_STACK_BYTES);
+#else
+  (void)uartForwardHandle;
+#endif
 
-  // Launch FreeRTOS tasks on separate cores
-  xTaskCreatePinnedToCore(bleScanTask,     "BLE",     10000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(wifiProcessTask, "WiFi",    10000, NULL, 1, NULL, 0);
-  xTaskCreatePinnedToCore(printerTask,     "Print",   10000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(uartForwardTask, "UART_FW",  4096, NULL, 1, NULL, 1);
+  // Scan forever; onResult runs in the NimBLE host task
+  pBLEScan->start(0, false, true);
+  Serial.println("[REMOTE] BLE scanner active (NimBLE, passive, continuous)");
+
+#if POWER_PROFILE
+  loopHandle = xTaskGetCurrentTaskHandle();
+  power_profile_init(&power, POWER_QUIET_MS, POWER_BURST_MS, POWER_PERIOD_MS,
+                     POWER_MA_LISTEN, lightSleep ? POWER_MA_SLEEP : POWER_MA_IDLE, millis());
+  power.light_sleep = lightSleep;
+  Serial.printf("[REMOTE] Power profile: sentinel after %us quiet, %u/%u ms bursts, %s\n",
+                (unsigned)(POWER_QUIET_MS / 1000), (unsigned)POWER_BURST_MS,
+                (unsigned)POWER_PERIOD_MS, lightSleep ? "DFS + light sleep" : "fixed 160 MHz");
+#endif
 
   Serial.println("[REMOTE] All tasks launched - scanning for drones...\n");
+#if DC_METRICS
+  report_footprint();
+#endif
 }
 
+#if DC_METRICS
+static void report_metrics() {
+  dc_decode_stats decode = {};
+  dc_decode_stats_add(&decode, &bleDecoder.stats);
+  dc_decode_stats_add(&decode, &wifiDecoder.stats);
+  static char json[1280];
+  int len = dc_metrics_format_json(&metrics, json, sizeof(json), &decode,
+                                   wifiRing.drops, tracker.evictions);
+  if (len < (int)sizeof(json)) Serial.println(json);
+}
+#endif
+
 void loop() {
   unsigned long now = millis();
 
+#if POWER_PROFILE
+  uint32_t powerNextMs;
+  uint8_t powerEv = power_profile_update(&power, now, &powerNextMs);
+  if (powerEv & POWER_EV_RADIOS) power_apply_radios(power.radios_on);
+  if (powerEv & POWER_EV_MODE)
+    Serial.printf("{\"power_mode\":\"%s\"}\n",
+                  power.mode == POWER_MODE_ACTIVE ? "active" : "sentinel");
+#endif
+
+#if FLASH_LOG
+  poll_usb_commands();
+#endif
+
+#if DC_METRICS
+  if (now - last_metrics >= DC_METRICS_INTERVAL_MS) {
+    report_metrics();
+    last_metrics = now;
+  }
+#endif
+
   // Heartbeat every 60 seconds
   if (now - last_status > 60000UL) {
-    Serial.println("{\"heartbeat\":\"remote_node active\"}");
+    Serial.print("{\"heartbeat\":\"remote_node active\"");
+    char buildJson[160];
+    dc_config_format_json(buildJson, sizeof(buildJson));
+    Serial.printf(",%s", buildJson);
+#if WIFI_DEFERRED_DECODE
+    Serial.printf(",\"rx_ring\":{\"slots\":%d,\"high_water\":%u,\"drops\":%u,\"truncated\":%u}",
+                  FRAME_RING_SLOTS, wifiRing.high_water, wifiRing.drops, wifiRing.truncated);
+#endif
+    Serial.printf(",\"uav_table\":{\"capacity\":%d,\"used\":%u,\"evictions\":%u,\"coalesced\":%u,"
+                  "\"dirty_evicted\":%u}",
+                  UAV_TABLE_CAPACITY, tracker.count, tracker.evictions, tracker.coalesced,
+                  tracker.dirty_evicted);
+    Serial.printf(",\"plaus\":{\"flagged\":%u,\"suppressed\":%u}",
+                  tracker.plaus_flagged, tracker.plaus_suppressed);
+    Serial.printf(",\"ie_scan\":{\"beacons\":%u,\"bytes\":%u}",
+                  wifiDecoder.beacons_scanned, wifiDecoder.ie_bytes_examined);
+    Serial.printf(",\"ble\":{\"messages\":%u,\"packs\":%u,\"coded\":%u}",
+                  bleDecoder.ble_messages, bleDecoder.ble_packs, bleCodedHits);
+    Serial.printf(",\"uart\":{\"lines\":%u,\"overruns\":%u,\"overlong\":%u,"
+                  "\"latency_avg_us\":%u,\"latency_max_us\":%u}",
+                  heltecUart.lines, heltecUart.overruns, heltecUart.overlong,
+                  uart_ingest_latency_avg_us(&heltecUart), heltecUart.latency_max_us);
+    Serial.printf(",\"mesh\":{\"lines\":%u,\"keepalives\":%u,\"unchanged\":%u}",
+                  meshSched.lines_sent, meshSched.keepalives, meshSched.unchanged);
+#if TIME_SYNC
+    char syncJson[128];
+    time_sync_format_json(&timeSync, syncJson, sizeof(syncJson), now);
+    Serial.printf(",%s", syncJson);
+#endif
+#if FLASH_LOG
+    char logJson[256];
+    flash_log_format_json(&flashLog, logJson, sizeof(logJson));
+    Serial.printf(",%s", logJson);
+#endif
+#if POWER_PROFILE
+    char powerJson[320];
+    power_profile_format_json(&power, powerJson, sizeof(powerJson), now);
+    Serial.printf(",%s", powerJson);
+#endif
+    Serial.println("}");
     last_status = now;
   }
 
@@ -459,5 +822,12 @@ void loop() {
     }
   }
 
+#if POWER_PROFILE
+  // Sleep until the next burst edge or a detection wakes us; the LED flash
+  // and the once-a-second housekeeping bound the wait
+  uint32_t waitMs = ledOn ? 10 : (powerNextMs < 1000 ? powerNextMs : 1000);
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+#else
   delay(10);
+#endif
 }
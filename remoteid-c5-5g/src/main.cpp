@@ -7,6 +7,7 @@
  * Output:
  *   USB Serial  — JSON lines for mesh-mapper.py
  *   Serial1 UART (TX=GPIO5, RX=GPIO6) — compact messages for Heltec/Meshtastic relay
+ *                 (DC_OUT_MESH builds)
  *
  * For ESP32-C5: Dual-band scanning with fast channel hopping across 2.4+5GHz
  * For ESP32-S3: Single-band 2.4GHz scanning (original behavior)
@@ -18,13 +19,25 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include "dc_config.h"
+#if DC_RADIO_BLE
 #include <NimBLEDevice.h>
+#endif
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <nvs_flash.h>
-#include "opendroneid.h"
-#include "odid_wifi.h"
+#include "frame_ring.h"
+#include "odid_decoder.h"
+#include "uav_tracker.h"
+#include "time_sync.h"
+#include "detection_json.h"
+#include "mesh_scheduler.h"
+#include "mesh_frame.h"
+#include "usb_record.h"
+#include "channel_sched.h"
+#include "dc_metrics.h"
+#include "dc_task.h"
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -33,26 +46,16 @@
 // UART Pins — same wiring as remoteid-mesh-dualcore (Heltec LoRa V3)
 // ============================================================================
 
+#if DC_OUT_MESH
 const int SERIAL1_TX_PIN = 5;   // GPIO5 → Heltec RX
 const int SERIAL1_RX_PIN = 6;   // GPIO6 → Heltec TX
-
-// ============================================================================
-// Board-specific configuration
-// ============================================================================
-
-#if defined(CONFIG_IDF_TARGET_ESP32C5) || defined(ARDUINO_XIAO_ESP32C5)
-  #define BOARD_IS_C5 1
-  #define DUAL_BAND_ENABLED true
-  #define BOARD_NAME "XIAO ESP32-C5 (Dual-Band)"
-  // C5 is single-core RISC-V
-  #define SINGLE_CORE 1
-#else
-  #define BOARD_IS_C5 0
-  #define DUAL_BAND_ENABLED false
-  #define BOARD_NAME "XIAO ESP32-S3 (2.4GHz)"
-  #define SINGLE_CORE 0
 #endif
 
+// Board, radios, outputs and task core come from dc_config.h: 5GHz on the
+// C5 (DC_RADIO_5GHZ), tasks on core 1 of the S3 and unpinned on the
+// single-core C5 (DC_CORE_WORK). -DDC_RADIO_BLE=0 builds a WiFi-only
+// sniffer, -DDC_OUT_MESH=0 one without the Heltec uplink.
+
 // ============================================================================
 // Dual-Band Channel Configuration
 // ============================================================================
@@ -63,42 +66,80 @@ const int SERIAL1_RX_PIN = 6;   // GPIO6 → Heltec TX
 static const uint8_t channels_5ghz[] = {149, 153, 157, 161, 165};
 #define NUM_5GHZ_CHANNELS (sizeof(channels_5ghz) / sizeof(channels_5ghz[0]))
 
-// Dwell time per channel (ms). Total cycle ≈ DWELL_TIME * (1 + NUM_5GHZ_CHANNELS) ≈ 300ms
+// Dwell time per channel (ms). Quiet channels get DWELL_TIME_MS; channels
+// with recent RemoteID hits stretch towards DWELL_MAX_MS. No channel waits
+// longer than CHANNEL_REVISIT_MS between visits.
 #define DWELL_TIME_MS 50
+#ifndef DWELL_MAX_MS
+#define DWELL_MAX_MS 200
+#endif
+#ifndef CHANNEL_REVISIT_MS
+#define CHANNEL_REVISIT_MS 600
+#endif
 
 // ============================================================================
-// WiFi Band Enum
+// Multi-Radio Aggregation
 // ============================================================================
 
-enum WiFiBand {
-  BAND_UNKNOWN = 0,
-  BAND_2_4GHZ  = 1,
-  BAND_5GHZ    = 2,
-  BAND_BLE     = 3
-};
+// Several sniffers on one USB host split the scan plan between them. Plan
+// slot 0 is BLE, slot 1 is 2.4GHz ch6, then the 5GHz channels (C5 only);
+// slot k belongs to sniffer k % SNIFFER_COUNT. Flash each board with its
+// own -DSNIFFER_INDEX and mesh-mapper merges their streams. BLE and ch6
+// share the 2.4GHz front end, so two sniffers already keep both on air
+// full time. SNIFFER_COUNT 1 scans the whole plan.
+#ifndef SNIFFER_COUNT
+#define SNIFFER_COUNT 1
+#endif
+#ifndef SNIFFER_INDEX
+#define SNIFFER_INDEX 0
+#endif
+#if SNIFFER_COUNT < 1 || SNIFFER_INDEX >= SNIFFER_COUNT
+#error "SNIFFER_INDEX must be below SNIFFER_COUNT"
+#endif
+#define SNIFFER_OWNS(slot) ((slot) % SNIFFER_COUNT == SNIFFER_INDEX)
+#define SNIFFER_BLE (DC_RADIO_BLE && SNIFFER_OWNS(0))
 
 // ============================================================================
-// Data Structures
-// ============================================================================
-
-struct id_data {
-  uint8_t  mac[6];
-  int      rssi;
-  uint32_t last_seen;
-  char     op_id[ODID_ID_SIZE + 1];
-  char     uav_id[ODID_ID_SIZE + 1];
-  double   lat_d;
-  double   long_d;
-  double   base_lat_d;
-  double   base_long_d;
-  int      altitude_msl;
-  int      height_agl;
-  int      speed;
-  int      heading;
-  int      flag;
-  WiFiBand band;
-  uint8_t  channel;
-};
+// WiFi RX Capture Mode
+// ============================================================================
+
+// 1: the promiscuous callback only copies frames into wifiRing and
+//    wifiProcessTask decodes them (on core 1 for the S3).
+// 0: decode inside the WiFi driver's RX callback (legacy behaviour).
+#ifndef WIFI_DEFERRED_DECODE
+#define WIFI_DEFERRED_DECODE 1
+#endif
+
+// 1: BT5 extended scan on the 1M and Coded PHYs, so Long Range RemoteID
+//    broadcasters and their message packs are received alongside legacy
+//    advertisements. Needs -DCONFIG_BT_NIMBLE_EXT_ADV=1 (S3/C3/C5/C6 only).
+#ifndef BLE_EXTENDED_SCAN
+#define BLE_EXTENDED_SCAN 0
+#endif
+#if BLE_EXTENDED_SCAN && !CONFIG_BT_NIMBLE_EXT_ADV
+#error "BLE_EXTENDED_SCAN=1 needs -DCONFIG_BT_NIMBLE_EXT_ADV=1"
+#endif
+
+// Mesh uplink pacing: each drone at most every MESH_DRONE_INTERVAL_MS,
+// and no more than one Serial1 line per MESH_LINE_GAP_MS overall
+#ifndef MESH_DRONE_INTERVAL_MS
+#define MESH_DRONE_INTERVAL_MS 5000
+#endif
+#ifndef MESH_LINE_GAP_MS
+#define MESH_LINE_GAP_MS 1000
+#endif
+
+// 1: one 32-byte RIDB: frame per drone (mesh_frame.h) for a home node to
+//    expand into JSON. 0: human-readable Drone/Pilot text lines.
+#ifndef MESH_BINARY_FRAMES
+#define MESH_BINARY_FRAMES 0
+#endif
+
+// 1: stamp detections with UTC from a clock synced to the drones' own ODID
+//    Location timestamps (time_sync.h): "ts" in the JSON, utc_ds in frames
+#ifndef TIME_SYNC
+#define TIME_SYNC 1
+#endif
 
 // ============================================================================
 // Function Prototypes
@@ -106,50 +147,66 @@ struct id_data {
 
 void callback(void *, wifi_promiscuous_pkt_type_t);
 void send_json_fast(const id_data *UAV);
-void print_compact_message(const id_data *UAV);
+#if DC_OUT_MESH
+void print_compact_message(const id_data *UAV, mesh_part part);
+#endif
 
 // ============================================================================
 // Global Variables
 // ============================================================================
 
-#define MAX_UAVS 8
-id_data uavs[MAX_UAVS] = {0};
+static uav_tracker tracker;
+#if TIME_SYNC
+static time_sync timeSync;   // fed through the tracker
+#endif
+#if DC_RADIO_BLE
 NimBLEScan* pBLEScan = nullptr;
-ODID_UAS_Data UAS_data;
+#endif
 unsigned long last_status = 0;
 
-// Current channel tracking (for dual-band)
-volatile uint8_t current_channel = CHANNEL_2_4GHZ;
-volatile WiFiBand current_band = BAND_2_4GHZ;
-static portMUX_TYPE channelMux = portMUX_INITIALIZER_UNLOCKED;
+// Frames carry the channel they were received on (rx_ctrl.channel); the
+// hop task sets the next one before esp_wifi_set_channel() returns, so a
+// global would credit the old channel's last frames to the new one
+static inline WiFiBand channel_band(uint8_t channel) {
+  return channel <= 14 ? BAND_2_4GHZ : BAND_5GHZ;
+}
+
+static TaskHandle_t printerHandle = nullptr;
+DC_STATIC_TASK(printer, DC_STACK_PRINTER);
+#if DC_OUT_MESH
+static mesh_scheduler meshSched;
+#endif
+
+// Per-task decode contexts: BLE callback and WiFi decode never share state.
+// bleDecoder stays in WiFi-only builds for the zero counts in the status.
+static odid_decoder bleDecoder;
+static odid_decoder wifiDecoder;
 
-static QueueHandle_t printQueue;
+// ODID advertisements received on the Coded PHY (NimBLE host task only)
+static uint32_t bleCodedHits = 0;
+
+#if DC_METRICS
+// Latency histogram (printer task) and the tasks reported in {"metrics":...}
+static dc_metrics metrics;
+static unsigned long last_metrics = 0;
+#endif
+
+static frame_ring wifiRing;
+static TaskHandle_t wifiProcessHandle = nullptr;
+#if WIFI_DEFERRED_DECODE
+DC_STATIC_TASK(wifiProcess, DC_STACK_WIFI_DECODE);
+#endif
 
 // ============================================================================
-// UAV Tracking
+// Printer Wakeup
 // ============================================================================
 
-id_data* next_uav(const uint8_t* mac) {
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (memcmp(uavs[i].mac, mac, 6) == 0)
-      return &uavs[i];
-  }
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (uavs[i].mac[0] == 0)
-      return &uavs[i];
-  }
-  // Evict oldest entry
-  uint32_t oldest_time = UINT32_MAX;
-  int oldest_idx = 0;
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (uavs[i].last_seen < oldest_time) {
-      oldest_time = uavs[i].last_seen;
-      oldest_idx = i;
-    }
-  }
-  return &uavs[oldest_idx];
+// Wake the printer when a store made the tracker's dirty set non-empty
+static void wake_printer(bool wake) {
+  if (wake && printerHandle) xTaskNotifyGive(printerHandle);
 }
 
+#if DC_RADIO_BLE
 // ============================================================================
 // BLE Scanning Callbacks (NimBLE 2.1.0)
 // ============================================================================
@@ -157,191 +214,149 @@ id_data* next_uav(const uint8_t* mac) {
 class MyAdvertisedDeviceCallbacks : public NimBLEScanCallbacks {
 public:
   void onResult(const NimBLEAdvertisedDevice* device) override {
+    uint32_t rx_us = micros();
     const std::vector<uint8_t>& payloadVec = device->getPayload();
-    int len = (int)payloadVec.size();
-    if (len <= 0) return;
-
-    const uint8_t* payload = payloadVec.data();
-    // RemoteID BLE advertisement: Service UUID 0xFFFA, type 0x0D
-    if (len > 5 && payload[1] == 0x16 && payload[2] == 0xFA &&
-        payload[3] == 0xFF && payload[4] == 0x0D) {
-      const uint8_t* mac = device->getAddress().getBase()->val;
-      id_data* UAV = next_uav(mac);
-      UAV->last_seen = millis();
-      UAV->rssi = device->getRSSI();
-      memcpy(UAV->mac, (const uint8_t*)mac, 6);
-      UAV->band = BAND_BLE;
-      UAV->channel = 0;
-
-      const uint8_t* odid = &payload[6];
-      switch (odid[0] & 0xF0) {
-        case 0x00: {
-          ODID_BasicID_data basic;
-          decodeBasicIDMessage(&basic, (ODID_BasicID_encoded*) odid);
-          strncpy(UAV->uav_id, (char*) basic.UASID, ODID_ID_SIZE);
-          break;
-        }
-        case 0x10: {
-          ODID_Location_data loc;
-          decodeLocationMessage(&loc, (ODID_Location_encoded*) odid);
-          UAV->lat_d = loc.Latitude;
-          UAV->long_d = loc.Longitude;
-          UAV->altitude_msl = (int) loc.AltitudeGeo;
-          UAV->height_agl = (int) loc.Height;
-          UAV->speed = (int) loc.SpeedHorizontal;
-          UAV->heading = (int) loc.Direction;
-          break;
-        }
-        case 0x40: {
-          ODID_System_data sys;
-          decodeSystemMessage(&sys, (ODID_System_encoded*) odid);
-          UAV->base_lat_d = sys.OperatorLatitude;
-          UAV->base_long_d = sys.OperatorLongitude;
-          break;
-        }
-        case 0x50: {
-          ODID_OperatorID_data op;
-          decodeOperatorIDMessage(&op, (ODID_OperatorID_encoded*) odid);
-          strncpy(UAV->op_id, (char*) op.OperatorId, ODID_ID_SIZE);
-          break;
-        }
-      }
-      UAV->flag = 1;
-      {
-        id_data tmp = *UAV;
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(printQueue, &tmp, &xHigherPriorityTaskWoken);
-        if (xHigherPriorityTaskWoken) portYIELD_FROM_ISR();
-      }
-    }
+    if (odid_decode_ble_adv(&bleDecoder, payloadVec.data(),
+                            (int)payloadVec.size()) == ODID_FRAME_NONE) return;
+
+    const uint8_t* mac = device->getAddress().getBase()->val;
+    wake_printer(uav_tracker_store(&tracker, mac, device->getRSSI(), BAND_BLE, 0, rx_us,
+                                   &bleDecoder.fields, nullptr));
+#if BLE_EXTENDED_SCAN
+    if (device->getPrimaryPhy() == BLE_HCI_LE_PHY_CODED) bleCodedHits++;
+#endif
   }
 };
+#endif
 
 // ============================================================================
 // JSON Output (USB Serial → mesh-mapper.py)
 // ============================================================================
 
-const char* bandToString(WiFiBand band) {
-  switch (band) {
-    case BAND_2_4GHZ: return "2.4GHz";
-    case BAND_5GHZ:   return "5GHz";
-    case BAND_BLE:    return "BLE";
-    default:          return "unknown";
-  }
-}
-
+// Printer task only. Self ID / Auth / second Basic ID ride along only on
+// the line after they change.
 void send_json_fast(const id_data *UAV) {
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-  char json_msg[320];
-  snprintf(json_msg, sizeof(json_msg),
-    "{\"mac\":\"%s\",\"rssi\":%d,\"band\":\"%s\",\"channel\":%d,"
-    "\"drone_lat\":%.6f,\"drone_long\":%.6f,\"drone_altitude\":%d,"
-    "\"pilot_lat\":%.6f,\"pilot_long\":%.6f,\"basic_id\":\"%s\"}",
-    mac_str, UAV->rssi, bandToString(UAV->band), UAV->channel,
-    UAV->lat_d, UAV->long_d, UAV->altitude_msl,
-    UAV->base_lat_d, UAV->base_long_d, UAV->uav_id);
+  static char json_msg[DETECTION_JSON_EXTRA_MAX];
+  static uav_extra extra;
+  bool with_extra = UAV->extra_dirty && uav_tracker_get_extra(&tracker, UAV->mac, &extra);
+  format_detection_json_extra(json_msg, sizeof(json_msg), UAV,
+                              DETECTION_JSON_BAND | DETECTION_JSON_PLAUS |
+                                  (TIME_SYNC ? DETECTION_JSON_TIME : 0),
+                              nullptr, with_extra ? &extra : nullptr);
   Serial.println(json_msg);
 }
 
+#if USB_BINARY_OUTPUT
+static usb_batch usbBatch;  // printer task only
+
+static void flush_usb_batch() {
+  if (usbBatch.len == 0) return;
+  Serial.write(usbBatch.buf, usbBatch.len);
+  usb_batch_reset(&usbBatch);
+}
+#endif
+
+// One detection to mesh-mapper in the configured USB format
+static void send_detection(const id_data *UAV) {
+#if USB_BINARY_OUTPUT
+  if (!usb_batch_add(&usbBatch, UAV)) {
+    flush_usb_batch();
+    usb_batch_add(&usbBatch, UAV);
+  }
+#else
+  send_json_fast(UAV);
+#endif
+}
+
+#if DC_OUT_MESH
 // ============================================================================
 // Compact Message Output (Serial1 UART → Heltec/Meshtastic)
 // ============================================================================
 
-void print_compact_message(const id_data *UAV) {
-  static unsigned long lastSendTime = 0;
-  const unsigned long sendInterval = 5000;
+// One Meshtastic text line for the part the mesh scheduler released
+void print_compact_message(const id_data *UAV, mesh_part part) {
   const int MAX_MESH_SIZE = 230;
-
-  if (millis() - lastSendTime < sendInterval) return;
-  lastSendTime = millis();
-
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-
   char mesh_msg[MAX_MESH_SIZE];
   int msg_len = 0;
-  msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
-                      "Drone[%s]: %s RSSI:%d",
-                      bandToString(UAV->band), mac_str, UAV->rssi);
-  if (msg_len < MAX_MESH_SIZE && UAV->lat_d != 0.0 && UAV->long_d != 0.0) {
+
+  if (part != MESH_PART_PILOT) {   // drone line, or its keepalive
+    char mac_str[18];
+    format_mac(mac_str, UAV->mac);
     msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
-                        " https://maps.google.com/?q=%.6f,%.6f",
-                        UAV->lat_d, UAV->long_d);
+                        "Drone[%s]: %s RSSI:%d",
+                        bandToString(UAV->band), mac_str, UAV->rssi);
+    if (msg_len < MAX_MESH_SIZE && UAV->lat_e7 != 0 && UAV->long_e7 != 0) {
+      char lat[16], lon[16];
+      format_coord(lat, sizeof(lat), UAV->lat_e7);
+      format_coord(lon, sizeof(lon), UAV->long_e7);
+      msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
+                          " https://maps.google.com/?q=%s,%s", lat, lon);
+    }
+  } else {
+    char lat[16], lon[16];
+    format_coord(lat, sizeof(lat), UAV->base_lat_e7);
+    format_coord(lon, sizeof(lon), UAV->base_long_e7);
+    msg_len = snprintf(mesh_msg, sizeof(mesh_msg),
+                       "Pilot: https://maps.google.com/?q=%s,%s", lat, lon);
   }
   if (Serial1.availableForWrite() >= msg_len) {
     Serial1.println(mesh_msg);
   }
+}
 
-  delay(1000);
-  if (UAV->base_lat_d != 0.0 && UAV->base_long_d != 0.0) {
-    char pilot_msg[MAX_MESH_SIZE];
-    int pilot_len = snprintf(pilot_msg, sizeof(pilot_msg),
-                             "Pilot: https://maps.google.com/?q=%.6f,%.6f",
-                             UAV->base_lat_d, UAV->base_long_d);
-    if (Serial1.availableForWrite() >= pilot_len) {
-      Serial1.println(pilot_msg);
-    }
+static void service_mesh() {
+  id_data UAV;
+  uint16_t sends = 0;
+  mesh_part part = mesh_scheduler_next(&meshSched, millis(), &UAV, &sends);
+  if (part == MESH_PART_NONE) return;
+#if MESH_BINARY_FRAMES
+  char line[MESH_FRAME_TEXT_MAX];
+  int len = part == MESH_PART_KEEPALIVE
+                ? mesh_frame_keepalive_to_text(line, sizeof(line), &UAV, 0)
+                : mesh_frame_to_text(line, sizeof(line), &UAV, 0,
+                                     sends % MESH_FRAME_ID_EVERY == 0);
+  if (len > 0 && Serial1.availableForWrite() >= len) {
+    Serial1.println(line);
   }
+#else
+  print_compact_message(&UAV, part);
+#endif
 }
+#endif
 
 // ============================================================================
 // Channel Hopping Task (C5 dual-band only)
 // ============================================================================
 
-#if DUAL_BAND_ENABLED
-void channelHopTask(void *parameter) {
-  uint8_t channel_index = 0;
-  bool on_5ghz = false;
+// This sniffer's WiFi channels; hopped when there is more than one
+static chan_sched chanSched;
 
-  Serial.println("[DUAL-BAND] Channel hopping active");
-  Serial.printf("[DUAL-BAND] 2.4GHz ch%d + 5GHz ch", CHANNEL_2_4GHZ);
-  for (int i = 0; i < (int)NUM_5GHZ_CHANNELS; i++) {
-    Serial.printf("%d%s", channels_5ghz[i], (i < (int)NUM_5GHZ_CHANNELS - 1) ? "," : "\n");
+#if DC_RADIO_5GHZ
+DC_STATIC_TASK(channelHop, DC_STACK_CHAN_HOP);
+
+void channelHopTask(void *parameter) {
+  Serial.println("[DUAL-BAND] Adaptive channel hopping active");
+  Serial.print("[DUAL-BAND] ch");
+  for (int i = 0; i < chanSched.count; i++) {
+    Serial.printf("%d%s", chanSched.ch[i].channel, (i < chanSched.count - 1) ? "," : "\n");
   }
 
   for (;;) {
-    uint8_t next_channel;
-    WiFiBand next_band;
-
-    if (!on_5ghz) {
-      // Jump to first 5GHz channel
-      next_channel = channels_5ghz[0];
-      next_band = BAND_5GHZ;
-      channel_index = 0;
-      on_5ghz = true;
-    } else {
-      channel_index++;
-      if (channel_index >= NUM_5GHZ_CHANNELS) {
-        // Return to 2.4GHz
-        next_channel = CHANNEL_2_4GHZ;
-        next_band = BAND_2_4GHZ;
-        on_5ghz = false;
-      } else {
-        next_channel = channels_5ghz[channel_index];
-        next_band = BAND_5GHZ;
-      }
-    }
-
-    portENTER_CRITICAL(&channelMux);
-    current_channel = next_channel;
-    current_band = next_band;
-    portEXIT_CRITICAL(&channelMux);
-
-    esp_wifi_set_channel(next_channel, WIFI_SECOND_CHAN_NONE);
-    vTaskDelay(pdMS_TO_TICKS(DWELL_TIME_MS));
+    uint16_t dwell;
+    const chan_stat *next = chan_sched_next(&chanSched, millis(), &dwell);
+    esp_wifi_set_channel(next->channel, WIFI_SECOND_CHAN_NONE);
+    vTaskDelay(pdMS_TO_TICKS(dwell));
   }
 }
 #endif
 
+#if DC_RADIO_BLE
 // ============================================================================
 // BLE Scan Task
 // ============================================================================
 
+DC_STATIC_TASK(bleScan, DC_STACK_BLE_SCAN);
+
 void bleScanTask(void *parameter) {
   for (;;) {
     NimBLEScanResults foundDevices = pBLEScan->getResults(1000, false);
@@ -349,112 +364,68 @@ void bleScanTask(void *parameter) {
     delay(100);
   }
 }
+#endif
 
 // ============================================================================
-// WiFi Process Task (keeps promiscuous callback alive)
+// WiFi Process Task — drains wifiRing and runs the ODID decoders
 // ============================================================================
 
+static void process_wifi_frame(uint8_t *payload, int length, int rssi,
+                               WiFiBand band, uint8_t channel, uint32_t rx_us);
+
+#if WIFI_DEFERRED_DECODE
+// Not created when callback() decodes inline
 void wifiProcessTask(void *parameter) {
   for (;;) {
-    delay(10);
+    // Woken by callback() for each pushed frame; drain the whole batch
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    captured_frame *frame;
+    while ((frame = frame_ring_peek(&wifiRing)) != nullptr) {
+      process_wifi_frame(frame->data, frame->length, frame->rssi,
+                         (WiFiBand)frame->band, frame->channel, frame->timestamp);
+      frame_ring_release(&wifiRing);
+    }
   }
 }
+#endif
 
 // ============================================================================
 // WiFi Promiscuous Mode Callback
 // ============================================================================
 
-static void processODIDData(id_data* UAV) {
-  if (UAS_data.BasicIDValid[0])
-    strncpy(UAV->uav_id, (char *)UAS_data.BasicID[0].UASID, ODID_ID_SIZE);
-  if (UAS_data.LocationValid) {
-    UAV->lat_d = UAS_data.Location.Latitude;
-    UAV->long_d = UAS_data.Location.Longitude;
-    UAV->altitude_msl = (int)UAS_data.Location.AltitudeGeo;
-    UAV->height_agl = (int)UAS_data.Location.Height;
-    UAV->speed = (int)UAS_data.Location.SpeedHorizontal;
-    UAV->heading = (int)UAS_data.Location.Direction;
-  }
-  if (UAS_data.SystemValid) {
-    UAV->base_lat_d = UAS_data.System.OperatorLatitude;
-    UAV->base_long_d = UAS_data.System.OperatorLongitude;
-  }
-  if (UAS_data.OperatorIDValid)
-    strncpy(UAV->op_id, (char *)UAS_data.OperatorID.OperatorId, ODID_ID_SIZE);
-}
-
-static void storeAndQueue(id_data* UAV) {
-  id_data* storedUAV = next_uav(UAV->mac);
-  *storedUAV = *UAV;
-  storedUAV->flag = 1;
-  {
-    id_data tmp = *storedUAV;
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xQueueSendFromISR(printQueue, &tmp, &xHigherPriorityTaskWoken);
-    if (xHigherPriorityTaskWoken) portYIELD_FROM_ISR();
-  }
-}
-
 void callback(void *buffer, wifi_promiscuous_pkt_type_t type) {
   if (type != WIFI_PKT_MGMT) return;
 
   wifi_promiscuous_pkt_t *packet = (wifi_promiscuous_pkt_t *)buffer;
-  uint8_t *payload = packet->payload;
   int length = packet->rx_ctrl.sig_len;
 
-  // Get current channel/band info (thread-safe)
-  uint8_t detect_channel;
-  WiFiBand detect_band;
-  portENTER_CRITICAL_ISR(&channelMux);
-  detect_channel = current_channel;
-  detect_band = current_band;
-  portEXIT_CRITICAL_ISR(&channelMux);
-
-  // NAN Action Frame (WiFi Aware RemoteID)
-  static const uint8_t nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
-  if (memcmp(nan_dest, &payload[4], 6) == 0) {
-    char nan_mac[6] = {0};
-    if (odid_wifi_receive_message_pack_nan_action_frame(&UAS_data, nan_mac, payload, length) == 0) {
-      id_data UAV;
-      memset(&UAV, 0, sizeof(UAV));
-      memcpy(UAV.mac, &payload[10], 6);
-      UAV.rssi = packet->rx_ctrl.rssi;
-      UAV.last_seen = millis();
-      UAV.band = detect_band;
-      UAV.channel = detect_channel;
-      processODIDData(&UAV);
-      storeAndQueue(&UAV);
-    }
-  }
-  // Beacon Frame with RemoteID Vendor Specific IE
-  else if (payload[0] == 0x80) {
-    int offset = 36;
-    while (offset < length) {
-      int typ = payload[offset];
-      int len = payload[offset + 1];
-
-      if ((typ == 0xdd) &&
-          (((payload[offset + 2] == 0x90 && payload[offset + 3] == 0x3a && payload[offset + 4] == 0xe6)) ||
-           ((payload[offset + 2] == 0xfa && payload[offset + 3] == 0x0b && payload[offset + 4] == 0xbc)))) {
-        int j = offset + 7;
-        if (j < length) {
-          memset(&UAS_data, 0, sizeof(UAS_data));
-          odid_message_process_pack(&UAS_data, &payload[j], length - j);
-
-          id_data UAV;
-          memset(&UAV, 0, sizeof(UAV));
-          memcpy(UAV.mac, &payload[10], 6);
-          UAV.rssi = packet->rx_ctrl.rssi;
-          UAV.last_seen = millis();
-          UAV.band = detect_band;
-          UAV.channel = detect_channel;
-          processODIDData(&UAV);
-          storeAndQueue(&UAV);
-        }
-      }
-      offset += len + 2;
-    }
+  uint8_t detect_channel = packet->rx_ctrl.channel;
+  WiFiBand detect_band = channel_band(detect_channel);
+
+#if WIFI_DEFERRED_DECODE
+  if (frame_ring_push(&wifiRing, packet->payload, length, packet->rx_ctrl.rssi,
+                      detect_channel, (uint8_t)detect_band, micros()) &&
+      wifiProcessHandle) {
+    // Every frame, not just into an empty ring (frame_ring.h). The callback
+    // runs in the WiFi driver task, not an ISR: a plain notify switches to
+    // the decode task straight away if it should
+    xTaskNotifyGive(wifiProcessHandle);
   }
+#else
+  process_wifi_frame(packet->payload, length, packet->rx_ctrl.rssi,
+                     detect_band, detect_channel, micros());
+#endif
+}
+
+// Decode one management frame (NAN action or beacon) and mark the drone dirty
+static void process_wifi_frame(uint8_t *payload, int length, int rssi,
+                               WiFiBand detect_band, uint8_t detect_channel,
+                               uint32_t rx_us) {
+  if (odid_decode_wifi_frame(&wifiDecoder, payload, length) == ODID_FRAME_NONE) return;
+  chan_sched_hit(&chanSched, detect_channel);
+
+  wake_printer(uav_tracker_store(&tracker, wifiDecoder.mac, rssi, detect_band, detect_channel,
+                                 rx_us, &wifiDecoder.fields, nullptr));
 }
 
 // ============================================================================
@@ -464,10 +435,25 @@ void callback(void *buffer, wifi_promiscuous_pkt_type_t type) {
 void printerTask(void *param) {
   id_data UAV;
   for (;;) {
-    if (xQueueReceive(printQueue, &UAV, portMAX_DELAY)) {
-      send_json_fast(&UAV);
-      print_compact_message(&UAV);
+    // Woken by a store into an empty dirty set; the 100 ms timeout keeps
+    // mesh lines and rate-limited drones (UAV_PRINT_INTERVAL_MS) moving
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    while (uav_tracker_next_dirty(&tracker, millis(), &UAV)) {
+      send_detection(&UAV);
+#if DC_METRICS
+      // Binary mode measures up to the batch append, not the flush
+      dc_latency_record(&metrics.latency, micros() - UAV.capture_us);
+#endif
+#if DC_OUT_MESH
+      mesh_scheduler_update(&meshSched, &UAV);
+#endif
     }
+#if USB_BINARY_OUTPUT
+    flush_usb_batch();
+#endif
+#if DC_OUT_MESH
+    service_mesh();
+#endif
   }
 }
 
@@ -476,68 +462,143 @@ void printerTask(void *param) {
 // ============================================================================
 
 void initializeSerial() {
-  Serial.begin(115200);
+  Serial.begin(USB_SERIAL_BAUD);
+#if DC_OUT_MESH
   Serial1.begin(115200, SERIAL_8N1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
+#endif
   delay(100);
 
   Serial.println("\n========================================");
   Serial.println("    RemoteID Mesh Detect — Dual-Band");
   Serial.println("========================================");
-  Serial.printf("Board: %s\n", BOARD_NAME);
-#if DUAL_BAND_ENABLED
+  Serial.printf("Board: %s\n", DC_BOARD_NAME);
+#if DC_RADIO_5GHZ
   Serial.println("Mode:  DUAL-BAND (2.4GHz + 5GHz WiFi)");
 #else
   Serial.println("Mode:  SINGLE-BAND (2.4GHz WiFi only)");
 #endif
-  Serial.println("Proto: WiFi NAN, WiFi Beacon, BLE");
+#if SNIFFER_COUNT > 1
+  Serial.printf("Radio: sniffer %d of %d%s\n", SNIFFER_INDEX + 1, SNIFFER_COUNT,
+                SNIFFER_BLE ? " (BLE)" : "");
+#endif
+  Serial.println(DC_RADIO_BLE ? "Proto: WiFi NAN, WiFi Beacon, BLE"
+                              : "Proto: WiFi NAN, WiFi Beacon");
+#if DC_OUT_MESH
   Serial.printf("UART:  TX=GPIO%d, RX=GPIO%d → Heltec\n", SERIAL1_TX_PIN, SERIAL1_RX_PIN);
+#else
+  Serial.println("UART:  off (USB-only build)");
+#endif
   Serial.println("========================================\n");
 }
 
 void setup() {
   setCpuFrequencyMhz(160);
   initializeSerial();
+  if (!uav_tracker_init(&tracker))
+    Serial.println("[!] UAV table allocation failed");
+#if TIME_SYNC
+  time_sync_init(&timeSync);
+  tracker.clock = &timeSync;
+#endif
 
   nvs_flash_init();
 
+  // This sniffer's share of the plan (SNIFFER_OWNS)
+  chan_sched_init(&chanSched, DWELL_TIME_MS, DWELL_MAX_MS, CHANNEL_REVISIT_MS);
+  if (SNIFFER_OWNS(1)) chan_sched_add(&chanSched, CHANNEL_2_4GHZ, BAND_2_4GHZ);
+#if DC_RADIO_5GHZ
+  for (int i = 0; i < (int)NUM_5GHZ_CHANNELS; i++) {
+    if (SNIFFER_OWNS(2 + i)) chan_sched_add(&chanSched, channels_5ghz[i], BAND_5GHZ);
+  }
+#endif
+
   // WiFi promiscuous mode
   WiFi.mode(WIFI_STA);
   WiFi.disconnect();
-  esp_wifi_set_promiscuous(true);
-  esp_wifi_set_promiscuous_rx_cb(&callback);
-  esp_wifi_set_channel(CHANNEL_2_4GHZ, WIFI_SECOND_CHAN_NONE);
+  if (chanSched.count > 0) {
+    uint8_t first_channel = chanSched.ch[0].channel;
+    esp_wifi_set_promiscuous(true);
+    esp_wifi_set_promiscuous_rx_cb(&callback);
+    esp_wifi_set_channel(first_channel, WIFI_SECOND_CHAN_NONE);
+    if (chanSched.count > 1)
+      Serial.printf("WiFi promiscuous mode (starting ch%d, hopping enabled)\n", first_channel);
+    else
+      Serial.printf("WiFi promiscuous mode (fixed ch%d)\n", first_channel);
+  } else {
+    Serial.println("WiFi scanning off (no channels for this sniffer)");
+  }
 
-#if DUAL_BAND_ENABLED
-  Serial.printf("WiFi promiscuous mode (starting 2.4GHz ch%d, hopping enabled)\n", CHANNEL_2_4GHZ);
+  // BLE init (NimBLE 2.1.0)
+#if DC_RADIO_BLE
+  if (SNIFFER_BLE) {
+    NimBLEDevice::init("DroneID");
+    pBLEScan = NimBLEDevice::getScan();
+    static MyAdvertisedDeviceCallbacks bleCallbacks;
+    pBLEScan->setScanCallbacks(&bleCallbacks);
+    pBLEScan->setActiveScan(true);
+#if BLE_EXTENDED_SCAN
+    // Scan windows alternate between the 1M and Coded PHYs
+    pBLEScan->setPhy(NimBLEScan::SCAN_ALL);
+    Serial.println("BLE scanning initialized (NimBLE, 1M + Coded PHY)");
 #else
-  Serial.printf("WiFi promiscuous mode (fixed ch%d)\n", CHANNEL_2_4GHZ);
+    Serial.println("BLE scanning initialized (NimBLE)");
 #endif
-
-  // BLE init (NimBLE 2.1.0)
-  NimBLEDevice::init("DroneID");
-  pBLEScan = NimBLEDevice::getScan();
-  pBLEScan->setScanCallbacks(new MyAdvertisedDeviceCallbacks());
-  pBLEScan->setActiveScan(true);
-  Serial.println("BLE scanning initialized (NimBLE)");
-
-  // Print queue
-  printQueue = xQueueCreate(MAX_UAVS, sizeof(id_data));
-
-  // FreeRTOS tasks — C5 is single-core, S3 is dual-core
-#if SINGLE_CORE
-  xTaskCreate(bleScanTask, "BLEScanTask", 10000, NULL, 1, NULL);
-  xTaskCreate(wifiProcessTask, "WiFiProcessTask", 10000, NULL, 1, NULL);
-  xTaskCreate(printerTask, "PrinterTask", 10000, NULL, 1, NULL);
-  #if DUAL_BAND_ENABLED
-  xTaskCreate(channelHopTask, "ChannelHopTask", 4096, NULL, 2, NULL);
-  #endif
+  } else {
+    Serial.println("BLE scanning off (another sniffer has it)");
+  }
 #else
-  xTaskCreatePinnedToCore(bleScanTask, "BLEScanTask", 10000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(wifiProcessTask, "WiFiProcessTask", 10000, NULL, 1, NULL, 0);
-  xTaskCreatePinnedToCore(printerTask, "PrinterTask", 10000, NULL, 1, NULL, 1);
+  Serial.println("BLE scanning off (WiFi-only build)");
 #endif
 
-  memset(uavs, 0, sizeof(uavs));
+  // Mesh uplink schedule and decode contexts
+#if DC_OUT_MESH
+  mesh_scheduler_init(&meshSched, MESH_DRONE_INTERVAL_MS, MESH_LINE_GAP_MS, !MESH_BINARY_FRAMES);
+#endif
+  frame_ring_init(&wifiRing);
+  odid_decoder_init(&bleDecoder);
+  odid_decoder_init(&wifiDecoder);
+#if USB_BINARY_OUTPUT
+  usb_batch_init(&usbBatch);
+#endif
+
+  // FreeRTOS tasks with static stacks and TCBs (dc_task.h), so the heap
+  // only holds what the radio stacks allocate. DC_CORE_WORK: unpinned on
+  // the single-core C5, core 1 on the S3.
+  TaskHandle_t bleScanHandle = nullptr;
+#if DC_RADIO_BLE
+  if (SNIFFER_BLE) bleScanHandle = DC_START_TASK(bleScan, bleScanTask, "BLEScanTask", 1, DC_CORE_WORK);
+#endif
+#if WIFI_DEFERRED_DECODE
+  wifiProcessHandle = DC_START_TASK(wifiProcess, wifiProcessTask, "WiFiProcessTask", 2, DC_CORE_WORK);
+#endif
+  printerHandle = DC_START_TASK(printer, printerTask, "PrinterTask", 1, DC_CORE_WORK);
+#if DC_RADIO_5GHZ
+  TaskHandle_t channelHopHandle = nullptr;
+  if (chanSched.count > 1)
+    channelHopHandle = DC_START_TASK(channelHop, channelHopTask, "ChannelHopTask", 2, DC_CORE_WORK);
+#endif
+#if DC_METRICS
+  dc_metrics_init(&metrics);
+#if WIFI_DEFERRED_DECODE
+  dc_metrics_add_task(&metrics, "wifi", wifiProcessHandle, DC_TASK_STACK_BYTES(wifiProcess));
+#endif
+  dc_metrics_add_task(&metrics, "printer", printerHandle, DC_TASK_STACK_BYTES(printer));
+#if DC_RADIO_BLE
+  dc_metrics_add_task(&metrics, "ble_scan", bleScanHandle, DC_TASK_STACK_BYTES(bleScan));
+#endif
+#if DC_RADIO_5GHZ
+  dc_metrics_add_task(&metrics, "chan_hop", channelHopHandle, DC_TASK_STACK_BYTES(channelHop));
+#endif
+  dc_metrics_add_task(&metrics, "loop", xTaskGetCurrentTaskHandle(), DC_LOOP_STACK_BYTES);
+  char footprint[512];
+  if (dc_metrics_format_footprint(&metrics, footprint, sizeof(footprint)) < (int)sizeof(footprint))
+    Serial.println(footprint);
+#else
+  (void)bleScanHandle;
+#if DC_RADIO_5GHZ
+  (void)channelHopHandle;
+#endif
+#endif
 
   Serial.println("\n[+] Scanning for drones...\n");
 }
@@ -546,15 +607,60 @@ void setup() {
 // Main Loop
 // ============================================================================
 
+#if DC_METRICS
+static void report_metrics() {
+  dc_decode_stats decode = {};
+  dc_decode_stats_add(&decode, &bleDecoder.stats);
+  dc_decode_stats_add(&decode, &wifiDecoder.stats);
+  static char json[1280];
+  int len = dc_metrics_format_json(&metrics, json, sizeof(json), &decode,
+                                   wifiRing.drops, tracker.evictions);
+  if (len < (int)sizeof(json)) Serial.println(json);
+}
+#endif
+
 void loop() {
   unsigned long current_millis = millis();
 
+#if DC_METRICS
+  if (current_millis - last_metrics >= DC_METRICS_INTERVAL_MS) {
+    report_metrics();
+    last_metrics = current_millis;
+  }
+#endif
+
   if ((current_millis - last_status) > 60000UL) {
-#if DUAL_BAND_ENABLED
-    Serial.println("{\"status\":\"active\",\"mode\":\"dual-band\",\"bands\":[\"2.4GHz\",\"5GHz\",\"BLE\"]}");
-#else
-    Serial.println("{\"status\":\"active\",\"mode\":\"single-band\",\"bands\":[\"2.4GHz\",\"BLE\"]}");
+    Serial.printf("{\"status\":\"active\",\"mode\":\"%s\",\"bands\":[\"2.4GHz\"%s%s]",
+                  dc_config::wifi_5ghz ? "dual-band" : "single-band",
+                  dc_config::wifi_5ghz ? ",\"5GHz\"" : "", dc_config::ble ? ",\"BLE\"" : "");
+    char buildJson[160];
+    dc_config_format_json(buildJson, sizeof(buildJson));
+    Serial.printf(",%s", buildJson);
+#if WIFI_DEFERRED_DECODE
+    Serial.printf(",\"rx_ring\":{\"slots\":%d,\"high_water\":%u,\"drops\":%u,\"truncated\":%u}",
+                  FRAME_RING_SLOTS, wifiRing.high_water, wifiRing.drops, wifiRing.truncated);
+#endif
+    Serial.printf(",\"uav_table\":{\"capacity\":%d,\"used\":%u,\"evictions\":%u,\"coalesced\":%u,"
+                  "\"dirty_evicted\":%u}",
+                  UAV_TABLE_CAPACITY, tracker.count, tracker.evictions, tracker.coalesced,
+                  tracker.dirty_evicted);
+    Serial.printf(",\"plaus\":{\"flagged\":%u,\"suppressed\":%u}",
+                  tracker.plaus_flagged, tracker.plaus_suppressed);
+    Serial.printf(",\"ie_scan\":{\"beacons\":%u,\"bytes\":%u}",
+                  wifiDecoder.beacons_scanned, wifiDecoder.ie_bytes_examined);
+    Serial.printf(",\"ble\":{\"messages\":%u,\"packs\":%u,\"coded\":%u}",
+                  bleDecoder.ble_messages, bleDecoder.ble_packs, bleCodedHits);
+#if TIME_SYNC
+    char syncJson[128];
+    time_sync_format_json(&timeSync, syncJson, sizeof(syncJson), current_millis);
+    Serial.printf(",%s", syncJson);
 #endif
+    Serial.printf(",\"sniffer\":{\"index\":%d,\"count\":%d,\"ble\":%s}", SNIFFER_INDEX,
+                  SNIFFER_COUNT, SNIFFER_BLE ? "true" : "false");
+    static char chanJson[640];
+    chan_sched_format_json(&chanSched, chanJson, sizeof(chanJson));
+    Serial.printf(",\"channels\":%s,\"forced_revisits\":%u", chanJson, chanSched.forced_revisits);
+    Serial.println("}");
     last_status = current_millis;
   }
 }
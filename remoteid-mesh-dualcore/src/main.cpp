@@ -4,313 +4,374 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
-#include <BLEDevice.h>
-#include <BLEUtils.h>
-#include <BLEScan.h>
+#include "dc_config.h"
+#if DC_RADIO_BLE
+#include <NimBLEDevice.h>
+#endif
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <nvs_flash.h>
-#include "opendroneid.h"
-#include "odid_wifi.h"
+#include "frame_ring.h"
+#include "odid_decoder.h"
+#include "uav_tracker.h"
+#include "time_sync.h"
+#include "detection_json.h"
+#include "mesh_scheduler.h"
+#include "mesh_frame.h"
+#include "usb_record.h"
+#include "dc_metrics.h"
+#include "dc_task.h"
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+// Board, radios, outputs and task core come from dc_config.h: tasks on
+// core 1 of the S3 and unpinned on the single-core C6 (DC_CORE_WORK).
+// -DDC_RADIO_BLE=0 builds a WiFi-only detector, -DDC_OUT_MESH=0 one
+// without the Heltec uplink.
+#if DC_OUT_MESH
 const int SERIAL1_RX_PIN = 6;
 const int SERIAL1_TX_PIN = 5;
+#endif
 
-struct id_data {
-  uint8_t  mac[6];
-  int      rssi;
-  uint32_t last_seen;
-  char     op_id[ODID_ID_SIZE + 1];
-  char     uav_id[ODID_ID_SIZE + 1];
-  double   lat_d;
-  double   long_d;
-  double   base_lat_d;
-  double   base_long_d;
-  int      altitude_msl;
-  int      height_agl;
-  int      speed;
-  int      heading;
-  int      flag;
-};
+// 1: the promiscuous callback only copies frames into wifiRing and
+//    wifiProcessTask decodes them (DC_CORE_WORK).
+// 0: decode inside the WiFi driver's RX callback (legacy behaviour).
+#ifndef WIFI_DEFERRED_DECODE
+#define WIFI_DEFERRED_DECODE 1
+#endif
+
+// Mesh uplink pacing: each drone at most every MESH_DRONE_INTERVAL_MS,
+// and no more than one Serial1 line per MESH_LINE_GAP_MS overall
+#ifndef MESH_DRONE_INTERVAL_MS
+#define MESH_DRONE_INTERVAL_MS 5000
+#endif
+#ifndef MESH_LINE_GAP_MS
+#define MESH_LINE_GAP_MS 1000
+#endif
+
+// 1: one 32-byte RIDB: frame per drone (mesh_frame.h) for a home node to
+//    expand into JSON. 0: human-readable Drone/Pilot text lines.
+#ifndef MESH_BINARY_FRAMES
+#define MESH_BINARY_FRAMES 0
+#endif
+
+// 1: stamp detections with UTC from a clock synced to the drones' own ODID
+//    Location timestamps (time_sync.h): "ts" in the JSON, utc_ds in frames
+#ifndef TIME_SYNC
+#define TIME_SYNC 1
+#endif
+
+// 1: time format_detection_json() against the snprintf reference at boot
+//    and print a {"json_bench":...} line (cycles per record, mismatches)
+#ifndef DETECTION_JSON_BENCH
+#define DETECTION_JSON_BENCH 0
+#endif
+
+// 1: BT5 extended scan on the 1M and Coded PHYs, so Long Range RemoteID
+//    broadcasters and their message packs are received alongside legacy
+//    advertisements. Needs -DCONFIG_BT_NIMBLE_EXT_ADV=1 (S3/C3/C5/C6 only).
+#ifndef BLE_EXTENDED_SCAN
+#define BLE_EXTENDED_SCAN 0
+#endif
+#if BLE_EXTENDED_SCAN && !CONFIG_BT_NIMBLE_EXT_ADV
+#error "BLE_EXTENDED_SCAN=1 needs -DCONFIG_BT_NIMBLE_EXT_ADV=1"
+#endif
 
 void callback(void *, wifi_promiscuous_pkt_type_t);
 void send_json_fast(const id_data *UAV);
-void print_compact_message(const id_data *UAV);
+#if DC_OUT_MESH
+void print_compact_message(const id_data *UAV, mesh_part part);
+#endif
 
-#define MAX_UAVS 8
-id_data uavs[MAX_UAVS] = {0};
-BLEScan* pBLEScan = nullptr;
-ODID_UAS_Data UAS_data;
+static uav_tracker tracker;
+#if TIME_SYNC
+static time_sync timeSync;   // fed through the tracker
+#endif
+#if DC_RADIO_BLE
+NimBLEScan* pBLEScan = nullptr;
+#endif
 unsigned long last_status = 0;
 
-static QueueHandle_t printQueue;
+// Per-task decode contexts: BLE callback and WiFi decode never share state
+static odid_decoder bleDecoder;
+static odid_decoder wifiDecoder;
 
-id_data* next_uav(uint8_t* mac) {
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (memcmp(uavs[i].mac, mac, 6) == 0)
-      return &uavs[i];
-  }
-  for (int i = 0; i < MAX_UAVS; i++) {
-    if (uavs[i].mac[0] == 0)
-      return &uavs[i];
-  }
-  return &uavs[0];
+// ODID advertisements received on the Coded PHY (NimBLE host task only)
+static uint32_t bleCodedHits = 0;
+
+#if DC_METRICS
+// Latency histogram (printer task) and the tasks reported in {"metrics":...}
+static dc_metrics metrics;
+static unsigned long last_metrics = 0;
+#endif
+
+static TaskHandle_t printerHandle = nullptr;
+DC_STATIC_TASK(printer, DC_STACK_PRINTER);
+#if DC_OUT_MESH
+static mesh_scheduler meshSched;
+#endif
+
+static frame_ring wifiRing;
+static TaskHandle_t wifiProcessHandle = nullptr;
+#if WIFI_DEFERRED_DECODE
+DC_STATIC_TASK(wifiProcess, DC_STACK_WIFI_DECODE);
+#endif
+
+// Wake the printer when a store made the tracker's dirty set non-empty
+static void wake_printer(bool wake) {
+  if (wake && printerHandle) xTaskNotifyGive(printerHandle);
 }
 
-class MyAdvertisedDeviceCallbacks : public BLEAdvertisedDeviceCallbacks {
+#if DC_RADIO_BLE
+// NimBLE scan callbacks. The scan is continuous and passive with the
+// duplicate filter off and no result list, so every advertisement reaches
+// onResult once and is dropped there unless it carries ODID service data.
+class MyAdvertisedDeviceCallbacks : public NimBLEScanCallbacks {
 public:
-  void onResult(BLEAdvertisedDevice device) override {
-    int len = device.getPayloadLength();
-    if (len <= 0) return;
-      
-    uint8_t* payload = device.getPayload();
-    if (len > 5 && payload[1] == 0x16 && payload[2] == 0xFA && 
-        payload[3] == 0xFF && payload[4] == 0x0D) {
-      uint8_t* mac = (uint8_t*) device.getAddress().getNative();
-      id_data* UAV = next_uav(mac);
-      UAV->last_seen = millis();
-      UAV->rssi = device.getRSSI();
-      memcpy(UAV->mac, mac, 6);
-      
-      uint8_t* odid = &payload[6];
-      switch (odid[0] & 0xF0) {
-        case 0x00: {
-          ODID_BasicID_data basic;
-          decodeBasicIDMessage(&basic, (ODID_BasicID_encoded*) odid);
-          strncpy(UAV->uav_id, (char*) basic.UASID, ODID_ID_SIZE);
-          break;
-        }
-        case 0x10: {
-          ODID_Location_data loc;
-          decodeLocationMessage(&loc, (ODID_Location_encoded*) odid);
-          UAV->lat_d = loc.Latitude;
-          UAV->long_d = loc.Longitude;
-          UAV->altitude_msl = (int) loc.AltitudeGeo;
-          UAV->height_agl = (int) loc.Height;
-          UAV->speed = (int) loc.SpeedHorizontal;
-          UAV->heading = (int) loc.Direction;
-          break;
-        }
-        case 0x40: {
-          ODID_System_data sys;
-          decodeSystemMessage(&sys, (ODID_System_encoded*) odid);
-          UAV->base_lat_d = sys.OperatorLatitude;
-          UAV->base_long_d = sys.OperatorLongitude;
-          break;
-        }
-        case 0x50: {
-          ODID_OperatorID_data op;
-          decodeOperatorIDMessage(&op, (ODID_OperatorID_encoded*) odid);
-          strncpy(UAV->op_id, (char*) op.OperatorId, ODID_ID_SIZE);
-          break;
-        }
-      }
-      UAV->flag = 1;
-      {
-        id_data tmp = *UAV;
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(printQueue, &tmp, &xHigherPriorityTaskWoken);
-        if (xHigherPriorityTaskWoken) portYIELD_FROM_ISR();
-      }
-    }
+  void onResult(const NimBLEAdvertisedDevice* device) override {
+    uint32_t rx_us = micros();
+    const std::vector<uint8_t>& payloadVec = device->getPayload();
+    if (odid_decode_ble_adv(&bleDecoder, payloadVec.data(),
+                            (int)payloadVec.size()) == ODID_FRAME_NONE) return;
+
+    // NimBLE stores the address LSB first; report it in display order
+    const uint8_t* addr = device->getAddress().getBase()->val;
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++) mac[i] = addr[5 - i];
+    wake_printer(uav_tracker_store(&tracker, mac, device->getRSSI(), BAND_BLE, 0, rx_us,
+                                   &bleDecoder.fields, nullptr));
+#if BLE_EXTENDED_SCAN
+    if (device->getPrimaryPhy() == BLE_HCI_LE_PHY_CODED) bleCodedHits++;
+#endif
+  }
+
+  // A duration-0 scan only ends if the host resets it; resume straight away
+  void onScanEnd(const NimBLEScanResults& results, int reason) override {
+    pBLEScan->start(0, false, true);
   }
 };
+#endif
 
+// Printer task only. Self ID / Auth / second Basic ID ride along only on
+// the line after they change.
 void send_json_fast(const id_data *UAV) {
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-  char json_msg[256];
-  snprintf(json_msg, sizeof(json_msg),
-    "{\"mac\":\"%s\",\"rssi\":%d,\"drone_lat\":%.6f,\"drone_long\":%.6f,\"drone_altitude\":%d,\"pilot_lat\":%.6f,\"pilot_long\":%.6f,\"basic_id\":\"%s\"}",
-    mac_str, UAV->rssi, UAV->lat_d, UAV->long_d, UAV->altitude_msl,
-    UAV->base_lat_d, UAV->base_long_d, UAV->uav_id);
+  static char json_msg[DETECTION_JSON_EXTRA_MAX];
+  static uav_extra extra;
+  bool with_extra = UAV->extra_dirty && uav_tracker_get_extra(&tracker, UAV->mac, &extra);
+  format_detection_json_extra(json_msg, sizeof(json_msg), UAV,
+                              DETECTION_JSON_PLAUS | (TIME_SYNC ? DETECTION_JSON_TIME : 0),
+                              nullptr, with_extra ? &extra : nullptr);
   Serial.println(json_msg);
 }
 
-void print_compact_message(const id_data *UAV) {
-  static unsigned long lastSendTime = 0;
-  const unsigned long sendInterval = 5000;
+#if USB_BINARY_OUTPUT
+static usb_batch usbBatch;  // printer task only
+
+static void flush_usb_batch() {
+  if (usbBatch.len == 0) return;
+  Serial.write(usbBatch.buf, usbBatch.len);
+  usb_batch_reset(&usbBatch);
+}
+#endif
+
+// One detection to mesh-mapper in the configured USB format
+static void send_detection(const id_data *UAV) {
+#if USB_BINARY_OUTPUT
+  if (!usb_batch_add(&usbBatch, UAV)) {
+    flush_usb_batch();
+    usb_batch_add(&usbBatch, UAV);
+  }
+#else
+  send_json_fast(UAV);
+#endif
+}
+
+#if DC_OUT_MESH
+// One Meshtastic text line for the part the mesh scheduler released
+void print_compact_message(const id_data *UAV, mesh_part part) {
   const int MAX_MESH_SIZE = 230;
-  
-  if (millis() - lastSendTime < sendInterval) return;
-  lastSendTime = millis();
-  
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-  
   char mesh_msg[MAX_MESH_SIZE];
   int msg_len = 0;
-  msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
-                      "Drone: %s RSSI:%d", mac_str, UAV->rssi);
-  if (msg_len < MAX_MESH_SIZE && UAV->lat_d != 0.0 && UAV->long_d != 0.0) {
+
+  if (part != MESH_PART_PILOT) {   // drone line, or its keepalive
+    char mac_str[18];
+    format_mac(mac_str, UAV->mac);
     msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
-                        " https://maps.google.com/?q=%.6f,%.6f",
-                        UAV->lat_d, UAV->long_d, UAV->uav_id);
+                        "Drone: %s RSSI:%d", mac_str, UAV->rssi);
+    if (msg_len < MAX_MESH_SIZE && UAV->lat_e7 != 0 && UAV->long_e7 != 0) {
+      char lat[16], lon[16];
+      format_coord(lat, sizeof(lat), UAV->lat_e7);
+      format_coord(lon, sizeof(lon), UAV->long_e7);
+      msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
+                          " https://maps.google.com/?q=%s,%s", lat, lon);
+    }
+  } else {
+    char lat[16], lon[16];
+    format_coord(lat, sizeof(lat), UAV->base_lat_e7);
+    format_coord(lon, sizeof(lon), UAV->base_long_e7);
+    msg_len = snprintf(mesh_msg, sizeof(mesh_msg),
+                       "Pilot: https://maps.google.com/?q=%s,%s", lat, lon);
   }
   if (Serial1.availableForWrite() >= msg_len) {
     Serial1.println(mesh_msg);
   }
-  
-  delay(1000);
-  if (UAV->base_lat_d != 0.0 && UAV->base_long_d != 0.0) {
-    char pilot_msg[MAX_MESH_SIZE];
-    int pilot_len = snprintf(pilot_msg, sizeof(pilot_msg),
-                             "Pilot: https://maps.google.com/?q=%.6f,%.6f",
-                             UAV->base_lat_d, UAV->base_long_d);
-    if (Serial1.availableForWrite() >= pilot_len) {
-      Serial1.println(pilot_msg);
-    }
-  }
 }
 
-void bleScanTask(void *parameter) {
-  for (;;) {
-    BLEScanResults* foundDevices = pBLEScan->start(1, false);
-    pBLEScan->clearResults();
-    for (int i = 0; i < MAX_UAVS; i++) {
-      if (uavs[i].flag) {
-        // Removed send_json_fast and print_compact_message calls here
-        uavs[i].flag = 0;
-      }
-    }
-    delay(100);
+static void service_mesh() {
+  id_data UAV;
+  uint16_t sends = 0;
+  mesh_part part = mesh_scheduler_next(&meshSched, millis(), &UAV, &sends);
+  if (part == MESH_PART_NONE) return;
+#if MESH_BINARY_FRAMES
+  char line[MESH_FRAME_TEXT_MAX];
+  int len = part == MESH_PART_KEEPALIVE
+                ? mesh_frame_keepalive_to_text(line, sizeof(line), &UAV, 0)
+                : mesh_frame_to_text(line, sizeof(line), &UAV, 0,
+                                     sends % MESH_FRAME_ID_EVERY == 0);
+  if (len > 0 && Serial1.availableForWrite() >= len) {
+    Serial1.println(line);
   }
+#else
+  print_compact_message(&UAV, part);
+#endif
 }
+#endif
+
+void process_wifi_frame(uint8_t *payload, int length, int rssi, uint8_t channel,
+                        uint32_t rx_us);
 
+#if WIFI_DEFERRED_DECODE
+// Not created when callback() decodes inline
 void wifiProcessTask(void *parameter) {
   for (;;) {
-    // No-op: callback sets uavs[].flag and data, so nothing needed here
-    delay(10);
+    // Woken by callback() for each pushed frame; drain the whole batch
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    captured_frame *frame;
+    while ((frame = frame_ring_peek(&wifiRing)) != nullptr) {
+      process_wifi_frame(frame->data, frame->length, frame->rssi, frame->channel,
+                         frame->timestamp);
+      frame_ring_release(&wifiRing);
+    }
   }
 }
+#endif
 
 void callback(void *buffer, wifi_promiscuous_pkt_type_t type) {
   if (type != WIFI_PKT_MGMT) return;
   
   wifi_promiscuous_pkt_t *packet = (wifi_promiscuous_pkt_t *)buffer;
-  uint8_t *payload = packet->payload;
   int length = packet->rx_ctrl.sig_len;
-  
-  static const uint8_t nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
-  if (memcmp(nan_dest, &payload[4], 6) == 0) {
-    if (odid_wifi_receive_message_pack_nan_action_frame(&UAS_data, nullptr, payload, length) == 0) {
-      id_data UAV;
-      memset(&UAV, 0, sizeof(UAV));
-      memcpy(UAV.mac, &payload[10], 6);
-      UAV.rssi = packet->rx_ctrl.rssi;
-      UAV.last_seen = millis();
-      
-      if (UAS_data.BasicIDValid[0]) {
-        strncpy(UAV.uav_id, (char *)UAS_data.BasicID[0].UASID, ODID_ID_SIZE);
-      }
-      if (UAS_data.LocationValid) {
-        UAV.lat_d = UAS_data.Location.Latitude;
-        UAV.long_d = UAS_data.Location.Longitude;
-        UAV.altitude_msl = (int)UAS_data.Location.AltitudeGeo;
-        UAV.height_agl = (int)UAS_data.Location.Height;
-        UAV.speed = (int)UAS_data.Location.SpeedHorizontal;
-        UAV.heading = (int)UAS_data.Location.Direction;
-      }
-      if (UAS_data.SystemValid) {
-        UAV.base_lat_d = UAS_data.System.OperatorLatitude;
-        UAV.base_long_d = UAS_data.System.OperatorLongitude;
-      }
-      if (UAS_data.OperatorIDValid) {
-        strncpy(UAV.op_id, (char *)UAS_data.OperatorID.OperatorId, ODID_ID_SIZE);
-      }
-      
-      id_data* storedUAV = next_uav(UAV.mac);
-      *storedUAV = UAV;
-      storedUAV->flag = 1;
-      {
-        id_data tmp = *storedUAV;
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(printQueue, &tmp, &xHigherPriorityTaskWoken);
-        if (xHigherPriorityTaskWoken) portYIELD_FROM_ISR();
-      }
-    }
-  }
-  else if (payload[0] == 0x80) {
-    int offset = 36;
-    while (offset < length) {
-      int typ = payload[offset];
-      int len = payload[offset + 1];
-      if ((typ == 0xdd) &&
-          (((payload[offset + 2] == 0x90 && payload[offset + 3] == 0x3a && payload[offset + 4] == 0xe6)) ||
-           ((payload[offset + 2] == 0xfa && payload[offset + 3] == 0x0b && payload[offset + 4] == 0xbc)))) {
-        int j = offset + 7;
-        if (j < length) {
-          memset(&UAS_data, 0, sizeof(UAS_data));
-          odid_message_process_pack(&UAS_data, &payload[j], length - j);
-          
-          id_data UAV;
-          memset(&UAV, 0, sizeof(UAV));
-          memcpy(UAV.mac, &payload[10], 6);
-          UAV.rssi = packet->rx_ctrl.rssi;
-          UAV.last_seen = millis();
-          
-          if (UAS_data.BasicIDValid[0]) {
-            strncpy(UAV.uav_id, (char *)UAS_data.BasicID[0].UASID, ODID_ID_SIZE);
-          }
-          if (UAS_data.LocationValid) {
-            UAV.lat_d = UAS_data.Location.Latitude;
-            UAV.long_d = UAS_data.Location.Longitude;
-            UAV.altitude_msl = (int)UAS_data.Location.AltitudeGeo;
-            UAV.height_agl = (int)UAS_data.Location.Height;
-            UAV.speed = (int)UAS_data.Location.SpeedHorizontal;
-            UAV.heading = (int)UAS_data.Location.Direction;
-          }
-          if (UAS_data.SystemValid) {
-            UAV.base_lat_d = UAS_data.System.OperatorLatitude;
-            UAV.base_long_d = UAS_data.System.OperatorLongitude;
-          }
-          if (UAS_data.OperatorIDValid) {
-            strncpy(UAV.op_id, (char *)UAS_data.OperatorID.OperatorId, ODID_ID_SIZE);
-          }
-          
-          id_data* storedUAV = next_uav(UAV.mac);
-          *storedUAV = UAV;
-          storedUAV->flag = 1;
-          {
-            id_data tmp = *storedUAV;
-            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-            xQueueSendFromISR(printQueue, &tmp, &xHigherPriorityTaskWoken);
-            if (xHigherPriorityTaskWoken) portYIELD_FROM_ISR();
-          }
-        }
-      }
-      offset += len + 2;
-    }
+
+#if WIFI_DEFERRED_DECODE
+  if (frame_ring_push(&wifiRing, packet->payload, length, packet->rx_ctrl.rssi,
+                      packet->rx_ctrl.channel, 0, micros()) &&
+      wifiProcessHandle) {
+    // Every frame, not just into an empty ring (frame_ring.h). The callback
+    // runs in the WiFi driver task, not an ISR: a plain notify switches to
+    // the decode task straight away if it should
+    xTaskNotifyGive(wifiProcessHandle);
   }
+#else
+  process_wifi_frame(packet->payload, length, packet->rx_ctrl.rssi, packet->rx_ctrl.channel,
+                     micros());
+#endif
+}
+
+// Decode one management frame (NAN action or beacon) and mark the drone dirty
+void process_wifi_frame(uint8_t *payload, int length, int rssi, uint8_t channel,
+                        uint32_t rx_us) {
+  if (odid_decode_wifi_frame(&wifiDecoder, payload, length) == ODID_FRAME_NONE) return;
+
+  wake_printer(uav_tracker_store(&tracker, wifiDecoder.mac, rssi, BAND_2_4GHZ, channel,
+                                 rx_us, &wifiDecoder.fields, nullptr));
 }
 
 void printerTask(void *param) {
   id_data UAV;
   for (;;) {
-    if (xQueueReceive(printQueue, &UAV, portMAX_DELAY)) {
-      send_json_fast(&UAV);
-      print_compact_message(&UAV);
-      // no need to reset flag on copy
+    // Woken by a store into an empty dirty set; the 100 ms timeout keeps
+    // mesh lines and rate-limited drones (UAV_PRINT_INTERVAL_MS) moving
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    while (uav_tracker_next_dirty(&tracker, millis(), &UAV)) {
+      send_detection(&UAV);
+#if DC_METRICS
+      // Binary mode measures up to the batch append, not the flush
+      dc_latency_record(&metrics.latency, micros() - UAV.capture_us);
+#endif
+#if DC_OUT_MESH
+      mesh_scheduler_update(&meshSched, &UAV);
+#endif
     }
+#if USB_BINARY_OUTPUT
+    flush_usb_batch();
+#endif
+#if DC_OUT_MESH
+    service_mesh();
+#endif
   }
 }
 
 void initializeSerial() {
-  Serial.begin(115200);
+  Serial.begin(USB_SERIAL_BAUD);
+#if DC_OUT_MESH
   Serial1.begin(115200, SERIAL_8N1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
+#endif
 }
 
+#if DETECTION_JSON_BENCH
+static void run_json_bench() {
+  const int records = 64, rounds = 8;
+  static id_data samples[records];
+  for (int i = 0; i < records; i++) {
+    id_data *u = &samples[i];
+    memset(u, 0, sizeof(*u));
+    for (int k = 0; k < 6; k++) u->mac[k] = (uint8_t)esp_random();
+    format_mac(u->mac_str, u->mac);
+    u->rssi = -30 - (int)(esp_random() % 70);
+    u->lat_e7  = (int32_t)(esp_random() % 1800000000u) - 900000000;
+    u->long_e7 = (int32_t)(esp_random() % 3600000000u) - 1800000000;
+    u->base_lat_e7  = u->lat_e7 + (int32_t)(esp_random() % 20000) - 10000;
+    u->base_long_e7 = u->long_e7 + (int32_t)(esp_random() % 20000) - 10000;
+    u->altitude_msl = (int)(esp_random() % 500);
+    snprintf(u->uav_id, sizeof(u->uav_id), "1581F%08X", (unsigned)esp_random());
+  }
+
+  char a[256], b[256];
+  uint32_t mismatches = 0, ref_cycles = 0, fast_cycles = 0;
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < records; i++) {
+      uint32_t t0 = ESP.getCycleCount();
+      int lb = format_detection_json_ref(b, sizeof(b), &samples[i], 0, nullptr);
+      uint32_t t1 = ESP.getCycleCount();
+      int la = format_detection_json(a, sizeof(a), &samples[i], 0, nullptr);
+      uint32_t t2 = ESP.getCycleCount();
+      ref_cycles += t1 - t0;
+      fast_cycles += t2 - t1;
+      if (la != lb || memcmp(a, b, la + 1) != 0) mismatches++;
+    }
+  }
+  const uint32_t n = records * rounds;
+  Serial.printf("{\"json_bench\":{\"records\":%u,\"ref_cycles\":%u,"
+                "\"fast_cycles\":%u,\"mismatches\":%u}}\n",
+                (unsigned)n, (unsigned)(ref_cycles / n),
+                (unsigned)(fast_cycles / n), (unsigned)mismatches);
+}
+#endif
+
 void setup() {
   setCpuFrequencyMhz(160);
   initializeSerial();
+#if DETECTION_JSON_BENCH
+  run_json_bench();
+#endif
+  if (!uav_tracker_init(&tracker))
+    Serial.println("[!] UAV table allocation failed");
+#if TIME_SYNC
+  time_sync_init(&timeSync);
+  tracker.clock = &timeSync;
+#endif
   nvs_flash_init();
   
   WiFi.mode(WIFI_STA);
@@ -320,24 +381,100 @@ void setup() {
   esp_wifi_set_promiscuous_rx_cb(&callback);
   esp_wifi_set_channel(6, WIFI_SECOND_CHAN_NONE);
   
-  BLEDevice::init("DroneID");
-  pBLEScan = BLEDevice::getScan();
-  pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks());
-  pBLEScan->setActiveScan(true);
+#if DC_RADIO_BLE
+  NimBLEDevice::init("DroneID");
+  pBLEScan = NimBLEDevice::getScan();
+  static MyAdvertisedDeviceCallbacks bleCallbacks;
+  pBLEScan->setScanCallbacks(&bleCallbacks, true);
+  pBLEScan->setDuplicateFilter(0);
+  pBLEScan->setMaxResults(0);
+  pBLEScan->setActiveScan(false);
+  pBLEScan->setInterval(100);
+  pBLEScan->setWindow(100);
+#if BLE_EXTENDED_SCAN
+  // Scan windows alternate between the 1M and Coded PHYs
+  pBLEScan->setPhy(NimBLEScan::SCAN_ALL);
+#endif
+#endif
 
-  printQueue = xQueueCreate(MAX_UAVS, sizeof(id_data));
-  
-  xTaskCreatePinnedToCore(bleScanTask, "BLEScanTask", 10000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(wifiProcessTask, "WiFiProcessTask", 10000, NULL, 1, NULL, 0);
-  xTaskCreatePinnedToCore(printerTask, "PrinterTask", 10000, NULL, 1, NULL, 1);
+#if DC_OUT_MESH
+  mesh_scheduler_init(&meshSched, MESH_DRONE_INTERVAL_MS, MESH_LINE_GAP_MS, !MESH_BINARY_FRAMES);
+#endif
+  frame_ring_init(&wifiRing);
+  odid_decoder_init(&bleDecoder);
+  odid_decoder_init(&wifiDecoder);
+#if USB_BINARY_OUTPUT
+  usb_batch_init(&usbBatch);
+#endif
   
-  memset(uavs, 0, sizeof(uavs));
+  // WiFi driver RX runs on core 0, so decode on core 1 where there is one
+  // (DC_CORE_WORK). Stacks and TCBs are static (dc_task.h).
+#if WIFI_DEFERRED_DECODE
+  wifiProcessHandle = DC_START_TASK(wifiProcess, wifiProcessTask, "WiFiProcessTask", 2, DC_CORE_WORK);
+#endif
+  printerHandle = DC_START_TASK(printer, printerTask, "PrinterTask", 1, DC_CORE_WORK);
+#if DC_METRICS
+  dc_metrics_init(&metrics);
+#if WIFI_DEFERRED_DECODE
+  dc_metrics_add_task(&metrics, "wifi", wifiProcessHandle, DC_TASK_STACK_BYTES(wifiProcess));
+#endif
+  dc_metrics_add_task(&metrics, "printer", printerHandle, DC_TASK_STACK_BYTES(printer));
+  dc_metrics_add_task(&metrics, "loop", xTaskGetCurrentTaskHandle(), DC_LOOP_STACK_BYTES);
+#endif
+#if DC_RADIO_BLE
+  // Scan forever; onResult runs in the NimBLE host task
+  pBLEScan->start(0, false, true);
+#endif
+#if DC_METRICS
+  char footprint[512];
+  if (dc_metrics_format_footprint(&metrics, footprint, sizeof(footprint)) < (int)sizeof(footprint))
+    Serial.println(footprint);
+#endif
+}
+
+#if DC_METRICS
+static void report_metrics() {
+  dc_decode_stats decode = {};
+  dc_decode_stats_add(&decode, &bleDecoder.stats);
+  dc_decode_stats_add(&decode, &wifiDecoder.stats);
+  static char json[1280];
+  int len = dc_metrics_format_json(&metrics, json, sizeof(json), &decode,
+                                   wifiRing.drops, tracker.evictions);
+  if (len < (int)sizeof(json)) Serial.println(json);
 }
+#endif
 
 void loop() {
   unsigned long current_millis = millis();
+#if DC_METRICS
+  if (current_millis - last_metrics >= DC_METRICS_INTERVAL_MS) {
+    report_metrics();
+    last_metrics = current_millis;
+  }
+#endif
     if ((current_millis - last_status) > 60000UL) {
       Serial.println("{\"   [+] Device is active and scanning...\"}");
+#if WIFI_DEFERRED_DECODE
+      Serial.printf("{\"rx_ring\":{\"slots\":%d,\"high_water\":%u,\"drops\":%u,\"truncated\":%u},"
+                    "\"uav_table\":{\"capacity\":%d,\"used\":%u,\"evictions\":%u,\"coalesced\":%u,"
+                    "\"dirty_evicted\":%u},"
+                    "\"ie_scan\":{\"beacons\":%u,\"bytes\":%u},"
+                    "\"ble\":{\"messages\":%u,\"packs\":%u,\"coded\":%u}}\n",
+                    FRAME_RING_SLOTS, wifiRing.high_water, wifiRing.drops, wifiRing.truncated,
+                    UAV_TABLE_CAPACITY, tracker.count, tracker.evictions, tracker.coalesced,
+                    tracker.dirty_evicted, wifiDecoder.beacons_scanned, wifiDecoder.ie_bytes_examined,
+                    bleDecoder.ble_messages, bleDecoder.ble_packs, bleCodedHits);
+#endif
+#if TIME_SYNC
+      char syncJson[128];
+      time_sync_format_json(&timeSync, syncJson, sizeof(syncJson), current_millis);
+      Serial.printf("{%s}\n", syncJson);
+#endif
+      Serial.printf("{\"plaus\":{\"flagged\":%u,\"suppressed\":%u}}\n",
+                    tracker.plaus_flagged, tracker.plaus_suppressed);
+      char buildJson[160];
+      dc_config_format_json(buildJson, sizeof(buildJson));
+      Serial.printf("{%s}\n", buildJson);
       last_status = current_millis;
     }
 }
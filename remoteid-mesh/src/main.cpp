@@ -8,6 +8,18 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+
+// WiFi-only, JSON-only and without tasks of its own: the promiscuous
+// callback decodes and loop() paces the mesh, so DC_CORE_WORK is unused.
+// BLE and binary USB records live in remoteid-mesh-dualcore.
+#if defined(DC_RADIO_BLE) && DC_RADIO_BLE
+#error "remoteid-mesh has no BLE scanner; build remoteid-mesh-dualcore"
+#endif
+#define DC_RADIO_BLE 0
+#include "dc_config.h"
+#if USB_BINARY_OUTPUT
+#error "remoteid-mesh only writes JSON lines; build remoteid-mesh-dualcore"
+#endif
 #include <esp_wifi.h>
 #include <nvs_flash.h>
 #include <esp_netif.h>
@@ -15,68 +27,78 @@
 #include <esp_timer.h>
 #include <set>
 #include <string>
-#include "opendroneid.h"
-#include "odid_wifi.h"
+#include "odid_decoder.h"
+#include "uav_tracker.h"
+#include "time_sync.h"
+#include "detection_json.h"
+#include "mesh_scheduler.h"
+#include "mesh_frame.h"
+#include "dc_metrics.h"
+#include "dc_task.h"
 
-// Custom UART pin definitions for Serial1
+// Custom UART pin definitions for Serial1. -DDC_OUT_MESH=0 builds a
+// USB-only detector without the Heltec uplink.
+#if DC_OUT_MESH
 const int SERIAL1_RX_PIN = 7;  // GPIO7
 const int SERIAL1_TX_PIN = 6;  // GPIO6
+#endif
+
+// WiFi decode context (only the promiscuous callback decodes on this board)
+static odid_decoder wifiDecoder;
+
+// Merged per-drone state
+static uav_tracker tracker;
+
+// Mesh uplink pacing: each drone at most every MESH_DRONE_INTERVAL_MS,
+// and no more than one Serial1 line per MESH_LINE_GAP_MS overall
+#ifndef MESH_DRONE_INTERVAL_MS
+#define MESH_DRONE_INTERVAL_MS 5000
+#endif
+#ifndef MESH_LINE_GAP_MS
+#define MESH_LINE_GAP_MS 1000
+#endif
+
+// 1: one 32-byte RIDB: frame per drone (mesh_frame.h) for a home node to
+//    expand into JSON. 0: human-readable Drone/Pilot text lines.
+#ifndef MESH_BINARY_FRAMES
+#define MESH_BINARY_FRAMES 0
+#endif
+
+// 1: stamp detections with UTC from a clock synced to the drones' own ODID
+//    Location timestamps (time_sync.h): "ts" in the JSON, utc_ds in frames
+#ifndef TIME_SYNC
+#define TIME_SYNC 1
+#endif
+
+#if TIME_SYNC
+static time_sync timeSync;   // fed through the tracker
+#endif
 
-ODID_UAS_Data UAS_data;
+#if DC_OUT_MESH
+// Fed from the WiFi callback, drained by loop()
+static mesh_scheduler meshSched;
+#endif
 
-// Structure to hold UAV detection data
-struct uav_data {
-  uint8_t mac[6];
-  uint8_t padding[1];
-  int8_t rssi;
-  char op_id[ODID_ID_SIZE + 1];
-  char uav_id[ODID_ID_SIZE + 1];
-  double lat_d;
-  double long_d;
-  double base_lat_d;
-  double base_long_d;
-  int altitude_msl;
-  int height_agl;
-  int speed;
-  int heading;
-  int speed_vertical;
-  int altitude_pressure;
-  int horizontal_accuracy;
-  int vertical_accuracy;
-  int baro_accuracy;
-  int speed_accuracy;
-  int timestamp;
-  int status;
-  int height_type;
-  int operator_location_type;
-  int classification_type;
-  int area_count;
-  int area_radius;
-  int area_ceiling;
-  int area_floor;
-  int operator_altitude_geo;
-  uint32_t system_timestamp;
-  int operator_id_type;
-  uint8_t ua_type;
-  uint8_t auth_type;
-  uint8_t auth_page;
-  uint8_t auth_length;
-  uint32_t auth_timestamp;
-  char auth_data[ODID_AUTH_PAGE_NONZERO_DATA_SIZE + 1];
-  uint8_t desc_type;
-  char description[ODID_STR_SIZE + 1];
-};
+// Decode scratch record, only touched from the promiscuous callback
+static id_data currentUAV;
 
 // Forward declarations
 void event_handler(void *ctx, esp_event_base_t event_base, int32_t event_id, void *event_data);
 void callback(void *, wifi_promiscuous_pkt_type_t);
-void parse_odid(struct uav_data *, ODID_UAS_Data *);
-void store_mac(struct uav_data *uav, uint8_t *payload);
-void send_json_detection(struct uav_data *UAV); // existing function
+#if DC_OUT_MESH
+void print_compact_message(const id_data *UAV, mesh_part part);
+void send_mesh_line(const id_data *UAV, mesh_part part, uint16_t sends);
+#endif
 
 // Global packet counter
 static int packetCount = 0;
 
+#if DC_METRICS
+// Capture-to-USB latency (promiscuous callback) for the {"metrics":...} record
+static dc_metrics metrics;
+static unsigned long last_metrics = 0;
+#endif
+
 // Variables for periodic heartbeat
 unsigned long last_status = 0;
 unsigned long current_millis = 0;
@@ -88,10 +110,14 @@ void event_handler(void *ctx, esp_event_base_t event_base, int32_t event_id, voi
 // Initialize USB Serial (for JSON output) and Serial1 (
 void initializeSerial() {
   // Initialize USB Serial for JSON payloads.
-  Serial.begin(115200);
+  Serial.begin(USB_SERIAL_BAUD);
+#if DC_OUT_MESH
   // Initialize Serial1 for mesh detection messages.
   Serial1.begin(115200, SERIAL_8N1, SERIAL1_RX_PIN, SERIAL1_TX_PIN);
   Serial.println("USB Serial (for JSON) and UART (Serial1) initialized.");
+#else
+  Serial.println("USB Serial (for JSON) initialized.");
+#endif
 }
 
 void setup() {
@@ -105,87 +131,125 @@ void setup() {
   esp_wifi_init(&cfg);
   esp_wifi_set_storage(WIFI_STORAGE_RAM);
   esp_wifi_set_mode(WIFI_MODE_NULL);
+  if (!uav_tracker_init(&tracker))
+    Serial.println("[!] UAV table allocation failed");
+#if TIME_SYNC
+  time_sync_init(&timeSync);
+  tracker.clock = &timeSync;
+#endif
+  odid_decoder_init(&wifiDecoder);
+#if DC_OUT_MESH
+  mesh_scheduler_init(&meshSched, MESH_DRONE_INTERVAL_MS, MESH_LINE_GAP_MS, !MESH_BINARY_FRAMES);
+#endif
+#if DC_METRICS
+  dc_metrics_init(&metrics);
+  dc_metrics_add_task(&metrics, "loop", xTaskGetCurrentTaskHandle(), DC_LOOP_STACK_BYTES);
+#endif
   esp_wifi_start();
   esp_wifi_set_promiscuous(true);
   esp_wifi_set_promiscuous_rx_cb(&callback);
   esp_wifi_set_channel(6, WIFI_SECOND_CHAN_NONE);
+#if DC_METRICS
+  char footprint[256];
+  if (dc_metrics_format_footprint(&metrics, footprint, sizeof(footprint)) < (int)sizeof(footprint))
+    Serial.println(footprint);
+#endif
 }
 
 void loop() {
   delay(10);
   current_millis = millis();
+#if DC_OUT_MESH
+  id_data meshUAV;
+  uint16_t sends = 0;
+  mesh_part part = mesh_scheduler_next(&meshSched, current_millis, &meshUAV, &sends);
+  if (part != MESH_PART_NONE) send_mesh_line(&meshUAV, part, sends);
+#endif
+#if DC_METRICS
+  if (current_millis - last_metrics >= DC_METRICS_INTERVAL_MS) {
+    static char json[1280];
+    int len = dc_metrics_format_json(&metrics, json, sizeof(json), &wifiDecoder.stats,
+                                     0, tracker.evictions);
+    if (len < (int)sizeof(json)) Serial.println(json);
+    last_metrics = current_millis;
+  }
+#endif
   if ((current_millis - last_status) > 60000UL) { // Every 60 seconds
     // Send a heartbeat as JSON (optional)
-    Serial.println("{\"heartbeat\":\"Device is active and running.\"}");
+    Serial.printf("{\"heartbeat\":\"Device is active and running.\","
+                  "\"ie_scan\":{\"beacons\":%u,\"bytes\":%u}",
+                  wifiDecoder.beacons_scanned, wifiDecoder.ie_bytes_examined);
+    Serial.printf(",\"plaus\":{\"flagged\":%u,\"suppressed\":%u}",
+                  tracker.plaus_flagged, tracker.plaus_suppressed);
+#if TIME_SYNC
+    char syncJson[128];
+    time_sync_format_json(&timeSync, syncJson, sizeof(syncJson), current_millis);
+    Serial.printf(",%s", syncJson);
+#endif
+    char buildJson[160];
+    dc_config_format_json(buildJson, sizeof(buildJson));
+    Serial.printf(",%s", buildJson);
+    Serial.println("}");
     last_status = current_millis;
   }
 }
 
-// Sends the minimal JSON payload over USB Serial (updated to include basic_id).
-void send_json_detection(struct uav_data *UAV) {
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
+// Sends JSON payload as fast as possible over USB Serial (includes basic_id).
+void send_json_fast(const id_data *UAV) {
   char json_msg[256];
-  snprintf(json_msg, sizeof(json_msg),
-    "{\"mac\":\"%s\", \"rssi\":%d, \"drone_lat\":%.6f, \"drone_long\":%.6f, \"drone_altitude\":%d, \"pilot_lat\":%.6f, \"pilot_long\":%.6f, \"basic_id\":\"%s\"}",
-    mac_str, UAV->rssi, UAV->lat_d, UAV->long_d, UAV->altitude_msl, UAV->base_lat_d, UAV->base_long_d, UAV->uav_id);
+  format_detection_json(json_msg, sizeof(json_msg), UAV,
+                        DETECTION_JSON_PLAUS | (TIME_SYNC ? DETECTION_JSON_TIME : 0), nullptr);
   Serial.println(json_msg);
 }
 
-// New function: sends JSON payload as fast as possible over USB Serial (updated to include basic_id).
-void send_json_fast(struct uav_data *UAV) {
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-  char json_msg[256];
-  snprintf(json_msg, sizeof(json_msg),
-    "{\"mac\":\"%s\", \"rssi\":%d, \"drone_lat\":%.6f, \"drone_long\":%.6f, \"drone_altitude\":%d, \"pilot_lat\":%.6f, \"pilot_long\":%.6f, \"basic_id\":\"%s\"}",
-    mac_str, UAV->rssi, UAV->lat_d, UAV->long_d, UAV->altitude_msl, UAV->base_lat_d, UAV->base_long_d, UAV->uav_id);
-  Serial.println(json_msg);
-}
-
-// Sends UART messages over Serial1 exactly as before.
-void print_compact_message(struct uav_data *UAV) {
-  static unsigned long lastSendTime = 0;
-  const unsigned long sendInterval = 5000;  // 5-second interval for UART messages
+#if DC_OUT_MESH
+// One Meshtastic text line for the part the mesh scheduler released.
+void print_compact_message(const id_data *UAV, mesh_part part) {
   const int MAX_MESH_SIZE = 230;
-  
-  if (millis() - lastSendTime < sendInterval) return;
-  lastSendTime = millis();
-  
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-           UAV->mac[0], UAV->mac[1], UAV->mac[2],
-           UAV->mac[3], UAV->mac[4], UAV->mac[5]);
-  
   char mesh_msg[MAX_MESH_SIZE];
   int msg_len = 0;
-  msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
-                      "Drone: %s RSSI:%d", mac_str, UAV->rssi);
-  if (msg_len < MAX_MESH_SIZE && UAV->lat_d != 0.0 && UAV->long_d != 0.0) {
+
+  if (part != MESH_PART_PILOT) {   // drone line, or its keepalive
+    char mac_str[18];
+    format_mac(mac_str, UAV->mac);
     msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
-                        " https://maps.google.com/?q=%.6f,%.6f",
-                        UAV->lat_d, UAV->long_d);
+                        "Drone: %s RSSI:%d", mac_str, UAV->rssi);
+    if (msg_len < MAX_MESH_SIZE && UAV->lat_e7 != 0 && UAV->long_e7 != 0) {
+      char lat[16], lon[16];
+      format_coord(lat, sizeof(lat), UAV->lat_e7);
+      format_coord(lon, sizeof(lon), UAV->long_e7);
+      msg_len += snprintf(mesh_msg + msg_len, sizeof(mesh_msg) - msg_len,
+                          " https://maps.google.com/?q=%s,%s", lat, lon);
+    }
+  } else {
+    char lat[16], lon[16];
+    format_coord(lat, sizeof(lat), UAV->base_lat_e7);
+    format_coord(lon, sizeof(lon), UAV->base_long_e7);
+    msg_len = snprintf(mesh_msg, sizeof(mesh_msg),
+                       "Pilot: https://maps.google.com/?q=%s,%s", lat, lon);
   }
   if (Serial1.availableForWrite() >= msg_len) {
     Serial1.println(mesh_msg);
   }
-  
-  delay(1000);
-  if (UAV->base_lat_d != 0.0 && UAV->base_long_d != 0.0) {
-    char pilot_msg[MAX_MESH_SIZE];
-    int pilot_len = snprintf(pilot_msg, sizeof(pilot_msg),
-                             "Pilot: https://maps.google.com/?q=%.6f,%.6f",
-                             UAV->base_lat_d, UAV->base_long_d);
-    if (Serial1.availableForWrite() >= pilot_len) {
-      Serial1.println(pilot_msg);
-    }
+  // JSON is sent separately via send_json_fast().
+}
+
+// Scheduled mesh line: binary frame or the text drone/pilot line.
+void send_mesh_line(const id_data *UAV, mesh_part part, uint16_t sends) {
+#if MESH_BINARY_FRAMES
+  char line[MESH_FRAME_TEXT_MAX];
+  int len = part == MESH_PART_KEEPALIVE
+                ? mesh_frame_keepalive_to_text(line, sizeof(line), UAV, 0)
+                : mesh_frame_to_text(line, sizeof(line), UAV, 0,
+                                     sends % MESH_FRAME_ID_EVERY == 0);
+  if (len > 0 && Serial1.availableForWrite() >= len) {
+    Serial1.println(line);
   }
-  // Do not call send_json_detection() here; JSON is now sent separately via send_json_fast().
+#else
+  print_compact_message(UAV, part);
+#endif
 }
+#endif // DC_OUT_MESH
 
 // WiFi promiscuous callback: processes packets and sends both UART and fast JSON.
 void callback(void *buffer, wifi_promiscuous_pkt_type_t type) {
@@ -194,108 +258,23 @@ void callback(void *buffer, wifi_promiscuous_pkt_type_t type) {
   wifi_promiscuous_pkt_t *packet = (wifi_promiscuous_pkt_t *)buffer;
   uint8_t *payload = packet->payload;
   int length = packet->rx_ctrl.sig_len;
+  uint32_t rx_us = micros();
   
-  uav_data *currentUAV = (uav_data *)malloc(sizeof(uav_data));
-  if (!currentUAV) return;
-  memset(currentUAV, 0, sizeof(uav_data));
-  
-  store_mac(currentUAV, payload);
-  currentUAV->rssi = packet->rx_ctrl.rssi;
-  
-  static const uint8_t nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
-  if (memcmp(nan_dest, &payload[4], 6) == 0) {
-    if (odid_wifi_receive_message_pack_nan_action_frame(&UAS_data,
-                                                          (char *)currentUAV->op_id,
-                                                          payload, length) == 0) {
-      parse_odid(currentUAV, &UAS_data);
-      packetCount++;
-      print_compact_message(currentUAV); // Send UART messages (throttled).
-      send_json_fast(currentUAV);         // Send JSON messages as fast as possible.
-    }
-  }
-  else if (payload[0] == 0x80) {
-    int offset = 36;
-    bool printed = false;
-    while (offset < length) {
-      int typ = payload[offset];
-      int len = payload[offset + 1];
-      if (!printed) {
-        if ((typ == 0xdd) &&
-            (((payload[offset + 2] == 0x90 && payload[offset + 3] == 0x3a && payload[offset + 4] == 0xe6)) ||
-             ((payload[offset + 2] == 0xfa && payload[offset + 3] == 0x0b && payload[offset + 4] == 0xbc)))) {
-          int j = offset + 7;
-          if (j < length) {
-            memset(&UAS_data, 0, sizeof(UAS_data));
-            odid_message_process_pack(&UAS_data, &payload[j], length - j);
-            parse_odid(currentUAV, &UAS_data);
-            packetCount++;
-            print_compact_message(currentUAV);
-            send_json_fast(currentUAV);
-            printed = true;
-          }
-        }
-      }
-      offset += len + 2;
-    }
-  }
-  free(currentUAV);
-}
+  if (odid_decode_wifi_frame(&wifiDecoder, payload, length) == ODID_FRAME_NONE) return;
 
-void parse_odid(uav_data *UAV, ODID_UAS_Data *UAS_data2) {
-  memset(UAV->op_id, 0, sizeof(UAV->op_id));
-  memset(UAV->uav_id, 0, sizeof(UAV->uav_id));
-  memset(UAV->description, 0, sizeof(UAV->description));
-  memset(UAV->auth_data, 0, sizeof(UAV->auth_data));
-  
-  if (UAS_data2->BasicIDValid[0]) {
-    strncpy(UAV->uav_id, (char *)UAS_data2->BasicID[0].UASID, ODID_ID_SIZE);
-  }
-  if (UAS_data2->LocationValid) {
-    UAV->lat_d = UAS_data2->Location.Latitude;
-    UAV->long_d = UAS_data2->Location.Longitude;
-    UAV->altitude_msl = (int)UAS_data2->Location.AltitudeGeo;
-    UAV->height_agl = (int)UAS_data2->Location.Height;
-    UAV->speed = (int)UAS_data2->Location.SpeedHorizontal;
-    UAV->heading = (int)UAS_data2->Location.Direction;
-    UAV->speed_vertical = (int)UAS_data2->Location.SpeedVertical;
-    UAV->altitude_pressure = (int)UAS_data2->Location.AltitudeBaro;
-    UAV->height_type = UAS_data2->Location.HeightType;
-    UAV->horizontal_accuracy = UAS_data2->Location.HorizAccuracy;
-    UAV->vertical_accuracy = UAS_data2->Location.VertAccuracy;
-    UAV->baro_accuracy = UAS_data2->Location.BaroAccuracy;
-    UAV->speed_accuracy = UAS_data2->Location.SpeedAccuracy;
-    UAV->timestamp = (int)UAS_data2->Location.TimeStamp;
-    UAV->status = UAS_data2->Location.Status;
-  }
-  if (UAS_data2->SystemValid) {
-    UAV->base_lat_d = UAS_data2->System.OperatorLatitude;
-    UAV->base_long_d = UAS_data2->System.OperatorLongitude;
-    UAV->operator_location_type = UAS_data2->System.OperatorLocationType;
-    UAV->classification_type = UAS_data2->System.ClassificationType;
-    UAV->area_count = UAS_data2->System.AreaCount;
-    UAV->area_radius = UAS_data2->System.AreaRadius;
-    UAV->area_ceiling = UAS_data2->System.AreaCeiling;
-    UAV->area_floor = UAS_data2->System.AreaFloor;
-    UAV->operator_altitude_geo = UAS_data2->System.OperatorAltitudeGeo;
-    UAV->system_timestamp = UAS_data2->System.Timestamp;
-  }
-  if (UAS_data2->AuthValid[0]) {
-    UAV->auth_type = UAS_data2->Auth[0].AuthType;
-    UAV->auth_page = UAS_data2->Auth[0].DataPage;
-    UAV->auth_length = UAS_data2->Auth[0].Length;
-    UAV->auth_timestamp = UAS_data2->Auth[0].Timestamp;
-    memcpy(UAV->auth_data, UAS_data2->Auth[0].AuthData, sizeof(UAV->auth_data) - 1);
-  }
-  if (UAS_data2->SelfIDValid) {
-    UAV->desc_type = UAS_data2->SelfID.DescType;
-    strncpy(UAV->description, UAS_data2->SelfID.Desc, ODID_STR_SIZE);
-  }
-  if (UAS_data2->OperatorIDValid) {
-    UAV->operator_id_type = UAS_data2->OperatorID.OperatorIdType;
-    strncpy(UAV->op_id, (char *)UAS_data2->OperatorID.OperatorId, ODID_ID_SIZE);
-  }
+  // Only ODID frames get this far; the record is reused, never heap-allocated.
+  // Fields merge into the tracker so a Location-only pack keeps the Basic ID
+  // and operator position already seen for this drone.
+  uav_tracker_store(&tracker, wifiDecoder.mac, packet->rx_ctrl.rssi, BAND_2_4GHZ,
+                    packet->rx_ctrl.channel, rx_us, &wifiDecoder.fields, &currentUAV);
+  packetCount++;
+  if (!currentUAV.flag) return;        // dropped by the plausibility filter
+#if DC_OUT_MESH
+  mesh_scheduler_update(&meshSched, &currentUAV); // UART lines go out from loop()
+#endif
+  send_json_fast(&currentUAV);         // Send JSON messages as fast as possible.
+#if DC_METRICS
+  dc_latency_record(&metrics.latency, micros() - rx_us);
+#endif
 }
 
-void store_mac(uav_data *uav, uint8_t *payload) {
-  memcpy(uav->mac, &payload[10], 6);
-}